@@ -0,0 +1,264 @@
+#include <cassert>
+#include "alias.h"
+
+static bool IsAlloc(IRValue *v)
+{
+    return v->kind==IRV_INST && v->AsInst()->op==IR_ALLOC;
+}
+
+// 把下标 v 乘以 scale 字节加入 info
+static void AddIndex(PtrInfo &info,IRValue *v,int scale)
+{
+    while(v->kind==IRV_INST && v->AsInst()->op==IR_BINARY)
+    {
+        IRInst *inst=v->AsInst();
+        IRValue *x=inst->ops[0],*c=inst->ops[1];
+        if((inst->bop==KOOPA_RBO_ADD || inst->bop==KOOPA_RBO_MUL) && x->IsConst())
+            std::swap(x,c);
+        if(!c->IsConst())
+            break;
+        if(inst->bop==KOOPA_RBO_ADD)
+            info.offset+=c->const_val*scale;
+        else if(inst->bop==KOOPA_RBO_SUB)
+            info.offset-=c->const_val*scale;
+        else if(inst->bop==KOOPA_RBO_MUL)
+            scale*=c->const_val;
+        else
+            break;
+        v=x;
+    }
+    if(v->IsConst())
+    {
+        info.offset+=v->const_val*scale;
+        return;
+    }
+    if((info.terms[v]+=scale)==0)
+        info.terms.erase(v);
+}
+
+PtrInfo AnalyzePtr(IRValue *ptr)
+{
+    PtrInfo info;
+    while(ptr->kind==IRV_INST && (ptr->AsInst()->op==IR_GEP || ptr->AsInst()->op==IR_GETPTR))
+    {
+        IRInst *inst=ptr->AsInst();
+        IRType *pointee=inst->ops[0]->ty->base;
+        int stride=(inst->op==IR_GEP)?pointee->base->Size():pointee->Size();
+        AddIndex(info,inst->ops[1],stride);
+        ptr=inst->ops[0];
+    }
+    info.base=ptr;
+    return info;
+}
+
+AliasInfo::AliasInfo(IRFunction *func):func(func)
+{
+    std::vector<IRValue *> leaked;
+    for(IRBlock *bb: func->blocks)
+    {
+        for(IRInst *inst: bb->insts)
+        {
+            for(int s=0;s<(int)inst->succs.size();++s)
+            {
+                IRBlock *succ=inst->succs[s];
+                for(int j=0;j<inst->NumSuccArgs(s);++j)
+                    if(succ->params[j]->ty->tag==IRT_POINTER)
+                        incoming[succ->params[j]].push_back(inst->SuccArg(s,j));
+            }
+            bool leaks=inst->op==IR_CALL || (inst->op==IR_STORE && inst->ops[0]->ty->tag==IRT_POINTER);
+            if(!leaks)
+                continue;
+            for(int i=0;i<(int)inst->ops.size();++i)
+            {
+                if(inst->op==IR_STORE && i==1)
+                    continue;
+                if(inst->ops[i]->ty->tag==IRT_POINTER)
+                    leaked.push_back(inst->ops[i]);
+            }
+        }
+    }
+    // 基本块参数的入边全部收集之后才能确定泄露的指针指向哪些对象
+    for(IRValue *ptr: leaked)
+        for(IRValue *obj: Objects(ptr))
+            escaped.insert(obj);
+}
+
+std::set<IRValue *> AliasInfo::Objects(IRValue *ptr) const
+{
+    std::set<IRValue *> objects,visited;
+    std::vector<IRValue *> worklist{AnalyzePtr(ptr).base};
+    while(!worklist.empty())
+    {
+        IRValue *base=worklist.back();
+        worklist.pop_back();
+        if(!visited.insert(base).second)
+            continue;
+        auto it=incoming.find(base);
+        if(it==incoming.end())
+        {
+            objects.insert(base);
+            continue;
+        }
+        for(IRValue *arg: it->second)
+            worklist.push_back(AnalyzePtr(arg).base);
+    }
+    return objects;
+}
+
+static const PointsTo *ParamTargets(IRFunction *func,IRValue *param)
+{
+    if(func->param_targets.empty() || !func->param_targets[param->arg_index].known)
+        return nullptr;
+    return &func->param_targets[param->arg_index];
+}
+
+bool AliasInfo::ObjectsOverlap(IRValue *a,IRValue *b) const
+{
+    if(a==b)
+        return true;
+    if(IsAlloc(b))
+        std::swap(a,b);
+    // 参数不会指向本函数的 alloc, 未知的指针只能指向逃逸的 alloc
+    if(IsAlloc(a))
+        return !IsAlloc(b) && b->kind!=IRV_GLOBAL && b->kind!=IRV_FUNC_ARG && escaped.count(a);
+    if(b->kind==IRV_FUNC_ARG)
+        std::swap(a,b);
+    if(a->kind!=IRV_FUNC_ARG)
+        return a->kind!=IRV_GLOBAL || b->kind!=IRV_GLOBAL;
+    const PointsTo *pa=ParamTargets(func,a);
+    if(b->kind==IRV_GLOBAL)
+        return pa==nullptr || pa->objects.count(b);
+    const PointsTo *pb=(b->kind==IRV_FUNC_ARG)?ParamTargets(func,b):nullptr;
+    if(pa==nullptr || pb==nullptr)
+        return true;
+    for(IRValue *obj: pa->objects)
+        if(pb->objects.count(obj))
+            return true;
+    return false;
+}
+
+bool AliasInfo::MayAlias(IRValue *p,IRValue *q) const
+{
+    if(p==q)
+        return true;
+    PtrInfo a=AnalyzePtr(p),b=AnalyzePtr(q);
+    if(a.base==b.base)
+        return a.terms!=b.terms || a.offset==b.offset;
+    std::set<IRValue *> objs=Objects(q);
+    for(IRValue *x: Objects(p))
+        for(IRValue *y: objs)
+            if(ObjectsOverlap(x,y))
+                return true;
+    return false;
+}
+
+bool AliasInfo::CallMayAccess(IRInst *call,IRValue *ptr,bool write) const
+{
+    const ModRefInfo &info=call->callee->modref;
+    std::set<IRValue *> objs=Objects(ptr);
+    if(!info.known)
+    {
+        for(IRValue *obj: objs)
+            if(!IsAlloc(obj) || escaped.count(obj))
+                return true;
+        return false;
+    }
+    const std::set<IRGlobal *> &globals=write?info.mod_globals:info.ref_globals;
+    const std::set<int> &params=write?info.mod_params:info.ref_params;
+    for(IRValue *obj: objs)
+    {
+        for(IRGlobal *global: globals)
+            if(ObjectsOverlap(obj,global))
+                return true;
+        for(int i: params)
+        {
+            assert(i<(int)call->ops.size());
+            for(IRValue *arg_obj: Objects(call->ops[i]))
+                if(ObjectsOverlap(obj,arg_obj))
+                    return true;
+        }
+    }
+    return false;
+}
+bool AliasInfo::CallMayModify(IRInst *call,IRValue *ptr) const
+{
+    return CallMayAccess(call,ptr,true);
+}
+bool AliasInfo::CallMayRef(IRInst *call,IRValue *ptr) const
+{
+    return CallMayAccess(call,ptr,false);
+}
+
+bool AliasInfo::MayWrite(IRInst *inst,IRValue *ptr) const
+{
+    if(inst->op==IR_STORE)
+        return MayAlias(inst->ops[1],ptr);
+    return inst->op==IR_CALL && CallMayModify(inst,ptr);
+}
+bool AliasInfo::MayRead(IRInst *inst,IRValue *ptr) const
+{
+    if(inst->op==IR_LOAD)
+        return MayAlias(inst->ops[0],ptr);
+    return inst->op==IR_CALL && CallMayRef(inst,ptr);
+}
+
+bool AliasInfo::SafeToSpeculate(IRValue *ptr) const
+{
+    PtrInfo info=AnalyzePtr(ptr);
+    if(!IsAlloc(info.base) && info.base->kind!=IRV_GLOBAL)
+        return false;
+    return info.terms.empty() && info.offset>=0 && info.offset+ptr->ty->base->Size()<=info.base->ty->base->Size();
+}
+
+void ComputeParamTargets(IRModule &module)
+{
+    std::map<IRFunction *,AliasInfo> infos;
+    std::vector<std::pair<IRFunction *,IRInst *>> sites;
+    for(IRFunction *func: module.funcs)
+    {
+        func->param_targets.clear();
+        if(func->IsDecl())
+            continue;
+        infos.emplace(func,AliasInfo(func));
+        for(IRBlock *bb: func->blocks)
+            for(IRInst *inst: bb->insts)
+                if(inst->op==IR_CALL && !inst->callee->IsDecl())
+                    sites.push_back({func,inst});
+    }
+    for(auto &[caller,call]: sites)
+        call->callee->param_targets.assign(call->callee->params.size(),PointsTo{true,{}});
+
+    // 集合只增不减, 已知只会变为未知, 一定收敛
+    bool changed=true;
+    while(changed)
+    {
+        changed=false;
+        for(auto &[caller,call]: sites)
+        {
+            IRFunction *callee=call->callee;
+            for(int i=0;i<(int)call->ops.size();++i)
+            {
+                PointsTo &targets=callee->param_targets[i];
+                if(!targets.known || call->ops[i]->ty->tag!=IRT_POINTER)
+                    continue;
+                for(IRValue *obj: infos.at(caller).Objects(call->ops[i]))
+                {
+                    if(IsAlloc(obj) || obj->kind==IRV_GLOBAL)
+                    {
+                        changed=targets.objects.insert(obj).second || changed;
+                        continue;
+                    }
+                    const PointsTo *from=(obj->kind==IRV_FUNC_ARG)?ParamTargets(caller,obj):nullptr;
+                    if(from==nullptr)
+                    {
+                        targets=PointsTo();
+                        changed=true;
+                        break;
+                    }
+                    for(IRValue *x: from->objects)
+                        changed=targets.objects.insert(x).second || changed;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include "ir.h"
+
+// 指针的来源: 沿 getelemptr/getptr 找到的基址, 以及相对基址的字节偏移 offset + Σ terms[v]*v
+// 下标为 x+c, x-c, x*c (c 为常数) 时继续分解 x, 其余的变量下标各自成为一项
+struct PtrInfo
+{
+    IRValue *base;
+    int offset=0;
+    std::map<IRValue *,int> terms;
+};
+PtrInfo AnalyzePtr(IRValue *ptr);
+
+// 别名分析
+// 对象: 不同的 alloc 和全局变量互不重叠. 基址是基本块参数 (如尾递归消除后的指针参数) 时取所有入边实参的基址,
+// 最终的 alloc, 全局变量和函数参数就是指针可能指向的对象; load 得到的指针指向未知的对象, 可能是逃逸的 alloc
+// 参数不会指向本函数的 alloc, 可能指向的全局变量和调用者的 alloc 由 ComputeParamTargets 在整个模块中计算
+// 同一基址上变量项相同而常数偏移不同的两个 i32 访问互不重叠. 变量项比较的是 SSA 值本身, 结论只对两个地址
+// 用的是变量的同一个值时成立, 例如在同一次迭代中, 或其中一个地址是循环不变量
+class AliasInfo
+{
+public:
+    explicit AliasInfo(IRFunction *func);
+
+    // ptr 可能指向的对象, 未知的对象用得到指针的指令表示
+    std::set<IRValue *> Objects(IRValue *ptr) const;
+    bool MayAlias(IRValue *p,IRValue *q) const;
+    // call 是否可能写/读 ptr 指向的内存, 由被调用函数的副作用摘要确定: 摘要中的全局变量, 以及读写的指针参数对应的实参;
+    // 摘要未知时可能读写除了地址没有逃逸的 alloc 以外的所有内存
+    bool CallMayModify(IRInst *call,IRValue *ptr) const;
+    bool CallMayRef(IRInst *call,IRValue *ptr) const;
+    // load, store 和 call 是否可能写/读 ptr 指向的内存
+    bool MayWrite(IRInst *inst,IRValue *ptr) const;
+    bool MayRead(IRInst *inst,IRValue *ptr) const;
+    // 地址是本函数的 alloc 或全局变量中常数偏移处的元素, 并且没有越界, 提前到循环外读写不会访问到程序之外的内存
+    bool SafeToSpeculate(IRValue *ptr) const;
+    // alloc 的地址是否被传给函数或存入内存; 没有逃逸的 alloc 只能通过基址为它的地址访问
+    bool Escaped(IRValue *obj) const { return escaped.count(obj)!=0; }
+
+private:
+    IRFunction *func;
+    std::set<IRValue *> escaped;    // 地址被传给函数或存入内存的 alloc
+    std::map<IRValue *,std::vector<IRValue *>> incoming;   // 指针类型的基本块参数 -> 各入边的实参
+
+    bool ObjectsOverlap(IRValue *a,IRValue *b) const;
+    bool CallMayAccess(IRInst *call,IRValue *ptr,bool write) const;
+};
+
+// 计算各函数的 param_targets: 从空集合开始, 把每个调用处实参可能指向的对象加入形参的集合, 直到不再变化
+// 没有调用处的函数保持未知; 之后的内联, 常量传播等只会把实参换成指向同样对象的值, 结果仍然成立
+void ComputeParamTargets(IRModule &module);
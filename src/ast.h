@@ -9,6 +9,8 @@
 #include <vector>
 #include <stack>
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include "symbol_table.h"
 
 //#define DEBUG_AST
@@ -164,9 +166,27 @@ static std::map<std::string, std::string> op_names = {
 static int symbol_cnt = 0;
 static int label_cnt=0;
 static bool is_ret=false;
-static int alloc_tmp=0;
 static std::vector<int> while_stack;
 static std::string current_func;
+// 局部数组初始化用到的 .rodata 模板, 在当前函数之前输出
+static std::stringstream init_templates;
+static int init_template_cnt=0;
+static int init_idx_cnt=0;
+
+// 局部数组初始化的代价模型
+static const int INIT_LOOP_MIN=16;      // 元素数不少于此值时, 先用循环整体清零或复制
+static const int INIT_TEMPLATE_MIN=16;  // 非零常数不少于此值时, 从 .rodata 模板复制
+static const int INIT_UNROLL=4;         // 循环每次迭代初始化的元素数
+
+// 编译器生成的名字 @prefix<n>: 全局变量和函数在 Koopa IR 中沿用源程序的名字, 跳过与源程序中的标识符相同的 n
+static std::string generated_name(const std::string &prefix,int &cnt)
+{
+    std::string name;
+    do
+        name=prefix+std::to_string(cnt++);
+    while(source_idents.count(name));
+    return "@"+name;
+}
 
 static void print_dims(const std::vector<int> &dims, int ndim)
 {
@@ -299,11 +319,9 @@ public:
         
 
     }
-    void generate_assign(std::string ir_name)
+    // 取得指向最内层一维数组的指针, 之后可以用展平的下标访问任意元素
+    std::string flatten(std::string ir_name)
     {
-        for (int i = val_cnt; i < dims_size[0]; ++i)
-            vals.push_back("0");
-        val_cnt=dims_size[0];
         std::string last_symbol=ir_name;
         for(int i=0;i<ndim-1;++i)
         {
@@ -312,8 +330,109 @@ public:
             last_symbol=new_symbol;
             symbol_cnt++;
         }
+        return last_symbol;
+    }
+    // 生成循环, 把 dst 的前 len 个元素清零 (src 为空) 或从 src 复制, 返回循环覆盖的元素数
+    int generate_init_loop(const std::string &dst,const std::string &src,int len)
+    {
+        int loop_len=len/INIT_UNROLL*INIT_UNROLL;
+        std::string idx=generated_name("_init_idx",init_idx_cnt);
+        std::string lable_loop="%_init_loop_"+std::to_string(label_cnt),
+                    lable_end="%_init_end_"+std::to_string(label_cnt);
+        label_cnt++;
+        std::cout<<"  "<<idx<<" = alloc i32"<<std::endl;
+        std::cout<<"  store 0, "<<idx<<std::endl;
+        std::cout<<"  jump "<<lable_loop<<std::endl<<std::endl;
+
+        std::cout<<lable_loop<<":"<<std::endl;
+        std::string i_symbol="%"+std::to_string(symbol_cnt++);
+        std::string dst_base="%"+std::to_string(symbol_cnt++);
+        std::cout<<"  "<<i_symbol<<" = load "<<idx<<std::endl;
+        std::cout<<"  "<<dst_base<<" = getelemptr "<<dst<<", "<<i_symbol<<std::endl;
+        std::string src_base;
+        if(!src.empty())
+        {
+            src_base="%"+std::to_string(symbol_cnt++);
+            std::cout<<"  "<<src_base<<" = getelemptr "<<src<<", "<<i_symbol<<std::endl;
+        }
+        for(int k=0;k<INIT_UNROLL;++k)
+        {
+            std::string val="0";
+            if(!src.empty())
+            {
+                std::string src_ptr="%"+std::to_string(symbol_cnt++);
+                val="%"+std::to_string(symbol_cnt++);
+                std::cout<<"  "<<src_ptr<<" = getptr "<<src_base<<", "<<k<<std::endl;
+                std::cout<<"  "<<val<<" = load "<<src_ptr<<std::endl;
+            }
+            std::string dst_ptr="%"+std::to_string(symbol_cnt++);
+            std::cout<<"  "<<dst_ptr<<" = getptr "<<dst_base<<", "<<k<<std::endl;
+            std::cout<<"  store "<<val<<", "<<dst_ptr<<std::endl;
+        }
+        std::string next="%"+std::to_string(symbol_cnt++),
+                    cond="%"+std::to_string(symbol_cnt++);
+        std::cout<<"  "<<next<<" = add "<<i_symbol<<", "<<INIT_UNROLL<<std::endl;
+        std::cout<<"  store "<<next<<", "<<idx<<std::endl;
+        std::cout<<"  "<<cond<<" = lt "<<next<<", "<<loop_len<<std::endl;
+        std::cout<<"  br "<<cond<<", "<<lable_loop<<", "<<lable_end<<std::endl<<std::endl;
+        std::cout<<lable_end<<":"<<std::endl;
+        return loop_len;
+    }
+    // 在 init_templates 中输出以 vals 中的常数为初值的全局数组 (非常数的位置为 0), 返回其名字
+    std::string generate_template()
+    {
+        std::string name=generated_name("_init_tmpl",init_template_cnt);
+        NDimArray tmpl(dims,ndim);
+        for(const std::string &val: vals)
+            tmpl.push(is_literal(val)?val:"0");
+        std::streambuf *old_buf=std::cout.rdbuf(init_templates.rdbuf());
+        std::cout<<"global "<<name<<" = alloc ";
+        print_dims(dims,ndim);
+        std::cout<<", ";
+        tmpl.generate_aggregate();
+        std::cout<<std::endl<<std::endl;
+        std::cout.rdbuf(old_buf);
+        return name;
+    }
+    static bool is_literal(const std::string &val)
+    {
+        return val[0]=='-' || isdigit(val[0]);
+    }
+    // 所有元素都是常数, 可以作为全局数组的初值
+    bool all_literal() const
+    {
+        return std::all_of(vals.begin(),vals.end(),is_literal);
+    }
+    void generate_assign(std::string ir_name)
+    {
+        for (int i = val_cnt; i < dims_size[0]; ++i)
+            vals.push_back("0");
+        val_cnt=dims_size[0];
+        std::string last_symbol=flatten(ir_name);
+
+        // 代价模型: 小数组逐个元素赋值; 大数组先整体清零或从模板复制, 再逐个写入剩下的元素
+        int const_cnt=0;
+        for(const std::string &val: vals)
+            if(is_literal(val) && val!="0")
+                const_cnt++;
+        std::vector<bool> done(val_cnt,false);
+        if(val_cnt>=INIT_LOOP_MIN)
+        {
+            bool use_template=(const_cnt>=INIT_TEMPLATE_MIN);
+            std::string src;
+            if(use_template)
+            {
+                std::string tmpl=generate_template();
+                src=flatten(tmpl);
+            }
+            int loop_len=generate_init_loop(last_symbol,src,val_cnt);
+            for(int i=0;i<loop_len;++i)
+                done[i]=(use_template?is_literal(vals[i]):vals[i]=="0");
+        }
         for(int i=0;i<val_cnt;++i)
         {
+            if(done[i])
+                continue;
             std::string new_symbol = "%" + std::to_string(symbol_cnt);
             symbol_cnt++;
             std::cout<<"  "<<new_symbol<<" = getelemptr "<<last_symbol<<", "<<i<<std::endl;
@@ -357,6 +476,14 @@ public:
     bool is_global=false;
     virtual ~BaseAST() = default;
     virtual void GenerateIR() = 0;
+    // 全局数组 ident 的初值调用了函数时报错退出
+    void RequireLiteral(const NDimArray *arr) const
+    {
+        if(arr->all_literal())
+            return;
+        std::cerr<<"error: initializer of global array '"<<ident<<"' is not a compile-time constant"<<std::endl;
+        std::exit(1);
+    }
 };
 
 // 所有 Exp 的基类
@@ -370,6 +497,15 @@ public:
     bool is_left=false;
     int val=-1;
     std::vector<int> vals;
+    // 必须在编译时求值的表达式 (数组长度, 全局变量的初值) 调用了函数时报错退出
+    void RequireConst(const char *what)
+    {
+        Eval();
+        if(is_const)
+            return;
+        std::cerr<<"error: "<<what<<" is not a compile-time constant"<<std::endl;
+        std::exit(1);
+    }
     void Copy(std::unique_ptr<BaseExpAST>& exp)
     {
         is_const=exp->is_const;
@@ -379,6 +515,30 @@ public:
 
 
     }
+    // 作为条件时生成跳转代码, 值非零时跳到 lable_true, 否则跳到 lable_false, 不生成布尔值
+    // 目标可以带基本块参数, 如 "%_end_0(0)"
+    virtual void GenerateCond(const std::string &lable_true,const std::string &lable_false)
+    {
+        Eval();
+        if(is_const)
+            std::cout<<"  jump "<<(val!=0?lable_true:lable_false)<<std::endl<<std::endl;
+        else
+            std::cout<<"  br "<<ident<<", "<<lable_true<<", "<<lable_false<<std::endl<<std::endl;
+    }
+    // 把 exp 转换为 0/1 作为自己的值
+    void GenerateBool(std::unique_ptr<BaseExpAST>& exp)
+    {
+        is_const=exp->is_const;
+        if(is_const)
+        {
+            val=(exp->val!=0);
+            ident=std::to_string(val);
+            return;
+        }
+        ident = "%" + std::to_string(symbol_cnt);
+        symbol_cnt++;
+        std::cout<<"  "<<ident<<" = ne "<<exp->ident<<", 0"<<std::endl;
+    }
 };
 
 // CompUnit 是 BaseAST
@@ -425,6 +585,9 @@ public:
         std::vector<std::string> params;
         std::vector<std::string> types;
         std::vector<int> ndims;
+        // 函数体先写入缓冲区, 以便把其中用到的初始化模板输出在函数之前
+        std::stringstream func_ir;
+        std::streambuf *old_buf=std::cout.rdbuf(func_ir.rdbuf());
         std::cout<<"fun @"<<ident<<"(";
 
         int cnt=0;
@@ -473,6 +636,10 @@ public:
         std::cout << "}" << std::endl;
         symbol_table_stack.PopScope();
         is_ret=false;
+
+        std::cout.rdbuf(old_buf);
+        std::cout<<init_templates.str()<<func_ir.str();
+        init_templates.str("");
     }
 };
 
@@ -557,8 +724,7 @@ public:
         if(bnf_type==OpenStmtType::OSTMT_CLOSED)
         {
             dbg_ast_printf("OpenStmt :: = IF '(' Exp ')' ClosedStmt;\n");
-            exp->Eval();
-            std::cout<<"  br "<<exp->ident<<", "<<lable_then<<", "<<lable_end<<std::endl<<std::endl;
+            exp->GenerateCond(lable_then,lable_end);
             std::cout<<lable_then<<":"<<std::endl;
             is_ret=false;
             closed_stmt->GenerateIR();
@@ -572,9 +738,7 @@ public:
         else if (bnf_type==OpenStmtType::OSTMT_OPEN)
         {
             dbg_ast_printf("OpenStmt :: = IF '(' Exp ')' OpenStmt;\n");
-            exp->Eval();
-            std::cout << "  br " << exp->ident << ", " << lable_then << ", " << lable_end << std::endl
-                      << std::endl;
+            exp->GenerateCond(lable_then,lable_end);
             std::cout << lable_then << ":" << std::endl;
 
             is_ret=false;
@@ -590,9 +754,7 @@ public:
         {
             dbg_ast_printf("OpenStmt :: = IF '(' Exp ')' ClosedStmt ELSE OpenStmt;\n");
             bool total_ret=true;
-            exp->Eval();
-            std::cout << "  br " << exp->ident << ", " << lable_then << ", " << lable_else << std::endl
-                      << std::endl;
+            exp->GenerateCond(lable_then,lable_else);
             
             std::cout << lable_then << ":" << std::endl;
             is_ret=false;
@@ -621,8 +783,7 @@ public:
             std::cout<<"  jump "<<lable_while_entry<<std::endl<<std::endl;
 
             std::cout<<lable_while_entry<<":"<<std::endl;
-            exp->Eval();
-            std::cout<<"  br "<<exp->ident<<", "<<lable_while_body<<", "<<lable_end<<std::endl<<std::endl;
+            exp->GenerateCond(lable_while_body,lable_end);
 
             std::cout<<lable_while_body<<":"<<std::endl;
             is_ret=false;
@@ -669,9 +830,7 @@ public:
             label_cnt++;
 
             bool total_ret=true;
-            exp->Eval();
-            std::cout << "  br " << exp->ident << ", " << lable_then << ", " << lable_else << std::endl
-                      << std::endl;
+            exp->GenerateCond(lable_then,lable_else);
 
             std::cout << lable_then << ":" << std::endl;
             is_ret=false;
@@ -705,9 +864,7 @@ public:
                       << std::endl;
 
             std::cout << lable_while_entry << ":" << std::endl;
-            exp->Eval();
-            std::cout << "  br " << exp->ident << ", " << lable_while_body << ", " << lable_end << std::endl
-                      << std::endl;
+            exp->GenerateCond(lable_while_body,lable_end);
 
             std::cout << lable_while_body << ":" << std::endl;
             is_ret = false;
@@ -813,6 +970,10 @@ class ExpAST : public BaseExpAST
 {
 public:
     std::unique_ptr<BaseExpAST> lor_exp;
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        lor_exp->GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR() override
     {
         lor_exp->GenerateIR();
@@ -864,6 +1025,13 @@ public:
             assert(false);
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if(bnf_type==PrimaryExpType::EXP)
+            exp->GenerateCond(lable_true,lable_false);
+        else
+            BaseExpAST::GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR()  override
     {
 
@@ -962,6 +1130,18 @@ public:
             std::cout<<")"<<std::endl;
         }
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        // -x, +x 与 x 同为零或非零, !x 交换两个出口
+        if(bnf_type==UnaryExpType::PRIMARY)
+            primary_exp->GenerateCond(lable_true,lable_false);
+        else if(bnf_type==UnaryExpType::UNARY && unary_op=="!")
+            unary_exp->GenerateCond(lable_false,lable_true);
+        else if(bnf_type==UnaryExpType::UNARY)
+            unary_exp->GenerateCond(lable_true,lable_false);
+        else
+            BaseExpAST::GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR()  override
     {
 
@@ -1016,6 +1196,13 @@ public:
             assert(false);
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if(bnf_type==BianryOPExpType::INHERIT)
+            unary_exp->GenerateCond(lable_true,lable_false);
+        else
+            BaseExpAST::GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR() override
     {
     }
@@ -1067,6 +1254,13 @@ public:
             assert(false);
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if(bnf_type==BianryOPExpType::INHERIT)
+            mul_exp->GenerateCond(lable_true,lable_false);
+        else
+            BaseExpAST::GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR() override
     {
         
@@ -1123,6 +1317,13 @@ public:
             assert(false);
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if(bnf_type==BianryOPExpType::INHERIT)
+            add_exp->GenerateCond(lable_true,lable_false);
+        else
+            BaseExpAST::GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR()  override
     {
         
@@ -1176,6 +1377,13 @@ public:
             assert(false);
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if(bnf_type==BianryOPExpType::INHERIT)
+            rel_exp->GenerateCond(lable_true,lable_false);
+        else
+            BaseExpAST::GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR()  override
     {
 
@@ -1203,60 +1411,59 @@ public:
         {
             dbg_ast_printf("LAndExp :: = LAndExp '&&' EqExp;\n");
             land_exp->Eval();
-            if(land_exp->is_const && land_exp->val==0)
+            if(land_exp->is_const)
             {
-                val=land_exp->val;
-                ident = std::to_string(val);
-                is_const=true;
+                // 左侧为常数时不需要短路
+                if(land_exp->val==0)
+                {
+                    val=0;
+                    ident=std::to_string(val);
+                    is_const=true;
+                }
+                else
+                {
+                    eq_exp->Eval();
+                    GenerateBool(eq_exp);
+                }
                 is_evaled=true;
                 return;
             }
 
-            std::string lable_then = "%_then_" + std::to_string(label_cnt),
-                        lable_else = "%_else_" + std::to_string(label_cnt),
-                        lable_end = "%_end_" + std::to_string(label_cnt);
+            // 结果通过基本块参数传给 %_and_end
+            std::string lable_rhs = "%_and_rhs_" + std::to_string(label_cnt),
+                        lable_end = "%_and_end_" + std::to_string(label_cnt);
             label_cnt++;
+            std::cout<<"  br "<<land_exp->ident<<", "<<lable_rhs<<", "<<lable_end<<"(0)"<<std::endl<<std::endl;
 
-            ident = "t" + std::to_string(alloc_tmp);
-            std::string ir_name = "@" + ident;
-            ir_name=symbol_table_stack.Insert(ident, ir_name,SYMBOL_TYPE::VAR_SYMBOL);
-            alloc_tmp++;
-            std::cout << "  " << ir_name << " = alloc i32" << std::endl;
-
-            std::string tmp_var1="%"+std::to_string(symbol_cnt);
-            symbol_cnt++;
-            std::cout<<"  "<<tmp_var1<<" = ne "<<land_exp->ident<<", 0"<<std::endl;
-            std::cout<<"  br "<<tmp_var1<<", "<<lable_then<<", "<<lable_else<<std::endl<<std::endl;
-            
-            std::cout<<lable_then<<":"<<std::endl;
+            std::cout<<lable_rhs<<":"<<std::endl;
             eq_exp->Eval();
-            std::string tmp_var2 = "%" + std::to_string(symbol_cnt);
-            symbol_cnt++;
-            std::cout<<"  "<<tmp_var2<<" = ne "<<eq_exp->ident<<", 0"<<std::endl;
-            std::cout << "  store " << tmp_var2 << ", " << ir_name<<std::endl;
-            std::cout<<"  jump "<<lable_end<<std::endl<<std::endl;
+            GenerateBool(eq_exp);
+            std::cout<<"  jump "<<lable_end<<"("<<ident<<")"<<std::endl<<std::endl;
 
-            std::cout<<lable_else<<":"<<std::endl;
-            std::cout << "  store 0, " << ir_name<<std::endl;
-            std::cout << "  jump " << lable_end << std::endl
-                      << std::endl;
-
-            std::cout<<lable_end<<":"<<std::endl;
             ident = "%" + std::to_string(symbol_cnt);
             symbol_cnt++;
-            std::cout << "  " << ident << " = load " << ir_name << std::endl;
-            if (land_exp->is_const && eq_exp->is_const)
-            {
-                val = land_exp->val && eq_exp->val;
-                ident = std::to_string(val);
-                is_const = true;
-            }
+            std::cout<<lable_end<<"("<<ident<<": i32):"<<std::endl;
+            is_const=false;
         }
         else
             assert(false);
         
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if (bnf_type == BianryOPExpType::INHERIT)
+        {
+            eq_exp->GenerateCond(lable_true,lable_false);
+            return;
+        }
+        // 左侧为假时直接跳到假出口, 不保存中间结果
+        std::string lable_rhs = "%_and_rhs_" + std::to_string(label_cnt);
+        label_cnt++;
+        land_exp->GenerateCond(lable_rhs,lable_false);
+        std::cout<<lable_rhs<<":"<<std::endl;
+        eq_exp->GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR() override
     {
         
@@ -1284,62 +1491,56 @@ public:
         {
             dbg_ast_printf("LOrExp :: = LOrExp || LAndExp;\n");
             lor_exp->Eval();
-            if (lor_exp->is_const && lor_exp->val == 1)
+            if (lor_exp->is_const)
             {
-                val = lor_exp->val;
-                ident = std::to_string(val);
-                is_const=true;
+                if(lor_exp->val!=0)
+                {
+                    val = 1;
+                    ident = std::to_string(val);
+                    is_const=true;
+                }
+                else
+                {
+                    land_exp->Eval();
+                    GenerateBool(land_exp);
+                }
                 is_evaled = true;
                 return;
             }
-            std::string lable_then = "%_then_" + std::to_string(label_cnt),
-                        lable_else = "%_else_" + std::to_string(label_cnt),
-                        lable_end = "%_end_" + std::to_string(label_cnt);
-            
+
+            std::string lable_rhs = "%_or_rhs_" + std::to_string(label_cnt),
+                        lable_end = "%_or_end_" + std::to_string(label_cnt);
             label_cnt++;
-            ident="t" + std::to_string(alloc_tmp);
-            std::string ir_name = "@t" + std::to_string(alloc_tmp);
-            ir_name=symbol_table_stack.Insert(ident, "@"+ident,SYMBOL_TYPE::VAR_SYMBOL);
-            alloc_tmp++;
-            std::cout << "  " << ir_name << " = alloc i32" << std::endl;
+            std::cout<<"  br "<<lor_exp->ident<<", "<<lable_end<<"(1), "<<lable_rhs<<std::endl<<std::endl;
 
-            std::string tmp_var1 = "%" + std::to_string(symbol_cnt);
-            symbol_cnt++;
-            std::cout << "  " << tmp_var1 << " = eq " << lor_exp->ident << ", 0" << std::endl;
-            std::cout << "  br " << tmp_var1 << ", " << lable_then << ", " << lable_else << std::endl
-                      << std::endl;
-            
-            
-            std::cout << lable_then << ":" << std::endl;
+            std::cout<<lable_rhs<<":"<<std::endl;
             land_exp->Eval();
-            std::string tmp_var2 = "%" + std::to_string(symbol_cnt);
-            symbol_cnt++;
-            std::cout << "  " << tmp_var2 << " = ne " << land_exp->ident << ", 0" << std::endl;
-            std::cout<<"  store "<< tmp_var2<<", "<<ir_name<<std::endl;
-            std::cout << "  jump " << lable_end << std::endl
-                      << std::endl;
-
-            std::cout << lable_else << ":" << std::endl;
-            std::cout << "  store 1, "<<ir_name<<std::endl;
-            std::cout << "  jump " << lable_end << std::endl
-                      << std::endl;
+            GenerateBool(land_exp);
+            std::cout<<"  jump "<<lable_end<<"("<<ident<<")"<<std::endl<<std::endl;
 
-            std::cout << lable_end << ":" << std::endl;
-            
             ident = "%" + std::to_string(symbol_cnt);
             symbol_cnt++;
-            std::cout<<"  "<<ident<<" = load "<<ir_name<<std::endl;
-            if(land_exp->is_const && lor_exp->is_const)
-            {
-                val=land_exp->val || lor_exp->val;
-                ident=std::to_string(val);
-                is_const=true;
-            }
+            std::cout<<lable_end<<"("<<ident<<": i32):"<<std::endl;
+            is_const=false;
         }
         else
             assert(false);
         is_evaled=true;
     }
+    void GenerateCond(const std::string &lable_true,const std::string &lable_false) override
+    {
+        if (bnf_type == BianryOPExpType::INHERIT)
+        {
+            land_exp->GenerateCond(lable_true,lable_false);
+            return;
+        }
+        // 左侧为真时直接跳到真出口
+        std::string lable_rhs = "%_or_rhs_" + std::to_string(label_cnt);
+        label_cnt++;
+        lor_exp->GenerateCond(lable_true,lable_rhs);
+        std::cout<<lable_rhs<<":"<<std::endl;
+        land_exp->GenerateCond(lable_true,lable_false);
+    }
     void GenerateIR()  override
     {
         
@@ -1406,7 +1607,17 @@ public:
         {
             dbg_ast_printf("ConstDef :: = IDENT '=' ConstInitVal;\n");
             const_init_val->Eval();
-            symbol_table_stack.Insert(ident,const_init_val->val);
+            if(const_init_val->is_const)
+            {
+                symbol_table_stack.Insert(ident,const_init_val->val);
+                return;
+            }
+            // 初值调用了函数, 按只赋值一次的变量处理, 由优化器在编译时求值后再传播
+            if(is_global)
+                const_init_val->RequireConst(("initializer of global constant '"+ident+"'").c_str());
+            std::string ir_name=symbol_table_stack.Insert(ident,"@"+ident,SYMBOL_TYPE::VAR_SYMBOL);
+            std::cout<<"  "<<ir_name<<" = alloc i32"<<std::endl;
+            std::cout<<"  store "<<const_init_val->ident<<", "<<ir_name<<std::endl;
         }
         else if(bnf_type==InitType::INIT_ARRAY)
         {
@@ -1415,7 +1626,7 @@ public:
             std::vector<int> dims;
             for(auto &exp: const_exps->vec)
             {
-                exp->Eval();
+                exp->RequireConst("array size");
                 dims.push_back(exp->val);
                 ndim++;
             }
@@ -1427,6 +1638,7 @@ public:
             std::string ir_name=symbol_table_stack.Insert(ident,"@"+ident,SYMBOL_TYPE::ARR_SYMBOL,ndim);
             if(is_global)
             {
+                RequireLiteral(ndarr);
                 std::cout<<"global "<<ir_name<<" = alloc ";
                 print_dims(dims,ndim);
 
@@ -1480,8 +1692,10 @@ public:
             const_exp->Eval();
             Copy(const_exp);
             is_evaled=true;
-            if(ndarr!=nullptr)
+            if(ndarr!=nullptr && is_const)
                 ndarr->push(const_exp->val);
+            else if(ndarr!=nullptr)
+                ndarr->push(const_exp->ident);
         }
         else if(bnf_type==InitType::INIT_ARRAY)
         {
@@ -1710,6 +1924,8 @@ public:
             std::cout << ir_name << " = alloc i32";
             if (!is_global)
                 std::cout << std::endl;
+            if(is_global)
+                init_val->RequireConst(("initializer of global variable '"+ident+"'").c_str());
             init_val->Eval();
             if(is_global)
                 std::cout<<", "<<init_val->ident<<std::endl;
@@ -1738,7 +1954,7 @@ public:
             int ndim = 0;
             for (auto &exp : const_exps->vec)
             {
-                exp->Eval();
+                exp->RequireConst("array size");
                 dims.push_back(exp->val);
                 ndim++;
             }
@@ -1756,6 +1972,7 @@ public:
             int num_assigned = ndarr->get_currcnt();
             if(is_global)
             {
+                RequireLiteral(ndarr);
                 if(num_assigned==0)
                     std::cout<<", zeroinit"<<std::endl;
                 else
@@ -1779,7 +1996,7 @@ public:
             int ndim = 0;
             for (auto &exp : const_exps->vec)
             {
-                exp->Eval();
+                exp->RequireConst("array size");
                 ndim++;
                 dims.push_back(exp->val);
             }
@@ -1880,7 +2097,7 @@ public:
             int ndim=0;
             for(auto &exp : const_exps->vec)
             {
-                exp->Eval();
+                exp->RequireConst("array size");
                 dims.push_back(exp->val);
                 ndim++;
             }
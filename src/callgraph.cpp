@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include "callgraph.h"
+
+CallGraph::CallGraph(const IRModule &module)
+{
+    std::vector<IRFunction *> funcs;
+    for(IRFunction *func: module.funcs)
+    {
+        if(func->IsDecl())
+            continue;
+        funcs.push_back(func);
+        std::vector<IRFunction *> &edges=callees[func];
+        for(IRBlock *bb: func->blocks)
+            for(IRInst *inst: bb->insts)
+                if(inst->op==IR_CALL && !inst->callee->IsDecl() &&
+                   std::find(edges.begin(),edges.end(),inst->callee)==edges.end())
+                    edges.push_back(inst->callee);
+    }
+
+    // Tarjan 算法, 分量按完成的顺序给出, 正好是被调用者在前
+    std::map<IRFunction *,int> index,low;
+    std::vector<IRFunction *> stack;
+    std::set<IRFunction *> on_stack;
+    std::function<void(IRFunction *)> visit=[&](IRFunction *func)
+    {
+        int id=index.size();
+        index[func]=low[func]=id;
+        stack.push_back(func);
+        on_stack.insert(func);
+        for(IRFunction *callee: callees[func])
+        {
+            if(!index.count(callee))
+            {
+                visit(callee);
+                low[func]=std::min(low[func],low[callee]);
+            }
+            else if(on_stack.count(callee))
+                low[func]=std::min(low[func],index[callee]);
+        }
+        if(low[func]!=index[func])
+            return;
+        std::vector<IRFunction *> scc;
+        IRFunction *top;
+        do
+        {
+            top=stack.back();
+            stack.pop_back();
+            on_stack.erase(top);
+            scc_id[top]=sccs.size();
+            scc.push_back(top);
+        } while(top!=func);
+        sccs.push_back(scc);
+    };
+    for(IRFunction *func: funcs)
+        if(!index.count(func))
+            visit(func);
+
+    for(IRFunction *func: funcs)
+    {
+        const std::vector<IRFunction *> &edges=callees[func];
+        if(sccs[scc_id[func]].size()>1 || std::find(edges.begin(),edges.end(),func)!=edges.end())
+            recursive.insert(func);
+    }
+}
+
+const std::vector<IRFunction *> &CallGraph::Callees(IRFunction *func) const
+{
+    auto it=callees.find(func);
+    assert(it!=callees.end());
+    return it->second;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include "ir.h"
+
+// 调用图: 结点为有定义的函数, 边为函数体中的 call 指令; 只调用库函数 (声明) 的边不记录
+class CallGraph
+{
+public:
+    explicit CallGraph(const IRModule &module);
+
+    // func 直接调用的函数, 不重复
+    const std::vector<IRFunction *> &Callees(IRFunction *func) const;
+    // 强连通分量, 被调用的函数所在的分量排在调用者之前 (自底向上的顺序)
+    const std::vector<std::vector<IRFunction *>> &BottomUpSCCs() const { return sccs; }
+    bool SameSCC(IRFunction *a,IRFunction *b) const { return scc_id.at(a)==scc_id.at(b); }
+    // 是否在调用环上, 包括直接递归
+    bool IsRecursive(IRFunction *func) const { return recursive.count(func)!=0; }
+
+private:
+    std::map<IRFunction *,std::vector<IRFunction *>> callees;
+    std::vector<std::vector<IRFunction *>> sccs;
+    std::map<IRFunction *,int> scc_id;
+    std::set<IRFunction *> recursive;
+};
@@ -0,0 +1,207 @@
+#include <cassert>
+#include <cstdint>
+#include "const_arith.h"
+
+int ArithPlan::Add(ArithStepOp op,int lhs,int rhs,int imm)
+{
+    steps.push_back({op,lhs,rhs,imm});
+    return steps.size();
+}
+
+static int Log2Exact(uint32_t x)
+{
+    if(x==0 || (x&(x-1))!=0)
+        return -1;
+    int k=0;
+    while((1u<<k)!=x)
+        k++;
+    return k;
+}
+
+// 生成 x<<k, k 为 0 时直接返回 x
+static int EmitShift(ArithPlan &plan,int x,int k)
+{
+    if(k==0)
+        return x;
+    return plan.Add(AS_SLLI,x,0,k);
+}
+
+// 对 u = 2^a (+|-) 2^b 的形式展开乘法, 结果编号写入 res
+static bool PlanMulUnsigned(uint32_t u,ArithPlan &plan,int &res)
+{
+    int k=Log2Exact(u);
+    if(k>=0)
+    {
+        res=EmitShift(plan,0,k);
+        return true;
+    }
+    // u = 2^a + 2^b, a > b
+    uint32_t low=u&(~u+1);
+    int a=Log2Exact(u-low),b=Log2Exact(low);
+    if(a>=0)
+    {
+        int hi=EmitShift(plan,0,a),lo=EmitShift(plan,0,b);
+        res=plan.Add(AS_ADD,hi,lo,0);
+        return true;
+    }
+    // u = 2^a - 2^b, a <= 31
+    a=Log2Exact(u+low);
+    if(a>=0 && u+low!=0)
+    {
+        int hi=EmitShift(plan,0,a),lo=EmitShift(plan,0,b);
+        res=plan.Add(AS_SUB,hi,lo,0);
+        return true;
+    }
+    return false;
+}
+
+bool PlanMulConst(int c,int max_steps,ArithPlan &plan)
+{
+    plan.steps.clear();
+    if(c==0)
+        plan.Add(AS_LI,0,0,0);
+    else if(c==-1)
+        plan.Add(AS_NEG,0,0,0);
+    else
+    {
+        int res;
+        if(!PlanMulUnsigned((uint32_t)c,plan,res))
+        {
+            // -c 可以展开时再取负
+            plan.steps.clear();
+            if(!PlanMulUnsigned(-(uint32_t)c,plan,res))
+                return false;
+            plan.Add(AS_NEG,res,0,0);
+        }
+    }
+    return (int)plan.steps.size()<=max_steps;
+}
+
+// 有符号除法的魔数 (Hacker's Delight 10-1), 要求 2 <= |d| 且 d 不是 2 的幂
+static void SignedMagic(int d,int &magic,int &shift)
+{
+    const uint32_t two31=0x80000000u;
+    uint32_t ad=d<0?-(uint32_t)d:(uint32_t)d;
+    uint32_t t=two31+((uint32_t)d>>31);
+    uint32_t anc=t-1-t%ad;
+    int p=31;
+    uint32_t q1=two31/anc,r1=two31-q1*anc;
+    uint32_t q2=two31/ad,r2=two31-q2*ad;
+    uint32_t delta;
+    do
+    {
+        p++;
+        q1=2*q1;
+        r1=2*r1;
+        if(r1>=anc)
+        {
+            q1++;
+            r1-=anc;
+        }
+        q2=2*q2;
+        r2=2*r2;
+        if(r2>=ad)
+        {
+            q2++;
+            r2-=ad;
+        }
+        delta=ad-r2;
+    } while(q1<delta || (q1==delta && r1==0));
+    magic=(int)(q2+1);
+    if(d<0)
+        magic=-magic;
+    shift=p-32;
+}
+
+// 生成 x/d 的序列, 返回结果编号, 失败返回 -1
+static int EmitDiv(int d,bool allow_mulh,ArithPlan &plan)
+{
+    if(d==1)
+        return 0;
+    if(d==-1)
+        return plan.Add(AS_NEG,0,0,0);
+    uint32_t ad=d<0?-(uint32_t)d:(uint32_t)d;
+    int k=Log2Exact(ad);
+    if(k>=0)
+    {
+        // 负数先加上 2^k-1 再算术右移, 实现向零取整
+        int sign=k>1?plan.Add(AS_SRAI,0,0,k-1):0;
+        int bias=plan.Add(AS_SRLI,sign,0,32-k);
+        int sum=plan.Add(AS_ADD,0,bias,0);
+        int q=plan.Add(AS_SRAI,sum,0,k);
+        if(d<0)
+            q=plan.Add(AS_NEG,q,0,0);
+        return q;
+    }
+    if(!allow_mulh)
+        return -1;
+    int magic,shift;
+    SignedMagic(d,magic,shift);
+    int q=plan.Add(AS_MULHI,0,0,magic);
+    if(d>0 && magic<0)
+        q=plan.Add(AS_ADD,q,0,0);
+    else if(d<0 && magic>0)
+        q=plan.Add(AS_SUB,q,0,0);
+    if(shift>0)
+        q=plan.Add(AS_SRAI,q,0,shift);
+    // 商为负时加 1, 修正为向零取整
+    int sign=plan.Add(AS_SRLI,q,0,31);
+    return plan.Add(AS_ADD,q,sign,0);
+}
+
+bool PlanDivConst(int c,bool allow_mulh,ArithPlan &plan)
+{
+    plan.steps.clear();
+    if(c==0)
+        return false;
+    int q=EmitDiv(c,allow_mulh,plan);
+    if(q<0)
+        return false;
+    assert(q==plan.Result());
+    return true;
+}
+
+bool PlanModConst(int c,bool allow_mulh,ArithPlan &plan)
+{
+    plan.steps.clear();
+    if(c==0)
+        return false;
+    // x % c 与 x % |c| 相同, c 为 INT_MIN 时按 2^31 处理
+    uint32_t ad=c<0?-(uint32_t)c:(uint32_t)c;
+    if(ad==1)
+    {
+        plan.Add(AS_LI,0,0,0);
+        return true;
+    }
+    int k=Log2Exact(ad);
+    if(k>=0)
+    {
+        int sign=k>1?plan.Add(AS_SRAI,0,0,k-1):0;
+        int bias=plan.Add(AS_SRLI,sign,0,32-k);
+        int sum=plan.Add(AS_ADD,0,bias,0);
+        int rounded=plan.Add(AS_ANDI,sum,0,(int)(~(ad-1)));
+        plan.Add(AS_SUB,0,rounded,0);
+        return true;
+    }
+    int q=EmitDiv((int)ad,allow_mulh,plan);
+    if(q<0)
+        return false;
+    // x - q*|c|, 乘法能展开时用移位和加减
+    ArithPlan mul;
+    int prod;
+    if(PlanMulConst((int)ad,2,mul))
+    {
+        int base=plan.steps.size();
+        for(ArithStep step: mul.steps)
+        {
+            step.lhs=step.lhs==0?q:step.lhs+base;
+            step.rhs=step.rhs==0?q:step.rhs+base;
+            plan.steps.push_back(step);
+        }
+        prod=mul.steps.empty()?q:plan.Result();
+    }
+    else
+        prod=plan.Add(AS_MULI,q,0,(int)ad);
+    plan.Add(AS_SUB,0,prod,0);
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+// 常数乘法/除法/取模的强度削弱
+// 把 x*c, x/c, x%c 展开为移位, 加减和 mulh 组成的指令序列 (ArithPlan)
+// 后端和 Koopa 层的优化都使用同一份序列, 由调用者把每一步翻译成对应的指令
+
+enum ArithStepOp
+{
+    AS_LI,      // v = imm
+    AS_SLLI,    // v = lhs << imm
+    AS_SRLI,    // v = lhs >>u imm
+    AS_SRAI,    // v = lhs >>s imm
+    AS_ADD,     // v = lhs + rhs
+    AS_SUB,     // v = lhs - rhs
+    AS_ADDI,    // v = lhs + imm
+    AS_ANDI,    // v = lhs & imm
+    AS_NEG,     // v = -lhs
+    AS_MULI,    // v = lhs * imm
+    AS_MULHI    // v = (lhs * imm) >> 32, 有符号乘法的高 32 位
+};
+
+// 序列中的值用编号表示: 0 为输入 x, 第 i 步的结果编号为 i+1, 最后一步 (没有步骤时为 x) 是结果
+struct ArithStep
+{
+    ArithStepOp op;
+    int lhs;
+    int rhs;
+    int imm;
+};
+
+struct ArithPlan
+{
+    std::vector<ArithStep> steps;
+    int Result() const { return steps.size(); }
+    // 追加一步, 返回结果的编号
+    int Add(ArithStepOp op,int lhs,int rhs,int imm);
+};
+
+// x*c, 只使用移位和加减, 步数不超过 max_steps 时成功
+bool PlanMulConst(int c,int max_steps,ArithPlan &plan);
+// x/c (向零取整), allow_mulh 为 false 时只处理 c 为 +-1 和 +-2^k 的情况
+bool PlanDivConst(int c,bool allow_mulh,ArithPlan &plan);
+// x%c (结果与 x 同号)
+bool PlanModConst(int c,bool allow_mulh,ArithPlan &plan);
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <set>
+#include "dom.h"
+
+DomTree::DomTree(IRFunction *func,bool post)
+{
+    func->ComputePreds();
+    // 后支配树在反向的控制流图上计算, 根为连接所有返回的虚拟出口 (nullptr)
+    std::vector<IRBlock *> exits;
+    for(IRBlock *bb: func->blocks)
+    {
+        IRInst *term=bb->Terminator();
+        if(term!=nullptr && term->op==IR_RET)
+            exits.push_back(bb);
+    }
+    std::function<std::vector<IRBlock *>(IRBlock *)> succs_of,preds_of;
+    IRBlock *root;
+    if(post)
+    {
+        root=nullptr;
+        succs_of=[&](IRBlock *bb){ return bb==nullptr?exits:bb->preds; };
+        preds_of=[&](IRBlock *bb)
+        {
+            std::vector<IRBlock *> res=bb->Succs();
+            IRInst *term=bb->Terminator();
+            if(term!=nullptr && term->op==IR_RET)
+                res.push_back(nullptr);
+            return res;
+        };
+    }
+    else
+    {
+        root=func->Entry();
+        succs_of=[](IRBlock *bb){ return bb->Succs(); };
+        preds_of=[](IRBlock *bb){ return bb->preds; };
+    }
+
+    // 逆后序
+    std::set<IRBlock *> visited{root};
+    std::vector<std::pair<IRBlock *,size_t>> dfs{{root,0}};
+    while(!dfs.empty())
+    {
+        IRBlock *bb=dfs.back().first;
+        std::vector<IRBlock *> succs=succs_of(bb);
+        if(dfs.back().second<succs.size())
+        {
+            IRBlock *succ=succs[dfs.back().second++];
+            if(visited.insert(succ).second)
+                dfs.push_back({succ,0});
+        }
+        else
+        {
+            rpo.push_back(bb);
+            dfs.pop_back();
+        }
+    }
+    std::reverse(rpo.begin(),rpo.end());
+    for(int i=0;i<(int)rpo.size();++i)
+        order[rpo[i]]=i;
+
+    // 两个基本块在支配树上的最近公共祖先, 沿逆后序编号较大的一侧向上走
+    auto intersect=[&](IRBlock *a,IRBlock *b)
+    {
+        while(a!=b)
+        {
+            while(order[a]>order[b])
+                a=idom[a];
+            while(order[b]>order[a])
+                b=idom[b];
+        }
+        return a;
+    };
+    idom[root]=root;
+    bool changed=true;
+    while(changed)
+    {
+        changed=false;
+        for(int i=1;i<(int)rpo.size();++i)
+        {
+            IRBlock *bb=rpo[i];
+            IRBlock *new_idom=nullptr;
+            bool found=false;
+            for(IRBlock *pred: preds_of(bb))
+            {
+                if(!idom.count(pred))
+                    continue;
+                new_idom=found?intersect(pred,new_idom):pred;
+                found=true;
+            }
+            assert(found);
+            if(!idom.count(bb) || idom[bb]!=new_idom)
+            {
+                idom[bb]=new_idom;
+                changed=true;
+            }
+        }
+    }
+    for(int i=1;i<(int)rpo.size();++i)
+        children[idom[rpo[i]]].push_back(rpo[i]);
+
+    // 支配边界: 从每个汇合点的前驱沿支配树向上, 直到汇合点的直接支配者
+    for(IRBlock *bb: rpo)
+    {
+        if(bb==nullptr)
+            continue;
+        std::vector<IRBlock *> preds=preds_of(bb);
+        if(preds.size()<2)
+            continue;
+        for(IRBlock *pred: preds)
+        {
+            if(pred==nullptr || !order.count(pred))
+                continue;
+            for(IRBlock *runner=pred;runner!=idom[bb];runner=idom[runner])
+            {
+                std::vector<IRBlock *> &df=frontier[runner];
+                if(df.empty() || df.back()!=bb)
+                    df.push_back(bb);
+            }
+        }
+    }
+
+    int timer=0;
+    std::vector<std::pair<IRBlock *,size_t>> stack{{root,0}};
+    dfs_in[root]=timer++;
+    while(!stack.empty())
+    {
+        IRBlock *bb=stack.back().first;
+        const std::vector<IRBlock *> &kids=Children(bb);
+        if(stack.back().second<kids.size())
+        {
+            IRBlock *kid=kids[stack.back().second++];
+            dfs_in[kid]=timer++;
+            stack.push_back({kid,0});
+        }
+        else
+        {
+            dfs_out[bb]=timer++;
+            stack.pop_back();
+        }
+    }
+    if(post)
+        rpo.erase(rpo.begin());
+    order.erase(nullptr);
+    idom[root]=nullptr;
+}
+
+IRBlock *DomTree::IDom(IRBlock *bb) const
+{
+    auto it=idom.find(bb);
+    return it==idom.end()?nullptr:it->second;
+}
+const std::vector<IRBlock *> &DomTree::Children(IRBlock *bb) const
+{
+    static const std::vector<IRBlock *> empty;
+    auto it=children.find(bb);
+    return it==children.end()?empty:it->second;
+}
+const std::vector<IRBlock *> &DomTree::Frontier(IRBlock *bb) const
+{
+    static const std::vector<IRBlock *> empty;
+    auto it=frontier.find(bb);
+    return it==frontier.end()?empty:it->second;
+}
+bool DomTree::Dominates(IRBlock *a,IRBlock *b) const
+{
+    if(!Reachable(a) || !Reachable(b))
+        return false;
+    return dfs_in.at(a)<=dfs_in.at(b) && dfs_out.at(b)<=dfs_out.at(a);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include "ir.h"
+
+// 支配树和支配边界, 只包含从入口可达的基本块
+// 用 Cooper-Harvey-Kennedy 的迭代算法按逆后序计算, 函数修改后需要重新构造
+// post 为 true 时在反向的控制流图上计算后支配树, 根为所有 ret 汇合到的虚拟出口,
+// 此时只包含能到达 ret 的基本块, 支配边界即控制依赖: bb 控制依赖于 Frontier(bb) 中各基本块的分支
+class DomTree
+{
+public:
+    explicit DomTree(IRFunction *func,bool post=false);
+
+    bool Reachable(IRBlock *bb) const { return order.count(bb)!=0; }
+    // 直接支配者, 入口返回 nullptr (后支配树中直接后支配者为虚拟出口时也返回 nullptr)
+    IRBlock *IDom(IRBlock *bb) const;
+    const std::vector<IRBlock *> &Children(IRBlock *bb) const;
+    const std::vector<IRBlock *> &Frontier(IRBlock *bb) const;
+    // a 是否支配 b (包括 a==b)
+    bool Dominates(IRBlock *a,IRBlock *b) const;
+    // 可达基本块的逆后序, 每个基本块都排在它支配的基本块之前
+    const std::vector<IRBlock *> &RPO() const { return rpo; }
+
+private:
+    std::vector<IRBlock *> rpo;
+    std::map<IRBlock *,int> order;      // 在逆后序中的位置
+    std::map<IRBlock *,IRBlock *> idom;
+    std::map<IRBlock *,std::vector<IRBlock *>> children;
+    std::map<IRBlock *,std::vector<IRBlock *>> frontier;
+    // 支配树上深度优先搜索的进入和离开时间, 用于 O(1) 判断支配关系
+    std::map<IRBlock *,int> dfs_in,dfs_out;
+};
@@ -0,0 +1,986 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <set>
+#include "ir.h"
+
+// 类型
+
+IRType *IRType::Int32()
+{
+    static IRType ty{IRT_INT32,nullptr,0};
+    return &ty;
+}
+IRType *IRType::Unit()
+{
+    static IRType ty{IRT_UNIT,nullptr,0};
+    return &ty;
+}
+IRType *IRType::Array(IRType *base,int len)
+{
+    static std::map<std::pair<IRType *,int>,std::unique_ptr<IRType>> types;
+    auto &ty=types[{base,len}];
+    if(!ty)
+        ty.reset(new IRType{IRT_ARRAY,base,len});
+    return ty.get();
+}
+IRType *IRType::Pointer(IRType *base)
+{
+    static std::map<IRType *,std::unique_ptr<IRType>> types;
+    auto &ty=types[base];
+    if(!ty)
+        ty.reset(new IRType{IRT_POINTER,base,0});
+    return ty.get();
+}
+int IRType::Size() const
+{
+    if(tag==IRT_ARRAY)
+        return len*base->Size();
+    if(tag==IRT_UNIT)
+        return 0;
+    return 4;
+}
+std::string IRType::ToString() const
+{
+    switch (tag)
+    {
+    case IRT_INT32:
+        return "i32";
+    case IRT_UNIT:
+        return "unit";
+    case IRT_ARRAY:
+        return "["+base->ToString()+", "+std::to_string(len)+"]";
+    case IRT_POINTER:
+        return "*"+base->ToString();
+    }
+    return "";
+}
+
+// 值与指令
+
+IRInst *IRValue::AsInst()
+{
+    return kind==IRV_INST?static_cast<IRInst *>(this):nullptr;
+}
+void IRValue::ReplaceAllUsesWith(IRValue *v)
+{
+    if(v==this)
+        return;
+    std::vector<IRInst *> old_users=users;
+    for(IRInst *user: old_users)
+    {
+        for(size_t i=0;i<user->ops.size();++i)
+            if(user->ops[i]==this)
+                user->SetOperand(i,v);
+    }
+}
+void IRValue::RemoveUser(IRInst *user)
+{
+    auto it=std::find(users.begin(),users.end(),user);
+    assert(it!=users.end());
+    users.erase(it);
+}
+
+void IRInst::SetOperand(int i,IRValue *v)
+{
+    IRValue *old=ops[i];
+    if(old==v)
+        return;
+    if(old!=nullptr && old->TracksUsers())
+        old->RemoveUser(this);
+    ops[i]=v;
+    if(v->TracksUsers())
+        v->users.push_back(this);
+}
+void IRInst::AddOperand(IRValue *v)
+{
+    ops.push_back(v);
+    if(v->TracksUsers())
+        v->users.push_back(this);
+}
+void IRInst::DropOperands()
+{
+    for(IRValue *v: ops)
+        if(v->TracksUsers())
+            v->RemoveUser(this);
+    ops.clear();
+    succ_arg_begin.assign(succ_arg_begin.size(),0);
+}
+int IRInst::NumSuccArgs(int s) const
+{
+    int end=(s+1<(int)succs.size())?succ_arg_begin[s+1]:ops.size();
+    return end-succ_arg_begin[s];
+}
+std::vector<IRValue *> IRInst::SuccArgs(int s) const
+{
+    std::vector<IRValue *> args;
+    for(int j=0;j<NumSuccArgs(s);++j)
+        args.push_back(SuccArg(s,j));
+    return args;
+}
+void IRInst::SetSuccArgs(int s,const std::vector<IRValue *> &args)
+{
+    std::vector<std::vector<IRValue *>> all;
+    for(int i=0;i<(int)succs.size();++i)
+        all.push_back(i==s?args:SuccArgs(i));
+    IRValue *cond=(op==IR_BRANCH)?ops[0]:nullptr;
+    DropOperands();
+    if(cond!=nullptr)
+        AddOperand(cond);
+    for(int i=0;i<(int)succs.size();++i)
+    {
+        succ_arg_begin[i]=ops.size();
+        for(IRValue *v: all[i])
+            AddOperand(v);
+    }
+}
+void IRInst::EraseFromParent()
+{
+    if(block!=nullptr)
+    {
+        auto &insts=block->insts;
+        insts.erase(std::find(insts.begin(),insts.end(),this));
+        block=nullptr;
+    }
+    DropOperands();
+}
+
+// 基本块
+
+IRInst *IRBlock::Terminator() const
+{
+    if(insts.empty() || !insts.back()->IsTerminator())
+        return nullptr;
+    return insts.back();
+}
+std::vector<IRBlock *> IRBlock::Succs() const
+{
+    IRInst *term=Terminator();
+    if(term==nullptr)
+        return {};
+    return term->succs;
+}
+void IRBlock::Append(IRInst *inst)
+{
+    inst->block=this;
+    insts.push_back(inst);
+}
+void IRBlock::Insert(int pos,IRInst *inst)
+{
+    inst->block=this;
+    insts.insert(insts.begin()+pos,inst);
+}
+void IRBlock::InsertBeforeTerminator(IRInst *inst)
+{
+    int pos=insts.size();
+    if(Terminator()!=nullptr)
+        pos--;
+    Insert(pos,inst);
+}
+IRValue *IRBlock::AddParam(IRType *ty,const std::string &hint)
+{
+    IRValue *param=parent->module->NewValue(IRV_BLOCK_ARG,ty);
+    param->block=this;
+    param->arg_index=params.size();
+    param->name=hint;
+    params.push_back(param);
+    return param;
+}
+void IRBlock::RemoveParam(int i)
+{
+    params.erase(params.begin()+i);
+    for(int j=0;j<(int)params.size();++j)
+        params[j]->arg_index=j;
+}
+
+// 函数
+
+void IRFunction::ComputePreds()
+{
+    for(IRBlock *bb: blocks)
+        bb->preds.clear();
+    for(IRBlock *bb: blocks)
+        for(IRBlock *succ: bb->Succs())
+            succ->preds.push_back(bb);
+}
+std::vector<IRBlock *> IRFunction::ReversePostOrder() const
+{
+    std::vector<IRBlock *> order;
+    if(blocks.empty())
+        return order;
+    std::set<IRBlock *> visited;
+    // 迭代的深度优先搜索, 栈中保存基本块和下一个要访问的后继
+    std::vector<std::pair<IRBlock *,size_t>> stack;
+    stack.push_back({Entry(),0});
+    visited.insert(Entry());
+    while(!stack.empty())
+    {
+        IRBlock *bb=stack.back().first;
+        std::vector<IRBlock *> succs=bb->Succs();
+        if(stack.back().second<succs.size())
+        {
+            IRBlock *succ=succs[stack.back().second++];
+            if(visited.insert(succ).second)
+                stack.push_back({succ,0});
+        }
+        else
+        {
+            order.push_back(bb);
+            stack.pop_back();
+        }
+    }
+    std::reverse(order.begin(),order.end());
+    return order;
+}
+bool IRFunction::RemoveUnreachable()
+{
+    std::vector<IRBlock *> rpo=ReversePostOrder();
+    if(rpo.size()==blocks.size())
+        return false;
+    std::set<IRBlock *> reachable(rpo.begin(),rpo.end());
+    std::vector<IRBlock *> kept;
+    for(IRBlock *bb: blocks)
+    {
+        if(reachable.count(bb))
+        {
+            kept.push_back(bb);
+            continue;
+        }
+        for(IRInst *inst: bb->insts)
+            inst->DropOperands();
+        bb->insts.clear();
+    }
+    blocks=kept;
+    ComputePreds();
+    return true;
+}
+void IRFunction::EnsureEntryNoPreds()
+{
+    ComputePreds();
+    IRBlock *old_entry=Entry();
+    if(old_entry->preds.empty() && old_entry->params.empty())
+        return;
+    IRBlock *entry=module->NewBlock(this,"%_entry");
+    blocks.pop_back();
+    blocks.insert(blocks.begin(),entry);
+    // alloc 留在入口基本块中
+    std::vector<IRInst *> rest;
+    for(IRInst *inst: old_entry->insts)
+    {
+        if(inst->op==IR_ALLOC)
+            entry->Append(inst);
+        else
+            rest.push_back(inst);
+    }
+    old_entry->insts=rest;
+    std::vector<IRValue *> args;
+    for(IRValue *param: old_entry->params)
+        args.push_back(module->GetUndef(param->ty));
+    entry->Append(module->NewJump(old_entry,args));
+    ComputePreds();
+}
+int IRFunction::InstCount() const
+{
+    int cnt=0;
+    for(IRBlock *bb: blocks)
+        cnt+=bb->insts.size();
+    return cnt;
+}
+bool IRFunction::HasLoop() const
+{
+    std::map<IRBlock *,int> order;
+    for(IRBlock *bb: ReversePostOrder())
+        order[bb]=order.size();
+    for(auto &[bb,i]: order)
+        for(IRBlock *succ: bb->Succs())
+            if(order[succ]<=i)
+                return true;
+    return false;
+}
+
+// 模块
+
+IRValue *IRModule::NewValue(IRValueKind kind,IRType *ty)
+{
+    value_pool.emplace_back(new IRValue(kind,ty));
+    return value_pool.back().get();
+}
+IRValue *IRModule::GetConst(int v)
+{
+    auto it=consts.find(v);
+    if(it!=consts.end())
+        return it->second;
+    IRValue *c=NewValue(IRV_CONST,IRType::Int32());
+    c->const_val=v;
+    consts[v]=c;
+    return c;
+}
+IRValue *IRModule::GetUndef(IRType *ty)
+{
+    auto it=undefs.find(ty);
+    if(it!=undefs.end())
+        return it->second;
+    IRValue *u=NewValue(IRV_UNDEF,ty);
+    undefs[ty]=u;
+    return u;
+}
+IRFunction *IRModule::FindFunction(const std::string &name) const
+{
+    for(IRFunction *func: funcs)
+        if(func->name==name)
+            return func;
+    return nullptr;
+}
+IRGlobal *IRModule::NewGlobal(IRType *alloc_ty,const std::string &name)
+{
+    IRGlobal *global=new IRGlobal(alloc_ty);
+    value_pool.emplace_back(global);
+    global->name=name;
+    globals.push_back(global);
+    return global;
+}
+IRFunction *IRModule::NewFunction(const std::string &name,IRType *ret_ty,const std::vector<IRType *> &param_tys)
+{
+    IRFunction *func=new IRFunction;
+    func_pool.emplace_back(func);
+    func->name=name;
+    func->ret_ty=ret_ty;
+    func->param_tys=param_tys;
+    func->module=this;
+    for(size_t i=0;i<param_tys.size();++i)
+    {
+        IRValue *param=NewValue(IRV_FUNC_ARG,param_tys[i]);
+        param->arg_index=i;
+        func->params.push_back(param);
+    }
+    funcs.push_back(func);
+    return func;
+}
+IRBlock *IRModule::NewBlock(IRFunction *func,const std::string &name)
+{
+    IRBlock *bb=new IRBlock;
+    block_pool.emplace_back(bb);
+    bb->name=name;
+    bb->parent=func;
+    func->blocks.push_back(bb);
+    return bb;
+}
+
+IRInst *IRModule::NewInst(IROp op,IRType *ty)
+{
+    IRInst *inst=new IRInst(op,ty);
+    value_pool.emplace_back(inst);
+    return inst;
+}
+IRInst *IRModule::NewAlloc(IRType *alloc_ty)
+{
+    IRInst *inst=NewInst(IR_ALLOC,IRType::Pointer(alloc_ty));
+    inst->alloc_ty=alloc_ty;
+    return inst;
+}
+IRInst *IRModule::NewLoad(IRValue *src)
+{
+    IRInst *inst=NewInst(IR_LOAD,src->ty->base);
+    inst->AddOperand(src);
+    return inst;
+}
+IRInst *IRModule::NewStore(IRValue *value,IRValue *dest)
+{
+    IRInst *inst=NewInst(IR_STORE,IRType::Unit());
+    inst->AddOperand(value);
+    inst->AddOperand(dest);
+    return inst;
+}
+IRInst *IRModule::NewGep(IRValue *src,IRValue *index)
+{
+    assert(src->ty->tag==IRT_POINTER && src->ty->base->tag==IRT_ARRAY);
+    IRInst *inst=NewInst(IR_GEP,IRType::Pointer(src->ty->base->base));
+    inst->AddOperand(src);
+    inst->AddOperand(index);
+    return inst;
+}
+IRInst *IRModule::NewGetPtr(IRValue *src,IRValue *index)
+{
+    assert(src->ty->tag==IRT_POINTER);
+    IRInst *inst=NewInst(IR_GETPTR,src->ty);
+    inst->AddOperand(src);
+    inst->AddOperand(index);
+    return inst;
+}
+IRInst *IRModule::NewBinary(koopa_raw_binary_op_t bop,IRValue *lhs,IRValue *rhs)
+{
+    IRInst *inst=NewInst(IR_BINARY,IRType::Int32());
+    inst->bop=bop;
+    inst->AddOperand(lhs);
+    inst->AddOperand(rhs);
+    return inst;
+}
+IRInst *IRModule::NewCall(IRFunction *callee,const std::vector<IRValue *> &args)
+{
+    IRInst *inst=NewInst(IR_CALL,callee->ret_ty);
+    inst->callee=callee;
+    for(IRValue *arg: args)
+        inst->AddOperand(arg);
+    return inst;
+}
+IRInst *IRModule::NewJump(IRBlock *target,const std::vector<IRValue *> &args)
+{
+    IRInst *inst=NewInst(IR_JUMP,IRType::Unit());
+    inst->succs.push_back(target);
+    inst->succ_arg_begin.push_back(0);
+    for(IRValue *arg: args)
+        inst->AddOperand(arg);
+    return inst;
+}
+IRInst *IRModule::NewBranch(IRValue *cond,IRBlock *t,const std::vector<IRValue *> &targs,
+                            IRBlock *f,const std::vector<IRValue *> &fargs)
+{
+    IRInst *inst=NewInst(IR_BRANCH,IRType::Unit());
+    inst->AddOperand(cond);
+    inst->succs={t,f};
+    inst->succ_arg_begin.push_back(inst->ops.size());
+    for(IRValue *arg: targs)
+        inst->AddOperand(arg);
+    inst->succ_arg_begin.push_back(inst->ops.size());
+    for(IRValue *arg: fargs)
+        inst->AddOperand(arg);
+    return inst;
+}
+IRInst *IRModule::NewRet(IRValue *v)
+{
+    IRInst *inst=NewInst(IR_RET,IRType::Unit());
+    if(v!=nullptr)
+        inst->AddOperand(v);
+    return inst;
+}
+IRInst *IRModule::CloneInst(const IRInst *inst,const std::map<IRValue *,IRValue *> &vmap,
+                            const std::map<IRBlock *,IRBlock *> &bmap)
+{
+    IRInst *clone=NewInst(inst->op,inst->ty);
+    clone->name=inst->name;
+    clone->bop=inst->bop;
+    clone->alloc_ty=inst->alloc_ty;
+    clone->callee=inst->callee;
+    clone->succ_arg_begin=inst->succ_arg_begin;
+    for(IRValue *v: inst->ops)
+    {
+        auto it=vmap.find(v);
+        clone->AddOperand(it!=vmap.end()?it->second:v);
+    }
+    for(IRBlock *bb: inst->succs)
+    {
+        auto it=bmap.find(bb);
+        clone->succs.push_back(it!=bmap.end()?it->second:bb);
+    }
+    return clone;
+}
+
+// 由 raw program 构造
+
+static IRType *ConvertType(const koopa_raw_type_t &ty)
+{
+    switch (ty->tag)
+    {
+    case KOOPA_RTT_INT32:
+        return IRType::Int32();
+    case KOOPA_RTT_UNIT:
+        return IRType::Unit();
+    case KOOPA_RTT_ARRAY:
+        return IRType::Array(ConvertType(ty->data.array.base),ty->data.array.len);
+    case KOOPA_RTT_POINTER:
+        return IRType::Pointer(ConvertType(ty->data.pointer.base));
+    default:
+        assert(false);
+    }
+    return nullptr;
+}
+static void FlattenInit(const koopa_raw_value_t &init,std::vector<int> &vals)
+{
+    switch (init->kind.tag)
+    {
+    case KOOPA_RVT_INTEGER:
+        vals.push_back(init->kind.data.integer.value);
+        break;
+    case KOOPA_RVT_ZERO_INIT:
+    case KOOPA_RVT_UNDEF:
+        vals.resize(vals.size()+ConvertType(init->ty)->Size()/4,0);
+        break;
+    case KOOPA_RVT_AGGREGATE:
+    {
+        const koopa_raw_slice_t &elems=init->kind.data.aggregate.elems;
+        for(uint32_t i=0;i<elems.len;++i)
+            FlattenInit(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]),vals);
+        break;
+    }
+    default:
+        assert(false);
+    }
+}
+
+void BuildIR(const koopa_raw_program_t &raw,IRModule &module)
+{
+    std::map<koopa_raw_value_t,IRValue *> values;
+    std::map<koopa_raw_function_t,IRFunction *> funcs;
+
+    for(uint32_t i=0;i<raw.values.len;++i)
+    {
+        auto value=reinterpret_cast<koopa_raw_value_t>(raw.values.buffer[i]);
+        assert(value->kind.tag==KOOPA_RVT_GLOBAL_ALLOC);
+        IRGlobal *global=module.NewGlobal(ConvertType(value->ty->data.pointer.base),value->name);
+        const koopa_raw_value_t &init=value->kind.data.global_alloc.init;
+        if(init->kind.tag!=KOOPA_RVT_ZERO_INIT && init->kind.tag!=KOOPA_RVT_UNDEF)
+        {
+            FlattenInit(init,global->init);
+            global->zero_init=std::all_of(global->init.begin(),global->init.end(),[](int v){return v==0;});
+            if(global->zero_init)
+                global->init.clear();
+        }
+        values[value]=global;
+    }
+    for(uint32_t i=0;i<raw.funcs.len;++i)
+    {
+        auto func=reinterpret_cast<koopa_raw_function_t>(raw.funcs.buffer[i]);
+        std::vector<IRType *> param_tys;
+        const koopa_raw_slice_t &raw_params=func->ty->data.function.params;
+        for(uint32_t j=0;j<raw_params.len;++j)
+            param_tys.push_back(ConvertType(reinterpret_cast<koopa_raw_type_t>(raw_params.buffer[j])));
+        IRFunction *ir_func=module.NewFunction(func->name,ConvertType(func->ty->data.function.ret),param_tys);
+        for(uint32_t j=0;j<func->params.len;++j)
+        {
+            auto param=reinterpret_cast<koopa_raw_value_t>(func->params.buffer[j]);
+            if(param->name!=nullptr)
+                ir_func->params[j]->name=param->name;
+            values[param]=ir_func->params[j];
+        }
+        funcs[func]=ir_func;
+    }
+
+    for(auto &item: funcs)
+    {
+        koopa_raw_function_t func=item.first;
+        IRFunction *ir_func=item.second;
+        std::map<koopa_raw_basic_block_t,IRBlock *> blocks;
+        // 先创建所有基本块和指令, 再填写操作数, 以处理前向引用
+        for(uint32_t j=0;j<func->bbs.len;++j)
+        {
+            auto bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[j]);
+            IRBlock *ir_bb=module.NewBlock(ir_func,bb->name!=nullptr?bb->name:"%_bb");
+            for(uint32_t k=0;k<bb->params.len;++k)
+            {
+                auto param=reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[k]);
+                values[param]=ir_bb->AddParam(ConvertType(param->ty));
+            }
+            blocks[bb]=ir_bb;
+        }
+        std::vector<std::pair<koopa_raw_value_t,IRInst *>> insts;
+        for(uint32_t j=0;j<func->bbs.len;++j)
+        {
+            auto bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[j]);
+            for(uint32_t k=0;k<bb->insts.len;++k)
+            {
+                auto value=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[k]);
+                IROp op;
+                switch (value->kind.tag)
+                {
+                case KOOPA_RVT_ALLOC: op=IR_ALLOC; break;
+                case KOOPA_RVT_LOAD: op=IR_LOAD; break;
+                case KOOPA_RVT_STORE: op=IR_STORE; break;
+                case KOOPA_RVT_GET_PTR: op=IR_GETPTR; break;
+                case KOOPA_RVT_GET_ELEM_PTR: op=IR_GEP; break;
+                case KOOPA_RVT_BINARY: op=IR_BINARY; break;
+                case KOOPA_RVT_BRANCH: op=IR_BRANCH; break;
+                case KOOPA_RVT_JUMP: op=IR_JUMP; break;
+                case KOOPA_RVT_CALL: op=IR_CALL; break;
+                case KOOPA_RVT_RETURN: op=IR_RET; break;
+                default: assert(false);
+                }
+                IRInst *inst=module.NewInst(op,ConvertType(value->ty));
+                if(value->name!=nullptr)
+                    inst->name=value->name;
+                if(op==IR_ALLOC)
+                    inst->alloc_ty=inst->ty->base;
+                blocks[bb]->Append(inst);
+                values[value]=inst;
+                insts.push_back({value,inst});
+            }
+        }
+
+        auto lookup=[&](const koopa_raw_value_t &v)->IRValue *
+        {
+            if(v->kind.tag==KOOPA_RVT_INTEGER)
+                return module.GetConst(v->kind.data.integer.value);
+            if(v->kind.tag==KOOPA_RVT_UNDEF)
+                return module.GetUndef(ConvertType(v->ty));
+            auto it=values.find(v);
+            assert(it!=values.end());
+            return it->second;
+        };
+        auto add_args=[&](IRInst *inst,const koopa_raw_slice_t &args)
+        {
+            inst->succ_arg_begin.push_back(inst->ops.size());
+            for(uint32_t a=0;a<args.len;++a)
+                inst->AddOperand(lookup(reinterpret_cast<koopa_raw_value_t>(args.buffer[a])));
+        };
+        for(auto &pair: insts)
+        {
+            const auto &kind=pair.first->kind;
+            IRInst *inst=pair.second;
+            switch (kind.tag)
+            {
+            case KOOPA_RVT_LOAD:
+                inst->AddOperand(lookup(kind.data.load.src));
+                break;
+            case KOOPA_RVT_STORE:
+                inst->AddOperand(lookup(kind.data.store.value));
+                inst->AddOperand(lookup(kind.data.store.dest));
+                break;
+            case KOOPA_RVT_GET_PTR:
+                inst->AddOperand(lookup(kind.data.get_ptr.src));
+                inst->AddOperand(lookup(kind.data.get_ptr.index));
+                break;
+            case KOOPA_RVT_GET_ELEM_PTR:
+                inst->AddOperand(lookup(kind.data.get_elem_ptr.src));
+                inst->AddOperand(lookup(kind.data.get_elem_ptr.index));
+                break;
+            case KOOPA_RVT_BINARY:
+                inst->bop=kind.data.binary.op;
+                inst->AddOperand(lookup(kind.data.binary.lhs));
+                inst->AddOperand(lookup(kind.data.binary.rhs));
+                break;
+            case KOOPA_RVT_BRANCH:
+                inst->AddOperand(lookup(kind.data.branch.cond));
+                inst->succs={blocks[kind.data.branch.true_bb],blocks[kind.data.branch.false_bb]};
+                add_args(inst,kind.data.branch.true_args);
+                add_args(inst,kind.data.branch.false_args);
+                break;
+            case KOOPA_RVT_JUMP:
+                inst->succs={blocks[kind.data.jump.target]};
+                add_args(inst,kind.data.jump.args);
+                break;
+            case KOOPA_RVT_CALL:
+                inst->callee=funcs[kind.data.call.callee];
+                for(uint32_t a=0;a<kind.data.call.args.len;++a)
+                    inst->AddOperand(lookup(reinterpret_cast<koopa_raw_value_t>(kind.data.call.args.buffer[a])));
+                break;
+            case KOOPA_RVT_RETURN:
+                if(kind.data.ret.value!=nullptr)
+                    inst->AddOperand(lookup(kind.data.ret.value));
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    // 保持 raw program 中函数的顺序
+    std::vector<IRFunction *> order;
+    for(uint32_t i=0;i<raw.funcs.len;++i)
+        order.push_back(funcs[reinterpret_cast<koopa_raw_function_t>(raw.funcs.buffer[i])]);
+    module.funcs=order;
+}
+
+// 输出 Koopa IR
+
+static const char *BinaryOpName(koopa_raw_binary_op_t op)
+{
+    static const char *names[]=
+    {
+        "ne","eq","gt","lt","ge","le","add","sub","mul","div","mod","and","or","xor","shl","shr","sar"
+    };
+    return names[op];
+}
+
+static void PrintInit(const IRGlobal *global,IRType *ty,int &pos,std::ostream &os)
+{
+    if(ty->tag!=IRT_ARRAY)
+    {
+        os<<global->InitAt(pos++);
+        return;
+    }
+    os<<"{";
+    for(int i=0;i<ty->len;++i)
+    {
+        if(i)
+            os<<", ";
+        PrintInit(global,ty->base,pos,os);
+    }
+    os<<"}";
+}
+
+// 为函数内的值和基本块分配不重复的名字
+// 后端把基本块名直接用作汇编标号, 所以基本块名在整个模块中都不重复, labels 由所有函数共用
+class IRNamer
+{
+public:
+    IRNamer(const std::set<std::string> &module_names,std::set<std::string> &labels):
+        used(module_names),labels(labels){}
+    std::string Name(const IRValue *v,char prefix='%')
+    {
+        auto it=names.find(v);
+        if(it!=names.end())
+            return it->second;
+        std::string name;
+        if(IsIdent(v->name))
+            name=Unique(v->name);
+        else
+        {
+            do
+                name=std::string(1,prefix)+std::to_string(counter++);
+            while(used.count(name));
+            used.insert(name);
+        }
+        names[v]=name;
+        return name;
+    }
+    std::string Name(const IRBlock *bb)
+    {
+        auto it=bb_names.find(bb);
+        if(it!=bb_names.end())
+            return it->second;
+        std::string hint=IsIdent(bb->name)?bb->name:"%_bb",name=hint;
+        for(int i=1;used.count(name) || labels.count(name);++i)
+            name=hint+"_"+std::to_string(i);
+        used.insert(name);
+        labels.insert(name);
+        bb_names[bb]=name;
+        return name;
+    }
+
+private:
+    std::set<std::string> used;
+    std::set<std::string> &labels;
+    std::map<const IRValue *,std::string> names;
+    std::map<const IRBlock *,std::string> bb_names;
+    int counter=0;
+
+    // 形如 @x 或 %x 且 x 不以数字开头的名字才保留
+    static bool IsIdent(const std::string &name)
+    {
+        return name.size()>=2 && (name[0]=='@' || name[0]=='%') && !isdigit((unsigned char)name[1]);
+    }
+    std::string Unique(const std::string &name)
+    {
+        std::string res=name;
+        for(int i=1;used.count(res);++i)
+            res=name+"_"+std::to_string(i);
+        used.insert(res);
+        return res;
+    }
+};
+
+static std::string Operand(const IRValue *v,IRNamer &namer)
+{
+    if(v->kind==IRV_CONST)
+        return std::to_string(v->const_val);
+    if(v->kind==IRV_UNDEF)
+        return "undef";
+    if(v->kind==IRV_GLOBAL)
+        return v->name;
+    return namer.Name(v);
+}
+
+static void PrintTarget(const IRInst *inst,int s,IRNamer &namer,std::ostream &os)
+{
+    os<<namer.Name(inst->succs[s]);
+    int n=inst->NumSuccArgs(s);
+    if(n==0)
+        return;
+    os<<"(";
+    for(int j=0;j<n;++j)
+    {
+        if(j)
+            os<<", ";
+        os<<Operand(inst->SuccArg(s,j),namer);
+    }
+    os<<")";
+}
+
+static void PrintInst(const IRInst *inst,IRNamer &namer,std::ostream &os)
+{
+    os<<"  ";
+    if(inst->ty->tag!=IRT_UNIT)
+        os<<namer.Name(inst)<<" = ";
+    switch (inst->op)
+    {
+    case IR_ALLOC:
+        os<<"alloc "<<inst->alloc_ty->ToString();
+        break;
+    case IR_LOAD:
+        os<<"load "<<Operand(inst->ops[0],namer);
+        break;
+    case IR_STORE:
+        os<<"store "<<Operand(inst->ops[0],namer)<<", "<<Operand(inst->ops[1],namer);
+        break;
+    case IR_GEP:
+        os<<"getelemptr "<<Operand(inst->ops[0],namer)<<", "<<Operand(inst->ops[1],namer);
+        break;
+    case IR_GETPTR:
+        os<<"getptr "<<Operand(inst->ops[0],namer)<<", "<<Operand(inst->ops[1],namer);
+        break;
+    case IR_BINARY:
+        os<<BinaryOpName(inst->bop)<<" "<<Operand(inst->ops[0],namer)<<", "<<Operand(inst->ops[1],namer);
+        break;
+    case IR_CALL:
+        os<<"call "<<inst->callee->name<<"(";
+        for(size_t i=0;i<inst->ops.size();++i)
+            os<<(i?", ":"")<<Operand(inst->ops[i],namer);
+        os<<")";
+        break;
+    case IR_BRANCH:
+        os<<"br "<<Operand(inst->ops[0],namer)<<", ";
+        PrintTarget(inst,0,namer,os);
+        os<<", ";
+        PrintTarget(inst,1,namer,os);
+        break;
+    case IR_JUMP:
+        os<<"jump ";
+        PrintTarget(inst,0,namer,os);
+        break;
+    case IR_RET:
+        os<<"ret";
+        if(!inst->ops.empty())
+            os<<" "<<Operand(inst->ops[0],namer);
+        break;
+    }
+    os<<std::endl;
+}
+
+void PrintIR(const IRModule &module,std::ostream &os)
+{
+    std::set<std::string> module_names;
+    for(IRGlobal *global: module.globals)
+        module_names.insert(global->name);
+    for(IRFunction *func: module.funcs)
+        module_names.insert(func->name);
+
+    for(IRFunction *func: module.funcs)
+    {
+        if(!func->IsDecl())
+            continue;
+        os<<"decl "<<func->name<<"(";
+        for(size_t i=0;i<func->param_tys.size();++i)
+            os<<(i?", ":"")<<func->param_tys[i]->ToString();
+        os<<")";
+        if(func->ret_ty->tag!=IRT_UNIT)
+            os<<": "<<func->ret_ty->ToString();
+        os<<std::endl;
+    }
+    for(IRGlobal *global: module.globals)
+    {
+        os<<"global "<<global->name<<" = alloc "<<global->alloc_ty->ToString()<<", ";
+        if(global->zero_init)
+            os<<"zeroinit";
+        else
+        {
+            int pos=0;
+            PrintInit(global,global->alloc_ty,pos,os);
+        }
+        os<<std::endl;
+    }
+    os<<std::endl;
+
+    std::set<std::string> labels;
+    for(IRFunction *func: module.funcs)
+    {
+        if(func->IsDecl())
+            continue;
+        IRNamer namer(module_names,labels);
+        os<<"fun "<<func->name<<"(";
+        for(size_t i=0;i<func->params.size();++i)
+            os<<(i?", ":"")<<namer.Name(func->params[i],'@')<<": "<<func->param_tys[i]->ToString();
+        os<<")";
+        if(func->ret_ty->tag!=IRT_UNIT)
+            os<<": "<<func->ret_ty->ToString();
+        os<<" {"<<std::endl;
+        // 按逆后序输出, 保证值的定义出现在使用之前
+        std::vector<IRBlock *> order=func->ReversePostOrder();
+        std::set<IRBlock *> printed(order.begin(),order.end());
+        for(IRBlock *bb: func->blocks)
+            if(!printed.count(bb))
+                order.push_back(bb);
+        for(IRBlock *bb: order)
+        {
+            os<<namer.Name(bb);
+            if(!bb->params.empty())
+            {
+                os<<"(";
+                for(size_t i=0;i<bb->params.size();++i)
+                    os<<(i?", ":"")<<namer.Name(bb->params[i])<<": "<<bb->params[i]->ty->ToString();
+                os<<")";
+            }
+            os<<":"<<std::endl;
+            for(IRInst *inst: bb->insts)
+                PrintInst(inst,namer,os);
+            os<<std::endl;
+        }
+        os<<"}"<<std::endl<<std::endl;
+    }
+}
+
+// 常数折叠
+
+bool FoldBinary(koopa_raw_binary_op_t op,int lhs,int rhs,int &res)
+{
+    unsigned a=lhs,b=rhs;
+    switch (op)
+    {
+    case KOOPA_RBO_NOT_EQ:
+        res=(lhs!=rhs);
+        break;
+    case KOOPA_RBO_EQ:
+        res=(lhs==rhs);
+        break;
+    case KOOPA_RBO_GT:
+        res=(lhs>rhs);
+        break;
+    case KOOPA_RBO_LT:
+        res=(lhs<rhs);
+        break;
+    case KOOPA_RBO_GE:
+        res=(lhs>=rhs);
+        break;
+    case KOOPA_RBO_LE:
+        res=(lhs<=rhs);
+        break;
+    case KOOPA_RBO_ADD:
+        res=(int)(a+b);
+        break;
+    case KOOPA_RBO_SUB:
+        res=(int)(a-b);
+        break;
+    case KOOPA_RBO_MUL:
+        res=(int)(a*b);
+        break;
+    case KOOPA_RBO_DIV:
+        if(rhs==0)
+            return false;
+        // INT_MIN/-1 溢出, div 指令的结果为 INT_MIN
+        res=(rhs==-1)?(int)(0u-a):lhs/rhs;
+        break;
+    case KOOPA_RBO_MOD:
+        if(rhs==0)
+            return false;
+        res=(rhs==-1)?0:lhs%rhs;
+        break;
+    case KOOPA_RBO_AND:
+        res=lhs&rhs;
+        break;
+    case KOOPA_RBO_OR:
+        res=lhs|rhs;
+        break;
+    case KOOPA_RBO_XOR:
+        res=lhs^rhs;
+        break;
+    case KOOPA_RBO_SHL:
+        res=(int)(a<<(b&31));
+        break;
+    case KOOPA_RBO_SHR:
+        res=(int)(a>>(b&31));
+        break;
+    case KOOPA_RBO_SAR:
+        res=lhs>>(b&31);
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
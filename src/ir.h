@@ -0,0 +1,253 @@
+#pragma once
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "koopa.h"
+
+// 优化器使用的中间表示
+// 结构与 Koopa IR 一一对应 (SSA, 基本块参数), 但便于修改
+// 由 raw program 构造, 优化之后重新输出为 Koopa IR 文本, 交给 libkoopa 和后端
+
+enum IRTypeTag
+{
+    IRT_INT32,
+    IRT_UNIT,
+    IRT_ARRAY,
+    IRT_POINTER
+};
+
+// 类型是全局唯一的, 可以直接比较指针
+class IRType
+{
+public:
+    IRTypeTag tag;
+    IRType *base;
+    int len;
+
+    static IRType *Int32();
+    static IRType *Unit();
+    static IRType *Array(IRType *base,int len);
+    static IRType *Pointer(IRType *base);
+    // 占用的字节数
+    int Size() const;
+    std::string ToString() const;
+};
+
+enum IRValueKind
+{
+    IRV_CONST,
+    IRV_UNDEF,
+    IRV_GLOBAL,
+    IRV_FUNC_ARG,
+    IRV_BLOCK_ARG,
+    IRV_INST
+};
+
+enum IROp
+{
+    IR_ALLOC,
+    IR_LOAD,
+    IR_STORE,
+    IR_GEP,     // getelemptr
+    IR_GETPTR,  // getptr
+    IR_BINARY,
+    IR_CALL,
+    IR_BRANCH,
+    IR_JUMP,
+    IR_RET
+};
+
+class IRInst;
+class IRBlock;
+class IRFunction;
+class IRModule;
+
+class IRValue
+{
+public:
+    IRValueKind kind;
+    IRType *ty;
+    std::string name;           // 名字提示, 输出时会去重
+    std::vector<IRInst *> users; // 每个使用该值的操作数对应一项, 常量和 undef 不记录
+    int const_val=0;            // IRV_CONST
+    int arg_index=0;            // IRV_FUNC_ARG, IRV_BLOCK_ARG
+    IRBlock *block=nullptr;     // IRV_BLOCK_ARG 所在的基本块, IRV_INST 所在的基本块
+
+    IRValue(IRValueKind kind,IRType *ty):kind(kind),ty(ty){}
+    virtual ~IRValue(){}
+
+    bool IsConst() const { return kind==IRV_CONST; }
+    bool IsConst(int v) const { return kind==IRV_CONST && const_val==v; }
+    bool IsInst() const { return kind==IRV_INST; }
+    bool TracksUsers() const { return kind!=IRV_CONST && kind!=IRV_UNDEF; }
+    IRInst *AsInst();
+    // 把所有对该值的使用替换为 v
+    void ReplaceAllUsesWith(IRValue *v);
+    void RemoveUser(IRInst *user);
+};
+
+// 全局变量, 值为指向 alloc_ty 的指针
+class IRGlobal: public IRValue
+{
+public:
+    IRType *alloc_ty;
+    bool zero_init=true;
+    std::vector<int> init;      // 按行主序展开的初值, zero_init 时为空
+
+    IRGlobal(IRType *alloc_ty):IRValue(IRV_GLOBAL,IRType::Pointer(alloc_ty)),alloc_ty(alloc_ty){}
+    int InitAt(int i) const { return zero_init?0:init[i]; }
+};
+
+class IRInst: public IRValue
+{
+public:
+    IROp op;
+    koopa_raw_binary_op_t bop=KOOPA_RBO_ADD;    // IR_BINARY
+    IRType *alloc_ty=nullptr;                   // IR_ALLOC
+    IRFunction *callee=nullptr;                 // IR_CALL
+    std::vector<IRValue *> ops;
+    // 跳转目标, 以及每个目标的参数在 ops 中的起始位置
+    std::vector<IRBlock *> succs;
+    std::vector<int> succ_arg_begin;
+
+    IRInst(IROp op,IRType *ty):IRValue(IRV_INST,ty),op(op){}
+
+    bool IsTerminator() const { return op==IR_BRANCH || op==IR_JUMP || op==IR_RET; }
+    // 没有副作用, 结果不被使用时可以删除
+    bool IsPure() const { return op==IR_BINARY || op==IR_GEP || op==IR_GETPTR || op==IR_ALLOC; }
+    void SetOperand(int i,IRValue *v);
+    void AddOperand(IRValue *v);
+    void DropOperands();
+    // 第 s 个跳转目标的参数
+    int NumSuccArgs(int s) const;
+    IRValue *SuccArg(int s,int j) const { return ops[succ_arg_begin[s]+j]; }
+    void SetSuccArg(int s,int j,IRValue *v) { SetOperand(succ_arg_begin[s]+j,v); }
+    std::vector<IRValue *> SuccArgs(int s) const;
+    void SetSuccArgs(int s,const std::vector<IRValue *> &args);
+    // 从所在基本块中移除并断开操作数
+    void EraseFromParent();
+};
+
+class IRBlock
+{
+public:
+    std::string name;
+    IRFunction *parent=nullptr;
+    std::vector<IRValue *> params;
+    std::vector<IRInst *> insts;
+    std::vector<IRBlock *> preds;   // 每条入边一项, 由 IRFunction::ComputePreds 计算
+    bool unrolled=false;            // 部分展开生成的主循环或原循环的 header, 内联到调用者后也不再展开
+
+    IRInst *Terminator() const;
+    std::vector<IRBlock *> Succs() const;
+    void Append(IRInst *inst);
+    void Insert(int pos,IRInst *inst);
+    // 插入到终结指令之前
+    void InsertBeforeTerminator(IRInst *inst);
+    IRValue *AddParam(IRType *ty,const std::string &hint="");
+    void RemoveParam(int i);
+};
+
+// 函数的副作用摘要 (mod/ref), 由 ComputeModRef 按调用图自底向上计算
+// 只记录调用者可见的内存: 全局变量和通过指针参数访问的内存, 函数自己的 alloc 不算
+struct ModRefInfo
+{
+    bool known=false;       // 为 false 时其余字段无意义, 按任意副作用处理
+    bool io=false;          // 调用了输入输出或计时的库函数
+    bool reads_args=false;  // 读指针参数指向的内存
+    bool writes_args=false; // 写指针参数指向的内存
+    bool terminates=false;  // 没有循环和递归, 一定会返回
+    std::set<IRGlobal *> ref_globals;
+    std::set<IRGlobal *> mod_globals;
+    std::set<int> ref_params;   // 读了指向的内存的指针参数的编号, 非空时 reads_args 为真
+    std::set<int> mod_params;   // 写了指向的内存的指针参数的编号, 非空时 writes_args 为真
+
+    bool WritesMemory() const { return !known || io || writes_args || !mod_globals.empty(); }
+    // 结果只取决于实参, 不读写任何调用者可见的内存
+    bool IsPure() const { return !WritesMemory() && !reads_args && ref_globals.empty(); }
+    // 结果不被使用时可以删除
+    bool Removable() const { return !WritesMemory() && terminates; }
+};
+
+// 指针参数可能指向的对象 (各函数的 alloc 或全局变量), 由 ComputeParamTargets 汇总所有调用处的实参得到
+struct PointsTo
+{
+    bool known=false;       // 为 false 时可能指向任何调用者可见的内存
+    std::set<IRValue *> objects;
+};
+
+class IRFunction
+{
+public:
+    std::string name;   // 包含 '@'
+    IRType *ret_ty;
+    std::vector<IRType *> param_tys;
+    std::vector<IRValue *> params;
+    std::vector<IRBlock *> blocks;  // blocks[0] 为入口
+    IRModule *module=nullptr;
+    ModRefInfo modref;
+    std::vector<PointsTo> param_targets;    // 与 params 一一对应, 为空时全部未知
+
+    bool IsDecl() const { return blocks.empty(); }
+    IRBlock *Entry() const { return blocks[0]; }
+    void ComputePreds();
+    // 删除从入口不可达的基本块, 返回是否有改动
+    bool RemoveUnreachable();
+    // 按逆后序排列基本块
+    std::vector<IRBlock *> ReversePostOrder() const;
+    // 保证入口基本块没有前驱 (Koopa IR 的要求)
+    void EnsureEntryNoPreds();
+    int InstCount() const;
+    // 是否有回边, 即跳到逆后序中不在自己之后的基本块
+    bool HasLoop() const;
+};
+
+class IRModule
+{
+public:
+    std::vector<IRGlobal *> globals;
+    std::vector<IRFunction *> funcs;
+
+    IRValue *GetConst(int v);
+    IRValue *GetUndef(IRType *ty);
+    IRFunction *FindFunction(const std::string &name) const;
+
+    IRGlobal *NewGlobal(IRType *alloc_ty,const std::string &name);
+    IRFunction *NewFunction(const std::string &name,IRType *ret_ty,const std::vector<IRType *> &param_tys);
+    IRBlock *NewBlock(IRFunction *func,const std::string &name);
+    IRValue *NewValue(IRValueKind kind,IRType *ty);
+    IRInst *NewInst(IROp op,IRType *ty);
+
+    IRInst *NewAlloc(IRType *alloc_ty);
+    IRInst *NewLoad(IRValue *src);
+    IRInst *NewStore(IRValue *value,IRValue *dest);
+    IRInst *NewGep(IRValue *src,IRValue *index);
+    IRInst *NewGetPtr(IRValue *src,IRValue *index);
+    IRInst *NewBinary(koopa_raw_binary_op_t bop,IRValue *lhs,IRValue *rhs);
+    IRInst *NewCall(IRFunction *callee,const std::vector<IRValue *> &args);
+    IRInst *NewJump(IRBlock *target,const std::vector<IRValue *> &args={});
+    IRInst *NewBranch(IRValue *cond,IRBlock *t,const std::vector<IRValue *> &targs,
+                      IRBlock *f,const std::vector<IRValue *> &fargs);
+    IRInst *NewRet(IRValue *v);
+    // 复制指令, 操作数和跳转目标按映射表替换 (表中没有的保持不变)
+    IRInst *CloneInst(const IRInst *inst,const std::map<IRValue *,IRValue *> &vmap,
+                      const std::map<IRBlock *,IRBlock *> &bmap);
+
+private:
+    std::map<int,IRValue *> consts;
+    std::map<IRType *,IRValue *> undefs;
+    std::vector<std::unique_ptr<IRValue>> value_pool;
+    std::vector<std::unique_ptr<IRBlock>> block_pool;
+    std::vector<std::unique_ptr<IRFunction>> func_pool;
+};
+
+// 由 raw program 构造优化器 IR
+void BuildIR(const koopa_raw_program_t &raw,IRModule &module);
+// 输出为 Koopa IR 文本
+void PrintIR(const IRModule &module,std::ostream &os);
+// 计算常数运算 lhs op rhs, 结果按 32 位回绕, 与 RISC-V 指令一致; 除数为 0 时不折叠, 返回 false
+bool FoldBinary(koopa_raw_binary_op_t op,int lhs,int rhs,int &res);
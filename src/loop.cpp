@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cassert>
+#include "loop.h"
+
+void Loop::AddBlock(IRBlock *bb)
+{
+    for(Loop *loop=this;loop!=nullptr;loop=loop->parent)
+    {
+        loop->blocks.push_back(bb);
+        loop->block_set.insert(bb);
+    }
+}
+std::vector<IRBlock *> Loop::ExitBlocks() const
+{
+    std::vector<IRBlock *> exits;
+    for(IRBlock *bb: blocks)
+        for(IRBlock *succ: bb->Succs())
+            if(!Contains(succ) && std::find(exits.begin(),exits.end(),succ)==exits.end())
+                exits.push_back(succ);
+    return exits;
+}
+
+LoopInfo::LoopInfo(IRFunction *func,const DomTree &dom)
+{
+    // 外层循环的 header 在逆后序中排在内层循环之前, 按逆后序处理时后建立的循环覆盖 innermost
+    for(IRBlock *header: dom.RPO())
+    {
+        std::vector<IRBlock *> latches;
+        for(IRBlock *pred: header->preds)
+            if(dom.Dominates(header,pred) && std::find(latches.begin(),latches.end(),pred)==latches.end())
+                latches.push_back(pred);
+        if(latches.empty())
+            continue;
+        pool.emplace_back(new Loop);
+        Loop *loop=pool.back().get();
+        loop->header=header;
+        loop->latches=latches;
+        loop->block_set.insert(header);
+        // 从回边的起点沿前驱反向搜索到 header
+        std::vector<IRBlock *> worklist;
+        for(IRBlock *latch: latches)
+            if(loop->block_set.insert(latch).second)
+                worklist.push_back(latch);
+        while(!worklist.empty())
+        {
+            IRBlock *bb=worklist.back();
+            worklist.pop_back();
+            for(IRBlock *pred: bb->preds)
+                if(dom.Reachable(pred) && loop->block_set.insert(pred).second)
+                    worklist.push_back(pred);
+        }
+        for(IRBlock *bb: dom.RPO())
+            if(loop->block_set.count(bb))
+                loop->blocks.push_back(bb);
+
+        auto it=innermost.find(header);
+        if(it!=innermost.end())
+        {
+            loop->parent=it->second;
+            loop->depth=loop->parent->depth+1;
+            loop->parent->children.push_back(loop);
+        }
+        else
+            top.push_back(loop);
+        for(IRBlock *bb: loop->blocks)
+            innermost[bb]=loop;
+    }
+}
+std::vector<Loop *> LoopInfo::PostOrder() const
+{
+    std::vector<Loop *> order;
+    std::vector<std::pair<Loop *,size_t>> stack;
+    for(Loop *loop: top)
+    {
+        stack.push_back({loop,0});
+        while(!stack.empty())
+        {
+            Loop *cur=stack.back().first;
+            if(stack.back().second<cur->children.size())
+            {
+                Loop *child=cur->children[stack.back().second++];
+                stack.push_back({child,0});
+            }
+            else
+            {
+                order.push_back(cur);
+                stack.pop_back();
+            }
+        }
+    }
+    return order;
+}
+Loop *LoopInfo::LoopOf(IRBlock *bb) const
+{
+    auto it=innermost.find(bb);
+    return it==innermost.end()?nullptr:it->second;
+}
+
+// 新建一个与 target 参数相同的基本块, 放在 target 之前, 原样跳到 target
+static IRBlock *NewForwarder(IRFunction *func,IRBlock *target,const std::string &suffix)
+{
+    IRModule *module=func->module;
+    IRBlock *bb=module->NewBlock(func,target->name+suffix);
+    func->blocks.pop_back();
+    func->blocks.insert(std::find(func->blocks.begin(),func->blocks.end(),target),bb);
+    std::vector<IRValue *> args;
+    for(IRValue *param: target->params)
+        args.push_back(bb->AddParam(param->ty,param->name));
+    bb->Append(module->NewJump(target,args));
+    return bb;
+}
+// 把 from 中跳到 target 的边改为跳到 to, 实参不变
+static void Redirect(IRBlock *from,IRBlock *target,IRBlock *to)
+{
+    IRInst *term=from->Terminator();
+    for(IRBlock *&succ: term->succs)
+        if(succ==target)
+            succ=to;
+}
+
+IRBlock *EnsurePreheader(IRFunction *func,Loop *loop)
+{
+    IRBlock *header=loop->header;
+    std::vector<IRBlock *> outside;
+    for(IRBlock *pred: header->preds)
+        if(!loop->Contains(pred) && std::find(outside.begin(),outside.end(),pred)==outside.end())
+            outside.push_back(pred);
+    assert(!outside.empty());
+    if(outside.size()==1 && outside[0]->Terminator()->op==IR_JUMP)
+        return outside[0];
+    IRBlock *pre=NewForwarder(func,header,"_preheader");
+    for(IRBlock *pred: outside)
+        Redirect(pred,header,pre);
+    if(loop->parent!=nullptr)
+        loop->parent->AddBlock(pre);
+    func->ComputePreds();
+    return pre;
+}
+
+bool EnsureDedicatedExits(IRFunction *func,Loop *loop)
+{
+    bool changed=false;
+    for(IRBlock *exit: loop->ExitBlocks())
+    {
+        bool dedicated=true;
+        for(IRBlock *pred: exit->preds)
+            dedicated=dedicated && loop->Contains(pred);
+        if(dedicated)
+            continue;
+        IRBlock *split=NewForwarder(func,exit,"_exit");
+        for(IRBlock *pred: std::set<IRBlock *>(exit->preds.begin(),exit->preds.end()))
+            if(loop->Contains(pred))
+                Redirect(pred,exit,split);
+        // 新的基本块属于同时包含出口块的外层循环
+        Loop *outer=loop->parent;
+        while(outer!=nullptr && !outer->Contains(exit))
+            outer=outer->parent;
+        if(outer!=nullptr)
+            outer->AddBlock(split);
+        func->ComputePreds();
+        changed=true;
+    }
+    return changed;
+}
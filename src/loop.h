@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <set>
+#include <vector>
+#include "dom.h"
+
+// 自然循环: 由回边 (跳到支配自己的基本块的边) 确定, 同一个 header 的所有回边属于同一个循环
+struct Loop
+{
+    IRBlock *header;
+    Loop *parent=nullptr;
+    std::vector<Loop *> children;
+    std::vector<IRBlock *> blocks;  // 按逆后序, blocks[0] 为 header
+    std::set<IRBlock *> block_set;
+    std::vector<IRBlock *> latches;
+    int depth=1;
+
+    bool Contains(IRBlock *bb) const { return block_set.count(bb)!=0; }
+    // 把新建的基本块加入该循环和所有外层循环
+    void AddBlock(IRBlock *bb);
+    // 循环外被循环内的基本块跳到的基本块
+    std::vector<IRBlock *> ExitBlocks() const;
+};
+
+// 循环嵌套树, 不可归约的控制流不识别为循环
+class LoopInfo
+{
+public:
+    LoopInfo(IRFunction *func,const DomTree &dom);
+
+    const std::vector<Loop *> &TopLevel() const { return top; }
+    // 所有循环, 内层循环排在外层循环之前
+    std::vector<Loop *> PostOrder() const;
+    // 包含 bb 的最内层循环, 不在循环中时返回 nullptr
+    Loop *LoopOf(IRBlock *bb) const;
+
+private:
+    std::vector<std::unique_ptr<Loop>> pool;
+    std::vector<Loop *> top;
+    std::map<IRBlock *,Loop *> innermost;
+};
+
+// 保证循环有前置块: 唯一的循环外前驱, 并且只跳到 header; 返回前置块
+IRBlock *EnsurePreheader(IRFunction *func,Loop *loop);
+// 保证每个出口块的前驱都在循环内, 返回是否有改动
+bool EnsureDedicatedExits(IRFunction *func,Loop *loop);
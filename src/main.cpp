@@ -8,6 +8,7 @@
 #include "koopa.h"
 #include "ast.h"
 #include "riscv.h"
+#include "opt.h"
 
 
 
@@ -24,11 +25,25 @@ extern int yyparse(std::unique_ptr<BaseAST> &ast);
 int main(int argc, const char *argv[])
 {
   // 解析命令行参数. 测试脚本/评测平台要求你的编译器能接收如下参数:
-  // compiler 模式 输入文件 -o 输出文件
-  assert(argc == 5);
+  // compiler 模式 输入文件 -o 输出文件 [优化选项...]
+  assert(argc >= 5);
   auto mode = argv[1];
   auto input = argv[2];
   auto output = argv[4];
+  OptOptions opts;
+  for (int i = 5; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "-O0") == 0)
+      opts.enable = false;
+    else if (strcmp(argv[i], "-O1") == 0 || strcmp(argv[i], "-O2") == 0)
+      opts.enable = true;
+    else if (strcmp(argv[i], "-fopt-report") == 0)
+      opts.report = true;
+    else if (strcmp(argv[i], "-fdump-modref") == 0)
+      opts.dump_modref = true;
+    else if (strcmp(argv[i], "-fauto-memoize") == 0)
+      opts.auto_memoize = true;
+  }
 
   // 打开输入文件, 并且指定 lexer 在解析的时候读取这个文件
   yyin = fopen(input, "r");
@@ -45,7 +60,14 @@ int main(int argc, const char *argv[])
   std::streambuf *oldcout = std::cout.rdbuf(fout.rdbuf());
   if (strcmp(mode, "-koopa")==0)
   {
+    std::stringstream ss;
+    std::cout.rdbuf(ss.rdbuf());
     ast->GenerateIR();
+    std::cout.rdbuf(fout.rdbuf());
+    if (opts.enable)
+      std::cout << OptimizeKoopa(ss.str(), opts);
+    else
+      std::cout << ss.str();
   }
   else if(strcmp(mode,"-riscv")==0 or strcmp(mode,"-perf")==0)
   {
@@ -53,9 +75,11 @@ int main(int argc, const char *argv[])
     std::cout.rdbuf(ss.rdbuf());
     ast->GenerateIR();
     std::cout.rdbuf(fout.rdbuf());
+    opts.for_riscv = true;
+    std::string ir = opts.enable ? OptimizeKoopa(ss.str(), opts) : ss.str();
     // 解析字符串 str, 得到 Koopa IR 程序
     koopa_program_t program;
-    koopa_error_code_t ret = koopa_parse_from_string(ss.str().c_str(), &program);
+    koopa_error_code_t ret = koopa_parse_from_string(ir.c_str(), &program);
     assert(ret == KOOPA_EC_SUCCESS); // 确保解析时没有出错
     // 创建一个 raw program builder, 用来构建 raw program
     koopa_raw_program_builder_t builder = koopa_new_raw_program_builder();
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include "alias.h"
+#include "modref.h"
+
+// 函数副作用 (mod/ref) 分析
+// load/store 按地址可能指向的对象 (见 AliasInfo::Objects) 分类: 全局变量记入 ref/mod 集合, 本函数的 alloc 忽略,
+// 指针参数记下参数的编号, 从内存中取出的指针指向未知的对象, 整个摘要成为未知
+// call 合并被调用函数的摘要, 被调用者读写的指针参数按对应实参指向的对象同样分类
+// 同一个强连通分量中的函数互相依赖, 从空摘要开始反复计算直到不再变化; 集合只增不减, 一定收敛
+
+// 库函数的副作用, 见 sylib.h
+struct LibraryEffect
+{
+    const char *name;
+    int ref_param;  // 读的指针参数, 没有时为 -1
+    int mod_param;  // 写的指针参数, 没有时为 -1
+};
+static const LibraryEffect kLibraryEffects[]={
+    {"@getint",-1,-1},
+    {"@getch",-1,-1},
+    {"@getarray",-1,0},
+    {"@putint",-1,-1},
+    {"@putch",-1,-1},
+    {"@putarray",1,-1},
+    {"@starttime",-1,-1},
+    {"@stoptime",-1,-1},
+};
+
+void SetLibraryModRef(IRModule &module)
+{
+    for(IRFunction *func: module.funcs)
+    {
+        if(!func->IsDecl())
+            continue;
+        for(const LibraryEffect &lib: kLibraryEffects)
+        {
+            if(func->name!=lib.name)
+                continue;
+            ModRefInfo &info=func->modref;
+            info.known=true;
+            info.io=true;
+            if(lib.ref_param>=0)
+                info.ref_params.insert(lib.ref_param);
+            if(lib.mod_param>=0)
+                info.mod_params.insert(lib.mod_param);
+            info.reads_args=!info.ref_params.empty();
+            info.writes_args=!info.mod_params.empty();
+            info.terminates=true;
+        }
+    }
+}
+
+static bool SameModRef(const ModRefInfo &a,const ModRefInfo &b)
+{
+    return a.known==b.known && a.io==b.io && a.reads_args==b.reads_args && a.writes_args==b.writes_args &&
+           a.terminates==b.terminates && a.ref_globals==b.ref_globals && a.mod_globals==b.mod_globals &&
+           a.ref_params==b.ref_params && a.mod_params==b.mod_params;
+}
+
+// 记录对 ptr 指向的内存的一次读或写, 指向未知的对象时返回 false
+static bool AddAccess(ModRefInfo &info,const AliasInfo &alias,IRValue *ptr,bool write)
+{
+    for(IRValue *obj: alias.Objects(ptr))
+    {
+        if(obj->kind==IRV_INST && obj->AsInst()->op==IR_ALLOC)
+            continue;
+        if(obj->kind==IRV_GLOBAL)
+        {
+            IRGlobal *global=static_cast<IRGlobal *>(obj);
+            (write?info.mod_globals:info.ref_globals).insert(global);
+            continue;
+        }
+        if(obj->kind!=IRV_FUNC_ARG)
+            return false;
+        (write?info.mod_params:info.ref_params).insert(obj->arg_index);
+        (write?info.writes_args:info.reads_args)=true;
+    }
+    return true;
+}
+
+static ModRefInfo Summarize(IRFunction *func,const std::vector<IRFunction *> &scc)
+{
+    AliasInfo alias(func);
+    ModRefInfo info;
+    info.known=true;
+    info.terminates=!func->HasLoop();
+    for(IRBlock *bb: func->blocks)
+    {
+        for(IRInst *inst: bb->insts)
+        {
+            bool ok=true;
+            if(inst->op==IR_LOAD)
+                ok=AddAccess(info,alias,inst->ops[0],false);
+            else if(inst->op==IR_STORE)
+                ok=AddAccess(info,alias,inst->ops[1],true);
+            if(!ok)
+                return ModRefInfo();
+            if(inst->op!=IR_CALL)
+                continue;
+            const ModRefInfo &callee=inst->callee->modref;
+            if(!callee.known)
+                return ModRefInfo();
+            if(std::find(scc.begin(),scc.end(),inst->callee)!=scc.end())
+                info.terminates=false;
+            info.terminates=info.terminates && callee.terminates;
+            info.io=info.io || callee.io;
+            info.ref_globals.insert(callee.ref_globals.begin(),callee.ref_globals.end());
+            info.mod_globals.insert(callee.mod_globals.begin(),callee.mod_globals.end());
+            for(int i: callee.ref_params)
+                ok=ok && AddAccess(info,alias,inst->ops[i],false);
+            for(int i: callee.mod_params)
+                ok=ok && AddAccess(info,alias,inst->ops[i],true);
+            if(!ok)
+                return ModRefInfo();
+        }
+    }
+    return info;
+}
+
+void ComputeModRef(const std::vector<IRFunction *> &scc)
+{
+    for(IRFunction *func: scc)
+    {
+        func->modref=ModRefInfo();
+        func->modref.known=true;
+    }
+    bool changed=true;
+    while(changed)
+    {
+        changed=false;
+        for(IRFunction *func: scc)
+        {
+            ModRefInfo info=Summarize(func,scc);
+            if(SameModRef(info,func->modref))
+                continue;
+            func->modref=info;
+            changed=true;
+        }
+    }
+}
+
+static const char *ModRefKind(const ModRefInfo &info)
+{
+    if(!info.known)
+        return "unknown";
+    if(info.io)
+        return "io";
+    if(info.writes_args)
+        return "writes-args";
+    if(!info.mod_globals.empty())
+        return "writes-globals";
+    if(info.reads_args || !info.ref_globals.empty())
+        return "read-only";
+    return "pure";
+}
+
+static void DumpParams(std::ostream &os,const char *tag,const IRFunction *func,const std::set<int> &params)
+{
+    if(params.empty())
+        return;
+    os<<", "<<tag;
+    for(int i: params)
+        os<<" "<<func->params[i]->name;
+}
+// 按名字排序输出, 结果不依赖指针的大小
+static void DumpGlobals(std::ostream &os,const char *tag,const std::set<IRGlobal *> &globals)
+{
+    if(globals.empty())
+        return;
+    std::vector<std::string> names;
+    for(IRGlobal *global: globals)
+        names.push_back(global->name);
+    std::sort(names.begin(),names.end());
+    os<<", "<<tag;
+    for(const std::string &name: names)
+        os<<" "<<name;
+}
+
+void DumpModRef(const IRModule &module,std::ostream &os)
+{
+    for(IRFunction *func: module.funcs)
+    {
+        if(func->IsDecl())
+            continue;
+        const ModRefInfo &info=func->modref;
+        os<<func->name<<": "<<ModRefKind(info);
+        if(info.known)
+        {
+            DumpParams(os,"reads args",func,info.ref_params);
+            DumpParams(os,"writes args",func,info.mod_params);
+            DumpGlobals(os,"ref",info.ref_globals);
+            DumpGlobals(os,"mod",info.mod_globals);
+            if(!info.terminates)
+                os<<", may not return";
+        }
+        os<<std::endl;
+    }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include "ir.h"
+
+// 函数副作用分析, 结果存放在 IRFunction::modref
+
+// 按名字设置库函数 (声明) 的摘要, 不认识的声明保持未知
+void SetLibraryModRef(IRModule &module);
+// 计算调用图中一个强连通分量内各函数的摘要, 分量外被调用的函数需要已经计算过
+void ComputeModRef(const std::vector<IRFunction *> &scc);
+// 输出每个函数的摘要, 供 -fdump-modref 检查
+void DumpModRef(const IRModule &module,std::ostream &os);
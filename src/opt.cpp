@@ -0,0 +1,112 @@
+#include <cassert>
+#include <sstream>
+#include "alias.h"
+#include "koopa.h"
+#include "modref.h"
+#include "opt.h"
+
+std::string OptimizeKoopa(const std::string &ir,const OptOptions &opts)
+{
+    koopa_program_t program;
+    koopa_error_code_t ret=koopa_parse_from_string(ir.c_str(),&program);
+    assert(ret==KOOPA_EC_SUCCESS);
+    koopa_raw_program_builder_t builder=koopa_new_raw_program_builder();
+    koopa_raw_program_t raw=koopa_build_raw_program(builder,program);
+    koopa_delete_program(program);
+
+    IRModule module;
+    BuildIR(raw,module);
+    koopa_delete_raw_program_builder(builder);
+
+    RunOptimizer(module,opts);
+
+    std::stringstream ss;
+    PrintIR(module,ss);
+    return ss.str();
+}
+
+static void OptimizeFunction(IRFunction *func,const CallGraph &cg,const OptOptions &opts,ConstCallCache &cache)
+{
+    // 实参本来就是常数的调用先求值, 不必内联; 常量传播后实参成为常数的调用再求值一次
+    EvaluateConstCalls(func,cache);
+    InlineCalls(func,cg,opts);
+    SparseCondConstProp(func);
+    if(EvaluateConstCalls(func,cache))
+        SparseCondConstProp(func);
+    GlobalValueNumbering(func);
+    EliminateRedundantLoads(func);
+    // 外提到同一个前置块的运算可能重复, 再做一次值编号; 写回出口的值可以转发给循环之后的 load
+    if(HoistLoopInvariants(func))
+    {
+        GlobalValueNumbering(func);
+        EliminateRedundantLoads(func);
+    }
+    // load 转发之后很多 store 不再被读; 在归纳变量强度削弱之前做, 这时地址仍是下标的形式
+    EliminateDeadStores(func);
+    ReduceInductionVariables(func);
+    // 展开后的计数器和地址多为常数, 再做一次常量传播和值编号
+    if(UnrollLoops(func,opts))
+    {
+        SparseCondConstProp(func);
+        GlobalValueNumbering(func);
+    }
+    // 内联和展开后下标成为常数的小数组也可以拆开
+    if(ScalarReplaceArrays(func) && PromoteMemoryToRegister(func))
+        SparseCondConstProp(func);
+    AggressiveDCE(func);
+    SimplifyCFG(func);
+    // 后端自己在寄存器中展开常数除法, 这里只做不增加指令数的替换
+    StrengthReduce(func,opts.for_riscv?1:5);
+    func->RemoveUnreachable();
+}
+
+void RunOptimizer(IRModule &module,const OptOptions &opts)
+{
+    if(!opts.enable)
+        return;
+    // 尾递归消除依赖前端把参数存入 alloc 的形式, 需要在 mem2reg 之前;
+    // 过程间常量传播比较的是 SSA 形式的实参, 所以这两步先对所有函数做完
+    for(IRFunction *func: module.funcs)
+    {
+        if(func->IsDecl())
+            continue;
+        EliminateTailRecursion(func);
+        ScalarReplaceArrays(func);
+        PromoteMemoryToRegister(func);
+    }
+    // 调用处全部改为调用特化版本的函数不再需要优化
+    if(SpecializeFunctions(module))
+        RemoveUnusedFunctions(module);
+    // 指针参数可能指向的对象, 之后的变换只会缩小实际的范围, 不必重新计算
+    ComputeParamTargets(module);
+    // 按调用图自底向上优化, 内联时被调用的函数已经优化过, 副作用摘要也已经算好
+    CallGraph cg(module);
+    ConstCallCache cache;
+    SetLibraryModRef(module);
+    for(const std::vector<IRFunction *> &scc: cg.BottomUpSCCs())
+    {
+        // 优化前的摘要供分量内的递归调用使用, 优化后重新计算得到更精确的结果
+        ComputeModRef(scc);
+        for(IRFunction *func: scc)
+            OptimizeFunction(func,cg,opts,cache);
+        ComputeModRef(scc);
+    }
+    // 删除形参和返回值后, 被调用函数中计算它们的代码成为死代码
+    if(RemoveDeadArgs(module))
+    {
+        for(IRFunction *func: module.funcs)
+        {
+            if(func->IsDecl())
+                continue;
+            AggressiveDCE(func);
+            SimplifyCFG(func);
+        }
+    }
+    // 记忆化后的函数写缓存表, 不再是纯函数, 所以放在所有函数优化完之后, 并重新计算摘要
+    if(opts.auto_memoize && MemoizeRecursion(module))
+        for(const std::vector<IRFunction *> &scc: cg.BottomUpSCCs())
+            ComputeModRef(scc);
+    RemoveUnusedFunctions(module);
+    if(opts.dump_modref)
+        DumpModRef(module,std::cerr);
+}
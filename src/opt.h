@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include "callgraph.h"
+#include "ir.h"
+
+// 优化选项, 由命令行参数设置
+struct OptOptions
+{
+    bool enable=true;       // -O0 关闭所有优化
+    bool for_riscv=false;   // 优化结果交给 RISCV 后端, 而不是直接输出 Koopa IR
+    bool report=false;      // -fopt-report 在标准错误输出展开了哪些循环
+    bool dump_modref=false; // -fdump-modref 在标准错误输出各函数的副作用摘要
+    bool auto_memoize=false;// -fauto-memoize 给纯的自递归函数加上缓存表
+};
+
+// 编译时求值过的调用: 被调用函数和实参 -> 结果, 无法求值时为空
+typedef std::map<std::pair<IRFunction *,std::vector<int>>,std::optional<int>> ConstCallCache;
+
+// 解析 Koopa IR 文本, 优化后重新输出为 Koopa IR 文本
+std::string OptimizeKoopa(const std::string &ir,const OptOptions &opts);
+void RunOptimizer(IRModule &module,const OptOptions &opts);
+
+// 删除 bb 的第 i 个参数以及所有入边上对应的实参, 需要前驱是最新的
+void RemoveBlockParam(IRBlock *bb,int i);
+
+// 各个优化遍, 返回是否有改动
+
+// 常数乘除法/取模的强度削弱, 展开后的指令数不超过 max_insts 时才替换
+bool StrengthReduce(IRFunction *func,int max_insts);
+// 函数内联, 调用图中 func 调用的函数需要已经处理过; 递归函数不内联
+bool InlineCalls(IRFunction *func,const CallGraph &cg,const OptOptions &opts);
+// 自动记忆化, 给实参范围小的纯自递归函数加上全局的缓存表; 需要副作用摘要
+bool MemoizeRecursion(IRModule &module);
+// 过程间常量传播: 所有调用处传入同一个常量的形参直接替换, 否则按常量实参复制出特化的函数; 需要 SSA 形式
+bool SpecializeFunctions(IRModule &module);
+// 删除无用的形参 (包括只原样传给自己的) 和所有调用处都不使用的返回值, 同时修改调用处
+bool RemoveDeadArgs(IRModule &module);
+// 删除没有被调用的函数 (main 除外)
+bool RemoveUnusedFunctions(IRModule &module);
+// 实参都是常数的纯函数调用在编译时执行, 替换为结果; cache 在整个模块中共用
+bool EvaluateConstCalls(IRFunction *func,ConstCallCache &cache);
+// 尾递归消除, 把对自身的尾调用改为跳回入口的循环
+bool EliminateTailRecursion(IRFunction *func);
+// SSA 构造, 把地址没有泄露的 i32 和指针局部变量提升为基本块参数
+bool PromoteMemoryToRegister(IRFunction *func);
+// 标量替换, 把地址没有泄露并且只用常数下标访问的小局部数组拆成每个元素一个 alloc, 需要之后再做 mem2reg
+bool ScalarReplaceArrays(IRFunction *func);
+// 删除所有入边都传入同一个值的参数, 以及结果没有被使用的参数
+bool SimplifyBlockParams(IRFunction *func);
+// 稀疏条件常量传播, 删除不可达的基本块, 条件为常数的 br 改为 jump
+bool SparseCondConstProp(IRFunction *func);
+// 基于支配树的全局值编号, 删除重复的纯运算和地址计算, 以及中间没有可能别名的写入的重复 load
+bool GlobalValueNumbering(IRFunction *func);
+// 冗余 load 消除和 store 到 load 的转发, 跨越汇合点时用基本块参数合并各条路径上的值
+bool EliminateRedundantLoads(IRFunction *func);
+// 死 store 删除: 被覆盖前没有读的 store, 返回前不再读的局部变量, 以及之后被循环整个覆盖的局部数组的初始化
+bool EliminateDeadStores(IRFunction *func);
+// 循环不变量外提, 并把循环内只通过不变地址读写的变量替换为寄存器, 在出口写回
+bool HoistLoopInvariants(IRFunction *func);
+// 归纳变量强度削弱, 把循环中对计数器的乘法和下标地址计算改为每次迭代递增, 并做线性函数测试替换
+bool ReduceInductionVariables(IRFunction *func);
+// 循环展开: 迭代次数为较小常数时完全展开, 否则按代价选择展开次数, 剩余的迭代交给原循环
+bool UnrollLoops(IRFunction *func,const OptOptions &opts);
+// 基于控制依赖的激进死代码删除, 删除结果无用的指令和参数, 以及不影响结果的分支
+bool AggressiveDCE(IRFunction *func);
+// 控制流图化简: 合并直线相连的基本块, 删除只有一条 jump 的基本块, 两个目标相同的 br 改为 jump
+bool SimplifyCFG(IRFunction *func);
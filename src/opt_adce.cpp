@@ -0,0 +1,320 @@
+#include <cassert>
+#include <climits>
+#include <set>
+#include "dom.h"
+#include "loop.h"
+#include "opt.h"
+
+// 激进死代码删除 (Cytron 等): 先假定所有指令都无用, 从有副作用的指令出发标记有用的值
+// 被调用函数的摘要表明不写内存, 不做输入输出并且一定返回时, call 不算有副作用
+// 有用的指令所在基本块控制依赖的分支也有用; 基本块参数有用时, 各入边的实参和传入它的跳转也有用
+// 最后删除无用的指令和参数, 无用的分支改为跳到直接后支配者
+// 不能证明一定会结束的循环, 离开循环的分支也有用, 否则可能把不结束的循环删掉
+
+// 把 v 分解为 base 加常数 offset, 跟随加减常数的运算
+static IRValue *SplitOffset(IRValue *v,long long &offset)
+{
+    offset=0;
+    while(v->IsInst() && v->AsInst()->op==IR_BINARY)
+    {
+        IRInst *inst=v->AsInst();
+        if(inst->bop==KOOPA_RBO_ADD && inst->ops[0]->IsConst())
+        {
+            offset+=inst->ops[0]->const_val;
+            v=inst->ops[1];
+        }
+        else if(inst->bop==KOOPA_RBO_ADD && inst->ops[1]->IsConst())
+        {
+            offset+=inst->ops[1]->const_val;
+            v=inst->ops[0];
+        }
+        else if(inst->bop==KOOPA_RBO_SUB && inst->ops[1]->IsConst())
+        {
+            offset-=inst->ops[1]->const_val;
+            v=inst->ops[0];
+        }
+        else
+            break;
+    }
+    return v;
+}
+
+// 支配 header 的分支保证 x >= lower 时返回 true
+static bool GuardedLower(IRValue *x,IRBlock *header,const DomTree &dom,long long &lower)
+{
+    for(IRBlock *bb=dom.IDom(header);bb!=nullptr;bb=dom.IDom(bb))
+    {
+        IRInst *br=bb->Terminator();
+        if(br->op!=IR_BRANCH || br->succs[0]==br->succs[1] || !dom.Dominates(br->succs[0],header) ||
+           !br->ops[0]->IsInst())
+            continue;
+        IRInst *cmp=br->ops[0]->AsInst();
+        if(cmp->op!=IR_BINARY || cmp->ops[0]!=x || !cmp->ops[1]->IsConst())
+            continue;
+        if(cmp->bop==KOOPA_RBO_GE || cmp->bop==KOOPA_RBO_GT)
+        {
+            lower=(long long)cmp->ops[1]->const_val+(cmp->bop==KOOPA_RBO_GT);
+            return true;
+        }
+    }
+    return false;
+}
+
+// 循环一定会结束: 每次迭代都执行的出口分支比较 iv 加常数的值和循环不变量 bound, iv 是 header 参数,
+// 在每条回边上加同一个常数, 并且比较的值在条件不成立之前不会溢出
+static bool IsFinite(Loop *loop,const DomTree &dom)
+{
+    auto is_iv=[loop](IRValue *v) {
+        long long offset;
+        v=SplitOffset(v,offset);
+        return v->kind==IRV_BLOCK_ARG && v->block==loop->header;
+    };
+    for(IRBlock *bb: loop->blocks)
+    {
+        IRInst *br=bb->Terminator();
+        if(br->op!=IR_BRANCH || !br->ops[0]->IsInst() || br->ops[0]->AsInst()->op!=IR_BINARY)
+            continue;
+        int exit=!loop->Contains(br->succs[0])?0:!loop->Contains(br->succs[1])?1:-1;
+        bool every_iteration=true;
+        for(IRBlock *latch: loop->latches)
+            every_iteration=every_iteration && dom.Dominates(bb,latch);
+        if(exit<0 || !every_iteration)
+            continue;
+        // 化为 v op bound 成立时继续循环
+        IRInst *cmp=br->ops[0]->AsInst();
+        koopa_raw_binary_op_t op=cmp->bop;
+        IRValue *v=cmp->ops[0],*bound=cmp->ops[1];
+        if(exit==0)
+        {
+            static const std::map<koopa_raw_binary_op_t,koopa_raw_binary_op_t> negate={
+                {KOOPA_RBO_LT,KOOPA_RBO_GE},{KOOPA_RBO_GE,KOOPA_RBO_LT},{KOOPA_RBO_GT,KOOPA_RBO_LE},
+                {KOOPA_RBO_LE,KOOPA_RBO_GT},{KOOPA_RBO_EQ,KOOPA_RBO_NOT_EQ},{KOOPA_RBO_NOT_EQ,KOOPA_RBO_EQ}};
+            if(!negate.count(op))
+                continue;
+            op=negate.at(op);
+        }
+        if(!is_iv(v))
+        {
+            static const std::map<koopa_raw_binary_op_t,koopa_raw_binary_op_t> swapped={
+                {KOOPA_RBO_LT,KOOPA_RBO_GT},{KOOPA_RBO_GT,KOOPA_RBO_LT},{KOOPA_RBO_LE,KOOPA_RBO_GE},
+                {KOOPA_RBO_GE,KOOPA_RBO_LE},{KOOPA_RBO_EQ,KOOPA_RBO_EQ},{KOOPA_RBO_NOT_EQ,KOOPA_RBO_NOT_EQ}};
+            if(!swapped.count(op))
+                continue;
+            std::swap(v,bound);
+            op=swapped.at(op);
+        }
+        if(!is_iv(v) || ((bound->kind==IRV_INST || bound->kind==IRV_BLOCK_ARG) && loop->Contains(bound->block)))
+            continue;
+        long long offset;
+        IRValue *iv=SplitOffset(v,offset);
+
+        // 每条回边上 iv 的增量
+        long long step=0;
+        for(IRBlock *latch: loop->latches)
+        {
+            IRInst *term=latch->Terminator();
+            int s=term->succs[0]==loop->header?0:1;
+            long long d;
+            if(SplitOffset(term->SuccArg(s,iv->arg_index),d)!=iv || d==0 || (step!=0 && d!=step))
+            {
+                step=0;
+                break;
+            }
+            step=d;
+        }
+        // bound 可能的最大值和最小值; bound 为 x 减常数时, 由保证 x 下界的分支确定不会回绕
+        long long max_bound=INT_MAX,min_bound=INT_MIN,lower;
+        IRValue *x=SplitOffset(bound,offset);
+        if(bound->IsConst())
+            max_bound=min_bound=bound->const_val;
+        else if(offset<0 && GuardedLower(x,loop->header,dom,lower) && lower+offset>=INT_MIN)
+            max_bound=INT_MAX+offset;
+        if((op==KOOPA_RBO_LT && step>0 && max_bound-1+step<=INT_MAX) ||
+           (op==KOOPA_RBO_LE && step>0 && max_bound+step<=INT_MAX) ||
+           (op==KOOPA_RBO_GT && step<0 && min_bound+1+step>=INT_MIN) ||
+           (op==KOOPA_RBO_GE && step<0 && min_bound+step>=INT_MIN) ||
+           (op==KOOPA_RBO_NOT_EQ && (step==1 || step==-1)))
+            return true;
+    }
+    return false;
+}
+
+struct ADCE
+{
+    IRFunction *func;
+    const DomTree &pdom;
+    std::set<IRValue *> live;
+    std::set<IRBlock *> live_bbs;
+    std::vector<IRValue *> worklist;
+
+    ADCE(IRFunction *func,const DomTree &pdom):func(func),pdom(pdom){}
+
+    void MarkLive(IRValue *v)
+    {
+        if(v->kind!=IRV_INST && v->kind!=IRV_BLOCK_ARG)
+            return;
+        if(live.insert(v).second)
+            worklist.push_back(v);
+    }
+    void MarkBlock(IRBlock *bb)
+    {
+        if(!live_bbs.insert(bb).second)
+            return;
+        for(IRBlock *cd: pdom.Frontier(bb))
+            MarkLive(cd->Terminator());
+    }
+    void Propagate()
+    {
+        while(!worklist.empty())
+        {
+            IRValue *v=worklist.back();
+            worklist.pop_back();
+            MarkBlock(v->block);
+            if(v->kind==IRV_BLOCK_ARG)
+            {
+                IRBlock *bb=v->block;
+                for(IRBlock *pred: std::set<IRBlock *>(bb->preds.begin(),bb->preds.end()))
+                {
+                    IRInst *term=pred->Terminator();
+                    for(int s=0;s<(int)term->succs.size();++s)
+                        if(term->succs[s]==bb)
+                            MarkLive(term->SuccArg(s,v->arg_index));
+                    if(term->op==IR_BRANCH)
+                        MarkLive(term);
+                    else
+                        MarkBlock(pred);
+                }
+                continue;
+            }
+            IRInst *inst=v->AsInst();
+            // 跳转的实参只在对应参数有用时才有用
+            if(inst->op==IR_BRANCH)
+                MarkLive(inst->ops[0]);
+            else if(inst->op!=IR_JUMP)
+                for(IRValue *op: inst->ops)
+                    MarkLive(op);
+        }
+    }
+    // 无用的分支将跳到的基本块
+    IRBlock *Target(IRInst *br)
+    {
+        IRBlock *target=pdom.IDom(br->block);
+        assert(target!=nullptr);
+        return target;
+    }
+    void Run(const LoopInfo &loops,const DomTree &dom)
+    {
+        // 有不能到达 ret 的基本块 (死循环) 时不删除分支, 否则可能把死循环变成正常返回
+        bool keep_branches=pdom.RPO().size()!=func->blocks.size();
+        for(IRBlock *bb: func->blocks)
+        {
+            for(IRInst *inst: bb->insts)
+            {
+                bool root=inst->op==IR_STORE || inst->op==IR_RET ||
+                          (inst->op==IR_CALL && !inst->callee->modref.Removable()) ||
+                          (inst->op==IR_BRANCH && keep_branches);
+                if(root)
+                    MarkLive(inst);
+            }
+        }
+        for(Loop *loop: loops.PostOrder())
+        {
+            if(IsFinite(loop,dom))
+                continue;
+            for(IRBlock *bb: loop->blocks)
+            {
+                IRInst *term=bb->Terminator();
+                if(term->op!=IR_BRANCH)
+                    continue;
+                for(IRBlock *succ: term->succs)
+                    if(!loop->Contains(succ))
+                        MarkLive(term);
+            }
+        }
+        Propagate();
+        // 目标基本块有有用的参数时无法确定实参, 保留分支
+        bool again=true;
+        while(again)
+        {
+            again=false;
+            for(IRBlock *bb: func->blocks)
+            {
+                IRInst *term=bb->Terminator();
+                if(term->op!=IR_BRANCH || live.count(term))
+                    continue;
+                for(IRValue *param: Target(term)->params)
+                {
+                    if(live.count(param))
+                    {
+                        MarkLive(term);
+                        Propagate();
+                        again=true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    bool Rewrite()
+    {
+        bool changed=false;
+        for(IRBlock *bb: func->blocks)
+        {
+            for(int i=(int)bb->params.size()-1;i>=0;--i)
+            {
+                if(live.count(bb->params[i]))
+                    continue;
+                RemoveBlockParam(bb,i);
+                changed=true;
+            }
+        }
+        for(IRBlock *bb: func->blocks)
+        {
+            IRInst *term=bb->Terminator();
+            if(term->op!=IR_BRANCH || live.count(term))
+                continue;
+            IRBlock *target=Target(term);
+            term->EraseFromParent();
+            bb->Append(func->module->NewJump(target));
+            changed=true;
+        }
+        // 无用的指令之间可能互相使用, 先全部断开操作数再移除
+        std::vector<IRInst *> dead;
+        for(IRBlock *bb: func->blocks)
+            for(IRInst *inst: bb->insts)
+                if(inst->op!=IR_JUMP && !live.count(inst))
+                    dead.push_back(inst);
+        for(IRInst *inst: dead)
+            inst->DropOperands();
+        for(IRBlock *bb: func->blocks)
+        {
+            std::vector<IRInst *> kept;
+            for(IRInst *inst: bb->insts)
+            {
+                if(inst->op==IR_JUMP || live.count(inst))
+                    kept.push_back(inst);
+                else
+                {
+                    assert(inst->users.empty());
+                    inst->block=nullptr;
+                }
+            }
+            bb->insts=kept;
+        }
+        changed=changed || !dead.empty();
+        if(func->RemoveUnreachable())
+            changed=true;
+        return changed;
+    }
+};
+
+bool AggressiveDCE(IRFunction *func)
+{
+    func->RemoveUnreachable();
+    DomTree dom(func);
+    DomTree pdom(func,true);
+    LoopInfo loops(func,dom);
+    ADCE adce(func,pdom);
+    adce.Run(loops,dom);
+    return adce.Rewrite();
+}
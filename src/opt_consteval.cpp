@@ -0,0 +1,212 @@
+#include <cassert>
+#include <unordered_map>
+#include "opt.h"
+
+// 编译时求值: 实参都是常数的纯函数调用, 用解释器执行被调用的函数, 把调用替换为结果
+// 纯函数不读写调用者可见的内存, 但可以有自己的 alloc 并把它们的地址传给其他函数, 解释器因此也要模拟内存:
+// 每次执行 alloc 得到一个新的对象, 指针为 (对象, 以 i32 为单位的下标), 越界访问时放弃求值
+// 执行的指令数和调用深度都有上限, 超出时放弃; 整数实参的调用结果记入模块共用的表, 递归函数不会重复计算
+
+static const int kMaxSteps=1<<20;       // 一次求值最多执行的指令数
+static const int kMaxDepth=1000;        // 解释器自身递归的调用深度上限
+static const int kMaxMemory=1<<20;      // 所有 alloc 对象总共的 i32 个数上限
+
+struct Interpreter
+{
+    // obj<0 时为整数 val, 否则为指向 objects[obj][val] 的指针
+    struct Value
+    {
+        int obj=-1;
+        int val=0;
+    };
+
+    ConstCallCache &cache;
+    int fuel=kMaxSteps;
+    int depth=0;
+    int memory=0;
+    std::vector<std::vector<Value>> objects;
+
+    explicit Interpreter(ConstCallCache &cache):cache(cache){}
+
+    static bool Get(const std::unordered_map<IRValue *,Value> &env,IRValue *v,Value &res)
+    {
+        if(v->kind==IRV_CONST || v->kind==IRV_UNDEF)
+        {
+            res=Value();
+            res.val=v->kind==IRV_CONST?v->const_val:0;
+            return true;
+        }
+        // 全局变量: 纯函数不会访问, 能走到这里说明摘要过于保守, 放弃即可
+        auto it=env.find(v);
+        if(it==env.end())
+            return false;
+        res=it->second;
+        return true;
+    }
+    bool InBounds(const Value &p) const
+    {
+        return p.obj>=0 && p.val>=0 && p.val<(int)objects[p.obj].size();
+    }
+
+    bool Call(IRFunction *func,const std::vector<Value> &args,Value &res)
+    {
+        if(func->IsDecl() || depth>=kMaxDepth)
+            return false;
+        std::vector<int> key_args;
+        for(const Value &arg: args)
+            if(arg.obj<0)
+                key_args.push_back(arg.val);
+        bool memoize=key_args.size()==args.size();
+        ConstCallCache::key_type key(func,key_args);
+        if(memoize)
+        {
+            auto it=cache.find(key);
+            if(it!=cache.end())
+            {
+                if(!it->second.has_value())
+                    return false;
+                res=Value();
+                res.val=*it->second;
+                return true;
+            }
+        }
+        depth++;
+        int frame_objects=objects.size(),frame_memory=memory;
+        bool ok=Run(func,args,res);
+        depth--;
+        // 纯函数的 alloc 不会在返回后被访问, 可以释放
+        objects.resize(frame_objects);
+        memory=frame_memory;
+        if(ok && memoize && res.obj<0)
+            cache[key]=res.val;
+        return ok;
+    }
+
+    bool Run(IRFunction *func,const std::vector<Value> &args,Value &res)
+    {
+        std::unordered_map<IRValue *,Value> env;
+        for(int i=0;i<(int)func->params.size();++i)
+            env[func->params[i]]=args[i];
+        IRBlock *bb=func->Entry();
+        while(true)
+        {
+            IRBlock *next=nullptr;
+            std::vector<Value> next_args;
+            for(IRInst *inst: bb->insts)
+            {
+                if(--fuel<0)
+                    return false;
+                std::vector<Value> ops(inst->ops.size());
+                for(int i=0;i<(int)ops.size();++i)
+                    if(!Get(env,inst->ops[i],ops[i]))
+                        return false;
+                Value v;
+                switch (inst->op)
+                {
+                case IR_ALLOC:
+                {
+                    int size=inst->alloc_ty->Size()/4;
+                    memory+=size;
+                    if(memory>kMaxMemory)
+                        return false;
+                    v.obj=objects.size();
+                    objects.emplace_back(size);
+                    break;
+                }
+                case IR_LOAD:
+                    if(!InBounds(ops[0]))
+                        return false;
+                    v=objects[ops[0].obj][ops[0].val];
+                    break;
+                case IR_STORE:
+                    if(!InBounds(ops[1]))
+                        return false;
+                    objects[ops[1].obj][ops[1].val]=ops[0];
+                    break;
+                case IR_GEP:
+                case IR_GETPTR:
+                {
+                    IRType *pointee=inst->ops[0]->ty->base;
+                    int stride=((inst->op==IR_GEP)?pointee->base->Size():pointee->Size())/4;
+                    long long offset=ops[0].val+(long long)ops[1].val*stride;
+                    // 允许指向末尾之后, 真正访问时再检查
+                    if(ops[0].obj<0 || offset<0 || offset>(long long)objects[ops[0].obj].size())
+                        return false;
+                    v.obj=ops[0].obj;
+                    v.val=offset;
+                    break;
+                }
+                case IR_BINARY:
+                    if(ops[0].obj>=0 || ops[1].obj>=0 || !FoldBinary(inst->bop,ops[0].val,ops[1].val,v.val))
+                        return false;
+                    break;
+                case IR_CALL:
+                    if(!Call(inst->callee,ops,v))
+                        return false;
+                    break;
+                case IR_BRANCH:
+                case IR_JUMP:
+                {
+                    int s=(inst->op==IR_BRANCH && ops[0].val==0)?1:0;
+                    next=inst->succs[s];
+                    for(int j=0;j<inst->NumSuccArgs(s);++j)
+                        next_args.push_back(ops[inst->succ_arg_begin[s]+j]);
+                    break;
+                }
+                case IR_RET:
+                    res=ops.empty()?Value():ops[0];
+                    return true;
+                }
+                env[inst]=v;
+            }
+            assert(next!=nullptr);
+            for(int j=0;j<(int)next->params.size();++j)
+                env[next->params[j]]=next_args[j];
+            bb=next;
+        }
+    }
+};
+
+bool EvaluateConstCalls(IRFunction *func,ConstCallCache &cache)
+{
+    bool changed=false;
+    for(IRBlock *bb: func->blocks)
+    {
+        std::vector<IRInst *> kept;
+        for(IRInst *inst: bb->insts)
+        {
+            bool candidate=inst->op==IR_CALL && !inst->callee->IsDecl() && inst->callee->modref.IsPure();
+            std::vector<Interpreter::Value> args;
+            std::vector<int> key_args;
+            for(IRValue *op: inst->ops)
+            {
+                candidate=candidate && op->IsConst();
+                args.emplace_back();
+                args.back().val=op->const_val;
+                key_args.push_back(op->const_val);
+            }
+            Interpreter::Value res;
+            if(candidate)
+            {
+                Interpreter interp(cache);
+                candidate=interp.Call(inst->callee,args,res);
+                // 完整的步数都不够或执行出错时, 以后遇到相同的调用不再尝试
+                if(!candidate)
+                    cache.emplace(ConstCallCache::key_type(inst->callee,key_args),std::nullopt);
+            }
+            if(!candidate)
+            {
+                kept.push_back(inst);
+                continue;
+            }
+            // 没有返回值的纯函数调用能执行完就没有任何作用, 直接删除
+            if(inst->ty->tag!=IRT_UNIT)
+                inst->ReplaceAllUsesWith(func->module->GetConst(res.val));
+            inst->DropOperands();
+            inst->block=nullptr;
+            changed=true;
+        }
+        bb->insts=kept;
+    }
+    return changed;
+}
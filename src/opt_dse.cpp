@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include "alias.h"
+#include "loop.h"
+#include "opt.h"
+
+// 死 store 删除: 从每个 store 出发沿控制流向后检查所有路径, 每条路径都满足下列之一时删除:
+// 1. 在可能读这块内存的指令 (由别名分析判断) 之前遇到地址相同的 store, 即被覆盖
+// 2. 到达 ret, 且写的只可能是本函数的 alloc, 返回后不会再被读到
+// 3. 写的是没有逃逸的 alloc, 在读它之前从循环外进入一个会把它整个覆盖的循环, 例如局部数组的初始化之后
+//    用循环给每个元素赋值: 前端生成的全零初始化 (直线的 store 或 _init_loop 循环) 都可以删除, 空的初始化循环由 ADCE 删除
+// 向后越过地址的基址或变量项的定义之后, 同一个 SSA 值代表的是另一个地址, 不再能判断覆盖和别名; 只对没有逃逸的 alloc
+// 继续检查, 此时任何基址为它的 load 都算读, 只能由 2, 3 结束
+// 循环整个覆盖的内存按循环嵌套自内向外计算: 计数器从常数每次加 1 到常数边界, 只从 header 退出的循环执行完整的迭代次数,
+// 每次迭代都执行的 store 和内层循环写的区间按计数器展开, 最后不含变量项并且包含整个 alloc 时就是整个覆盖
+
+static const int kMaxVisitedBlocks=64;  // 每个 store 最多检查的基本块数
+
+static bool IsAlloc(IRValue *v)
+{
+    return v->kind==IRV_INST && v->AsInst()->op==IR_ALLOC;
+}
+
+// 写过的一段内存: 相对 alloc 的字节区间 [lo,hi) 加上 Σ terms[v]*v
+struct Region
+{
+    std::map<IRValue *,int> terms;
+    long long lo,hi;
+};
+
+// 合并变量项相同并且相交或相邻的区间
+static std::vector<Region> MergeRegions(std::vector<Region> regions)
+{
+    std::sort(regions.begin(),regions.end(),[](const Region &a,const Region &b) {
+        return a.terms!=b.terms?a.terms<b.terms:a.lo<b.lo;
+    });
+    std::vector<Region> res;
+    for(Region &r: regions)
+    {
+        if(!res.empty() && res.back().terms==r.terms && r.lo<=res.back().hi)
+            res.back().hi=std::max(res.back().hi,r.hi);
+        else
+            res.push_back(r);
+    }
+    return res;
+}
+
+struct DSE
+{
+    IRFunction *func;
+    AliasInfo alias;
+    DomTree dom;
+    LoopInfo loops;
+    std::map<Loop *,std::map<IRValue *,std::vector<Region>>> written;   // 循环执行完后一定写过的区间
+    std::map<IRBlock *,std::set<IRValue *>> overwrites;                 // 循环的 header -> 从循环外进入后整个覆盖的 alloc
+    // 当前检查的 store
+    IRValue *ptr=nullptr;
+    PtrInfo info;
+    std::set<IRValue *> leaves;     // 地址依赖的值: 基址和变量项
+    IRValue *local=nullptr;         // 只可能写一个没有逃逸的 alloc 时为该 alloc
+    bool all_alloc=false;           // 只可能写本函数的 alloc
+    std::set<std::pair<IRBlock *,bool>> visited;
+    int budget=0;
+
+    explicit DSE(IRFunction *func):func(func),alias(func),dom(func),loops(func,dom){}
+
+    bool IsLocal(IRValue *v) const { return IsAlloc(v) && !alias.Escaped(v); }
+    bool ReadsLocal(IRInst *inst) const
+    {
+        return inst->op==IR_LOAD && alias.Objects(inst->ops[0]).count(local);
+    }
+
+    // 计数循环: 只从 header 退出, 计数器从常数 first 开始每次加 1, 小于常数 last 时继续; 返回计数器, 不是时返回 nullptr
+    IRValue *CountedLoop(Loop *loop,long long &first,long long &last) const
+    {
+        IRBlock *header=loop->header;
+        if(loop->latches.size()!=1)
+            return nullptr;
+        for(IRBlock *bb: loop->blocks)
+            for(IRBlock *succ: bb->Succs())
+                if(bb!=header && !loop->Contains(succ))
+                    return nullptr;
+        IRInst *br=header->Terminator();
+        if(br->op!=IR_BRANCH || !loop->Contains(br->succs[0]) || loop->Contains(br->succs[1]) ||
+           !br->ops[0]->IsInst())
+            return nullptr;
+        IRInst *cmp=br->ops[0]->AsInst();
+        if(cmp->op!=IR_BINARY)
+            return nullptr;
+        koopa_raw_binary_op_t op=cmp->bop;
+        IRValue *iv=cmp->ops[0],*bound=cmp->ops[1];
+        if(op==KOOPA_RBO_GT || op==KOOPA_RBO_GE)
+        {
+            std::swap(iv,bound);
+            op=(op==KOOPA_RBO_GT)?KOOPA_RBO_LT:KOOPA_RBO_LE;
+        }
+        if((op!=KOOPA_RBO_LT && op!=KOOPA_RBO_LE) || iv->kind!=IRV_BLOCK_ARG || iv->block!=header ||
+           !bound->IsConst())
+            return nullptr;
+
+        IRValue *init=nullptr;
+        for(IRBlock *pred: header->preds)
+        {
+            if(loop->Contains(pred))
+                continue;
+            if(init!=nullptr)
+                return nullptr;
+            IRInst *term=pred->Terminator();
+            int s=term->succs[0]==header?0:1;
+            init=term->SuccArg(s,iv->arg_index);
+        }
+        IRInst *term=loop->latches[0]->Terminator();
+        int s=term->succs[0]==header?0:1;
+        IRValue *next=term->SuccArg(s,iv->arg_index);
+        if(init==nullptr || !init->IsConst() || !next->IsInst())
+            return nullptr;
+        IRInst *inc=next->AsInst();
+        if(inc->op!=IR_BINARY || inc->bop!=KOOPA_RBO_ADD ||
+           !((inc->ops[0]==iv && inc->ops[1]->IsConst(1)) || (inc->ops[1]==iv && inc->ops[0]->IsConst(1))))
+            return nullptr;
+        first=init->const_val;
+        last=(long long)bound->const_val+(op==KOOPA_RBO_LE);
+        return first<last?iv:nullptr;
+    }
+
+    void ComputeWritten(Loop *loop)
+    {
+        long long first,last;
+        IRValue *iv=CountedLoop(loop,first,last);
+        if(iv==nullptr)
+            return;
+        IRBlock *latch=loop->latches[0];
+        auto invariant=[&](IRValue *v) {
+            return (v->kind!=IRV_INST && v->kind!=IRV_BLOCK_ARG) || !loop->Contains(v->block);
+        };
+        // 每次迭代都执行的基本块中的 store, 以及每次迭代都完整执行的内层循环
+        std::map<IRValue *,std::vector<Region>> per_iter;
+        for(IRBlock *bb: loop->blocks)
+        {
+            if(!dom.Dominates(bb,latch))
+                continue;
+            Loop *inner=loops.LoopOf(bb);
+            if(inner!=loop)
+            {
+                if(inner->header==bb && inner->parent==loop && written.count(inner))
+                    for(auto &[obj,regions]: written[inner])
+                        per_iter[obj].insert(per_iter[obj].end(),regions.begin(),regions.end());
+                continue;
+            }
+            for(IRInst *inst: bb->insts)
+            {
+                if(inst->op!=IR_STORE)
+                    continue;
+                PtrInfo p=AnalyzePtr(inst->ops[1]);
+                if(IsLocal(p.base))
+                    per_iter[p.base].push_back({p.terms,p.offset,p.offset+inst->ops[0]->ty->Size()});
+            }
+        }
+        // 按计数器展开: 每次迭代写的区间至少和步长一样长时, 所有迭代写的区间连成一段
+        for(auto &[obj,regions]: per_iter)
+        {
+            // 按其余的变量项和计数器的系数分组
+            std::map<std::pair<std::map<IRValue *,int>,int>,std::vector<Region>> groups;
+            for(Region &r: regions)
+            {
+                int scale=0;
+                auto it=r.terms.find(iv);
+                if(it!=r.terms.end())
+                {
+                    scale=it->second;
+                    r.terms.erase(it);
+                }
+                bool ok=true;
+                for(auto &[v,k]: r.terms)
+                    ok=ok && invariant(v);
+                if(ok)
+                    groups[{r.terms,scale}].push_back(r);
+            }
+            std::vector<Region> res;
+            for(auto &[key,group]: groups)
+            {
+                long long step=std::abs(key.second);
+                long long lo=std::min(first*key.second,(last-1)*key.second);
+                long long hi=std::max(first*key.second,(last-1)*key.second);
+                for(Region &r: MergeRegions(group))
+                    if(r.hi-r.lo>=step)
+                        res.push_back({r.terms,r.lo+lo,r.hi+hi});
+            }
+            res=MergeRegions(res);
+            // 不含变量项的区间包含整个 alloc, 并且循环中不读它
+            for(Region &r: res)
+                if(r.terms.empty() && r.lo<=0 && r.hi>=obj->AsInst()->alloc_ty->Size() && !ReadIn(loop,obj))
+                    overwrites[loop->header].insert(obj);
+            written[loop][obj]=res;
+        }
+    }
+    bool ReadIn(Loop *loop,IRValue *obj) const
+    {
+        for(IRBlock *bb: loop->blocks)
+            for(IRInst *inst: bb->insts)
+                if(inst->op==IR_LOAD && alias.Objects(inst->ops[0]).count(obj))
+                    return true;
+        return false;
+    }
+
+    bool SameAddr(IRValue *q) const
+    {
+        if(q==ptr)
+            return true;
+        PtrInfo other=AnalyzePtr(q);
+        return other.base==info.base && other.offset==info.offset && other.terms==info.terms;
+    }
+
+    // 从 bb 的第 pos 条指令开始向后检查, moved 表示已经越过了地址的定义; 返回这条路径上写入的值是否一定不会被读到
+    bool Scan(IRBlock *bb,int pos,bool moved)
+    {
+        for(int i=pos;i<(int)bb->insts.size();++i)
+        {
+            IRInst *inst=bb->insts[i];
+            if(moved?ReadsLocal(inst):alias.MayRead(inst,ptr))
+                return false;
+            if(!moved && inst->op==IR_STORE && SameAddr(inst->ops[1]))
+                return true;
+            if(inst->op==IR_RET)
+                return all_alloc;
+            if(leaves.count(inst))
+            {
+                if(local==nullptr)
+                    return false;
+                moved=true;
+            }
+        }
+        for(IRBlock *succ: bb->Succs())
+            if(!Enter(succ,bb,moved))
+                return false;
+        return true;
+    }
+    bool Enter(IRBlock *bb,IRBlock *from,bool moved)
+    {
+        auto it=overwrites.find(bb);
+        if(local!=nullptr && it!=overwrites.end() && it->second.count(local) && !loops.LoopOf(bb)->Contains(from))
+            return true;
+        for(IRValue *param: bb->params)
+        {
+            if(!leaves.count(param))
+                continue;
+            if(local==nullptr)
+                return false;
+            moved=true;
+        }
+        // 已经检查过的基本块不必重复, 沿这条路径回到那里时由那次检查负责
+        if(!visited.insert({bb,moved}).second)
+            return true;
+        if(--budget<0)
+            return false;
+        return Scan(bb,0,moved);
+    }
+
+    bool IsDead(IRBlock *bb,int pos)
+    {
+        ptr=bb->insts[pos]->ops[1];
+        info=AnalyzePtr(ptr);
+        leaves.clear();
+        leaves.insert(info.base);
+        for(auto &[v,scale]: info.terms)
+            leaves.insert(v);
+        std::set<IRValue *> objects=alias.Objects(ptr);
+        local=(objects.size()==1 && IsLocal(*objects.begin()))?*objects.begin():nullptr;
+        all_alloc=true;
+        for(IRValue *obj: objects)
+            all_alloc=all_alloc && IsAlloc(obj);
+        visited.clear();
+        budget=kMaxVisitedBlocks;
+        return Scan(bb,pos+1,false);
+    }
+
+    bool Run()
+    {
+        for(Loop *loop: loops.PostOrder())
+            ComputeWritten(loop);
+        // 先全部判断再删除, 被删除的 store 之后也没有读, 不影响其他 store 的结论
+        std::vector<IRInst *> dead;
+        for(IRBlock *bb: func->blocks)
+            for(int i=0;i<(int)bb->insts.size();++i)
+                if(bb->insts[i]->op==IR_STORE && IsDead(bb,i))
+                    dead.push_back(bb->insts[i]);
+        for(IRInst *inst: dead)
+            inst->EraseFromParent();
+        return !dead.empty();
+    }
+};
+
+bool EliminateDeadStores(IRFunction *func)
+{
+    func->RemoveUnreachable();
+    func->ComputePreds();
+    DSE dse(func);
+    return dse.Run();
+}
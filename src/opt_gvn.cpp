@@ -0,0 +1,210 @@
+#include <cassert>
+#include <set>
+#include <tuple>
+#include "alias.h"
+#include "dom.h"
+#include "opt.h"
+
+// 基于支配树的全局值编号
+// 沿支配树先序遍历, 用带作用域的表记录已经计算过的纯运算 (二元运算, 地址计算), 后出现的相同运算直接替换
+// 操作数先替换为代表值, 所以比较操作数指针即可; 交换律运算和比较先规范化操作数顺序, 常数运算直接折叠
+// 调用纯函数 (副作用摘要中不读写内存) 也按被调用函数和实参编号
+// load 另外记录每个地址当前已知的值, 遇到可能别名的 store 或可能写这块内存的 call 时失效;
+// 只有当子结点的唯一前驱是支配树上的父结点时, 才把父结点末尾的内存状态带入子结点
+
+static bool IsCommutative(koopa_raw_binary_op_t op)
+{
+    return op==KOOPA_RBO_ADD || op==KOOPA_RBO_MUL || op==KOOPA_RBO_AND || op==KOOPA_RBO_OR ||
+           op==KOOPA_RBO_XOR || op==KOOPA_RBO_EQ || op==KOOPA_RBO_NOT_EQ;
+}
+// 交换操作数后等价的比较
+static koopa_raw_binary_op_t SwappedCompare(koopa_raw_binary_op_t op)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_GT:
+        return KOOPA_RBO_LT;
+    case KOOPA_RBO_LT:
+        return KOOPA_RBO_GT;
+    case KOOPA_RBO_GE:
+        return KOOPA_RBO_LE;
+    case KOOPA_RBO_LE:
+        return KOOPA_RBO_GE;
+    default:
+        return op;
+    }
+}
+
+// 能直接确定结果的二元运算: 常数折叠和代数恒等式, 不能确定时返回 nullptr
+static IRValue *SimplifyBinary(IRModule *module,koopa_raw_binary_op_t op,IRValue *lhs,IRValue *rhs)
+{
+    int res;
+    if(lhs->IsConst() && rhs->IsConst())
+        return FoldBinary(op,lhs->const_val,rhs->const_val,res)?module->GetConst(res):nullptr;
+    if(IsCommutative(op) && lhs->IsConst())
+        std::swap(lhs,rhs);
+    switch (op)
+    {
+    case KOOPA_RBO_ADD:
+    case KOOPA_RBO_OR:
+    case KOOPA_RBO_XOR:
+    case KOOPA_RBO_SHL:
+    case KOOPA_RBO_SHR:
+    case KOOPA_RBO_SAR:
+        if(rhs->IsConst(0))
+            return lhs;
+        break;
+    case KOOPA_RBO_SUB:
+        if(rhs->IsConst(0))
+            return lhs;
+        break;
+    case KOOPA_RBO_MUL:
+    case KOOPA_RBO_DIV:
+        if(rhs->IsConst(1))
+            return lhs;
+        if(op==KOOPA_RBO_MUL && rhs->IsConst(0))
+            return rhs;
+        break;
+    case KOOPA_RBO_MOD:
+        if(rhs->IsConst(1) || rhs->IsConst(-1))
+            return module->GetConst(0);
+        break;
+    case KOOPA_RBO_AND:
+        if(rhs->IsConst(0))
+            return rhs;
+        break;
+    default:
+        break;
+    }
+    if(lhs==rhs && lhs->kind!=IRV_UNDEF)
+    {
+        switch (op)
+        {
+        case KOOPA_RBO_SUB:
+        case KOOPA_RBO_XOR:
+        case KOOPA_RBO_NOT_EQ:
+        case KOOPA_RBO_GT:
+        case KOOPA_RBO_LT:
+            return module->GetConst(0);
+        case KOOPA_RBO_EQ:
+        case KOOPA_RBO_GE:
+        case KOOPA_RBO_LE:
+            return module->GetConst(1);
+        case KOOPA_RBO_AND:
+        case KOOPA_RBO_OR:
+            return lhs;
+        default:
+            break;
+        }
+    }
+    return nullptr;
+}
+
+struct GVN
+{
+    typedef std::tuple<int,int,IRFunction *,std::vector<IRValue *>> ExprKey;     // 操作, 二元运算类型, 被调用函数, 操作数
+
+    IRFunction *func;
+    const DomTree &dom;
+    std::map<ExprKey,IRValue *> exprs;
+    AliasInfo alias;
+    bool changed=false;
+
+    GVN(IRFunction *func,const DomTree &dom):func(func),dom(dom),alias(func){}
+
+    // 查找已经计算过的相同运算, 没有时记录 inst
+    IRValue *Number(const ExprKey &key,IRInst *inst,std::vector<ExprKey> &added)
+    {
+        auto it=exprs.find(key);
+        if(it!=exprs.end())
+            return it->second;
+        exprs[key]=inst;
+        added.push_back(key);
+        return nullptr;
+    }
+
+    void Visit(IRBlock *bb,std::map<IRValue *,IRValue *> mem)
+    {
+        IRModule *module=func->module;
+        std::vector<ExprKey> added;
+        std::vector<IRInst *> kept;
+        for(IRInst *inst: bb->insts)
+        {
+            IRValue *repl=nullptr;
+            switch (inst->op)
+            {
+            case IR_BINARY:
+            case IR_GEP:
+            case IR_GETPTR:
+            {
+                std::vector<IRValue *> ops=inst->ops;
+                int bop=inst->bop;
+                if(inst->op==IR_BINARY)
+                {
+                    repl=SimplifyBinary(module,inst->bop,ops[0],ops[1]);
+                    if(repl!=nullptr)
+                        break;
+                    koopa_raw_binary_op_t swapped=SwappedCompare(inst->bop);
+                    if((IsCommutative(inst->bop) || swapped!=inst->bop) && ops[1]<ops[0])
+                    {
+                        std::swap(ops[0],ops[1]);
+                        bop=swapped;
+                    }
+                }
+                repl=Number(ExprKey(inst->op,inst->op==IR_BINARY?bop:0,nullptr,ops),inst,added);
+                break;
+            }
+            case IR_LOAD:
+            {
+                auto it=mem.find(inst->ops[0]);
+                if(it!=mem.end())
+                    repl=it->second;
+                else
+                    mem[inst->ops[0]]=inst;
+                break;
+            }
+            case IR_STORE:
+            case IR_CALL:
+                if(inst->op==IR_CALL && inst->callee->modref.IsPure() && inst->ty->tag!=IRT_UNIT)
+                {
+                    repl=Number(ExprKey(IR_CALL,0,inst->callee,inst->ops),inst,added);
+                    break;
+                }
+                for(auto it=mem.begin();it!=mem.end();)
+                    it=alias.MayWrite(inst,it->first)?mem.erase(it):std::next(it);
+                if(inst->op==IR_STORE)
+                    mem[inst->ops[1]]=inst->ops[0];
+                break;
+            default:
+                break;
+            }
+            if(repl==nullptr)
+            {
+                kept.push_back(inst);
+                continue;
+            }
+            inst->ReplaceAllUsesWith(repl);
+            inst->DropOperands();
+            inst->block=nullptr;
+            changed=true;
+        }
+        bb->insts=kept;
+
+        for(IRBlock *child: dom.Children(bb))
+        {
+            bool single_pred=child->preds.size()==1 && child->preds[0]==bb;
+            Visit(child,single_pred?mem:std::map<IRValue *,IRValue *>());
+        }
+        for(const ExprKey &key: added)
+            exprs.erase(key);
+    }
+};
+
+bool GlobalValueNumbering(IRFunction *func)
+{
+    func->RemoveUnreachable();
+    DomTree dom(func);
+    GVN gvn(func,dom);
+    gvn.Visit(func->Entry(),{});
+    return gvn.changed;
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cassert>
+#include "callgraph.h"
+#include "loop.h"
+#include "opt.h"
+
+// 函数内联, 按调用图自底向上进行: 处理一个函数时, 它调用的函数已经内联和优化过, 大小就是内联后的实际代价
+// 被调用的函数在调用处复制一份: 调用所在的基本块在 call 处拆开, 后半部分成为接收返回值的新基本块,
+// ret 改为带返回值跳到这个基本块; alloc 移到调用者的入口. 之后由调用者的常量传播和死代码删除清理
+// 代价模型: 被调用函数的指令数减去省掉的调用开销和常数实参带来的化简, 与阈值比较;
+// 调用处在循环中时阈值随嵌套深度提高, 只有一处调用的函数内联后原函数可以删除, 阈值也提高; 递归函数不内联
+// 生成 RISCV 时不内联含循环的函数, 后端只在叶函数中使用寄存器
+
+static const int kInlineThreshold=16;
+static const int kLoopDepthBonus=24;        // 每层循环提高的阈值
+static const int kMaxLoopDepth=3;
+static const int kSingleCallBonus=160;      // 只有一处调用时提高的阈值
+static const int kConstArgBonus=2;          // 常数实参对应的形参每有一处使用, 代价减少的值
+static const int kMaxCallerInsts=2000;      // 调用者内联后的指令数上限
+
+struct Inliner
+{
+    IRFunction *func;
+    IRModule *module;
+    const CallGraph &cg;
+    const OptOptions &opts;
+    std::map<IRFunction *,int> call_count;  // 整个模块中对每个函数的调用次数
+
+    Inliner(IRFunction *func,const CallGraph &cg,const OptOptions &opts):
+        func(func),module(func->module),cg(cg),opts(opts)
+    {
+        for(IRFunction *f: module->funcs)
+            for(IRBlock *bb: f->blocks)
+                for(IRInst *inst: bb->insts)
+                    if(inst->op==IR_CALL)
+                        call_count[inst->callee]++;
+    }
+
+    bool ShouldInline(IRInst *call,int depth,int caller_size)
+    {
+        IRFunction *callee=call->callee;
+        if(callee->IsDecl() || callee==func || cg.IsRecursive(callee) || cg.SameSCC(callee,func))
+            return false;
+        int size=callee->InstCount();
+        if(caller_size+size>kMaxCallerInsts)
+            return false;
+        // RISCV 后端只在叶函数中把值放在寄存器里, 含循环的函数内联到调用者中后, 循环里的值都要改为放在栈上
+        if(opts.for_riscv && callee->HasLoop())
+            return false;
+        // 调用本身: 传参, call, 取返回值
+        int cost=size-(int)call->ops.size()-2;
+        for(int i=0;i<(int)call->ops.size();++i)
+            if(call->ops[i]->IsConst())
+                cost-=kConstArgBonus*callee->params[i]->users.size();
+        int threshold=kInlineThreshold+kLoopDepthBonus*std::min(depth,kMaxLoopDepth);
+        if(call_count[callee]==1)
+            threshold+=kSingleCallBonus;
+        return cost<=threshold;
+    }
+
+    void Inline(IRInst *call)
+    {
+        IRFunction *callee=call->callee;
+        IRBlock *bb=call->block;
+        auto &blocks=func->blocks;
+        auto pos=std::find(bb->insts.begin(),bb->insts.end(),call);
+        assert(pos!=bb->insts.end());
+
+        // call 之后的指令移到新的基本块, 返回值为它的参数
+        IRBlock *cont=module->NewBlock(func,bb->name+"_"+callee->name.substr(1)+"_ret");
+        blocks.pop_back();
+        blocks.insert(std::find(blocks.begin(),blocks.end(),bb)+1,cont);
+        IRValue *ret_val=nullptr;
+        if(call->ty->tag!=IRT_UNIT)
+            ret_val=cont->AddParam(call->ty,callee->name.substr(1)+"_ret");
+        for(auto it=pos+1;it!=bb->insts.end();++it)
+            cont->Append(*it);
+        bb->insts.erase(pos,bb->insts.end());
+
+        std::map<IRValue *,IRValue *> vmap;
+        std::map<IRBlock *,IRBlock *> bmap;
+        for(int i=0;i<(int)callee->params.size();++i)
+            vmap[callee->params[i]]=call->ops[i];
+        std::vector<IRBlock *> order=callee->ReversePostOrder();
+        int insert_pos=std::find(blocks.begin(),blocks.end(),cont)-blocks.begin();
+        // 被调用函数可能还有其他调用者而保留下来, 复制的基本块换一个名字, 不与它的基本块重名
+        for(IRBlock *src: order)
+        {
+            IRBlock *copy=module->NewBlock(func,src->name+"_in_"+func->name.substr(1));
+            copy->unrolled=src->unrolled;
+            blocks.pop_back();
+            blocks.insert(blocks.begin()+insert_pos++,copy);
+            bmap[src]=copy;
+            for(IRValue *param: src->params)
+                vmap[param]=copy->AddParam(param->ty,param->name);
+        }
+        // 按逆后序复制, 操作数的定义总在使用之前复制
+        int alloc_pos=0;
+        for(IRBlock *src: order)
+        {
+            IRBlock *copy=bmap[src];
+            for(IRInst *inst: src->insts)
+            {
+                if(inst->op==IR_RET)
+                {
+                    std::vector<IRValue *> args;
+                    if(ret_val!=nullptr)
+                    {
+                        IRValue *v=inst->ops[0];
+                        args.push_back(vmap.count(v)?vmap[v]:v);
+                    }
+                    copy->Append(module->NewJump(cont,args));
+                    continue;
+                }
+                IRInst *clone=module->CloneInst(inst,vmap,bmap);
+                vmap[inst]=clone;
+                if(inst->op==IR_ALLOC)
+                    func->Entry()->Insert(alloc_pos++,clone);
+                else
+                    copy->Append(clone);
+            }
+        }
+
+        if(ret_val!=nullptr)
+            call->ReplaceAllUsesWith(ret_val);
+        call->DropOperands();
+        call->block=nullptr;
+        bb->Append(module->NewJump(bmap[callee->Entry()]));
+
+        call_count[callee]--;
+        for(IRBlock *src: order)
+            for(IRInst *inst: src->insts)
+                if(inst->op==IR_CALL)
+                    call_count[inst->callee]++;
+    }
+
+    bool Run()
+    {
+        func->RemoveUnreachable();
+        DomTree dom(func);
+        LoopInfo loops(func,dom);
+        std::vector<std::pair<IRInst *,int>> calls;
+        for(IRBlock *bb: func->blocks)
+        {
+            Loop *loop=loops.LoopOf(bb);
+            for(IRInst *inst: bb->insts)
+                if(inst->op==IR_CALL)
+                    calls.push_back({inst,loop==nullptr?0:loop->depth});
+        }
+        // 内层循环中的调用优先
+        std::stable_sort(calls.begin(),calls.end(),[](const auto &a,const auto &b){ return a.second>b.second; });
+        bool changed=false;
+        int size=func->InstCount();
+        for(auto &[call,depth]: calls)
+        {
+            if(!ShouldInline(call,depth,size))
+                continue;
+            size+=call->callee->InstCount();
+            Inline(call);
+            changed=true;
+        }
+        if(changed)
+            func->ComputePreds();
+        return changed;
+    }
+};
+
+bool InlineCalls(IRFunction *func,const CallGraph &cg,const OptOptions &opts)
+{
+    Inliner inliner(func,cg,opts);
+    return inliner.Run();
+}
+
+bool RemoveUnusedFunctions(IRModule &module)
+{
+    // 删除一个函数后它调用的函数也可能不再被调用, 反复进行
+    bool changed=false;
+    bool again=true;
+    while(again)
+    {
+        std::set<IRFunction *> used;
+        for(IRFunction *func: module.funcs)
+            for(IRBlock *bb: func->blocks)
+                for(IRInst *inst: bb->insts)
+                    if(inst->op==IR_CALL && inst->callee!=func)
+                        used.insert(inst->callee);
+        std::vector<IRFunction *> kept;
+        for(IRFunction *func: module.funcs)
+        {
+            if(func->IsDecl() || func->name=="@main" || used.count(func))
+            {
+                kept.push_back(func);
+                continue;
+            }
+            for(IRBlock *bb: func->blocks)
+                for(IRInst *inst: bb->insts)
+                    inst->DropOperands();
+        }
+        again=kept.size()!=module.funcs.size();
+        changed=changed || again;
+        module.funcs=kept;
+    }
+    return changed;
+}
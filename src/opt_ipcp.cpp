@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cassert>
+#include "opt.h"
+
+// 过程间常量传播和函数特化, 在各函数优化之前对整个模块进行 (需要 SSA 形式的实参)
+// 可以在被调用函数中重新构造的实参称为常量实参: 整数常数, 全局变量, 以及全局变量上下标都是常数的地址
+// 只代入能带来化简的实参: 与常数运算, 作为条件或基本块实参, 乘除数, 较小的比较常数, 全局数组的地址 (别名分析可以区分);
+// RISCV 没有与立即数比较的跳转, 与循环变量比较的大常数反而每次迭代多一条 li
+// 1. 所有调用处 (不计把形参原样传给自己的递归调用) 传入同一个常量实参时, 直接在函数体中把形参替换为它
+// 2. 否则按调用处的常量实参分组, 调用处最多的几组各复制一份函数体并代入常量, 调用处改为调用复制的函数;
+//    复制的函数中把对应形参原样传下去的递归调用也改为调用自己. 函数大小和增加的总指令数都有上限
+// 替换后不再使用的形参, 以及所有调用处都不使用的返回值, 由 RemoveDeadArgs 在各函数优化之后删除
+
+static const int kMaxSpecializeInsts=300;   // 只复制不超过这个大小的函数
+static const int kMaxSpecializations=3;     // 每个函数最多的复制数
+static const int kSpecializeBudget=1500;    // 整个模块因复制增加的指令数上限
+static const int kSmallConst=32;            // 与变量比较的常数不超过它时, 多半是可以完全展开的循环次数
+
+// 形参编号和代入的常量实参
+typedef std::vector<std::pair<int,IRValue *>> ArgSignature;
+
+static bool IsConstArg(IRValue *v)
+{
+    if(v->kind==IRV_CONST || v->kind==IRV_GLOBAL)
+        return true;
+    if(v->kind!=IRV_INST)
+        return false;
+    IRInst *inst=v->AsInst();
+    return (inst->op==IR_GEP || inst->op==IR_GETPTR) && inst->ops[1]->IsConst() && IsConstArg(inst->ops[0]);
+}
+static bool SameArg(IRValue *a,IRValue *b)
+{
+    if(a==b)
+        return true;
+    if(a->kind!=b->kind || a->ty!=b->ty)
+        return false;
+    if(a->kind==IRV_CONST)
+        return a->const_val==b->const_val;
+    if(a->kind!=IRV_INST)
+        return false;
+    IRInst *x=a->AsInst(),*y=b->AsInst();
+    return x->op==y->op && x->ops[1]->const_val==y->ops[1]->const_val && SameArg(x->ops[0],y->ops[0]);
+}
+static bool SameSignature(const ArgSignature &a,const ArgSignature &b)
+{
+    if(a.size()!=b.size())
+        return false;
+    for(int i=0;i<(int)a.size();++i)
+        if(a[i].first!=b[i].first || !SameArg(a[i].second,b[i].second))
+            return false;
+    return true;
+}
+
+// 把 arg 代入形参 param 后能化简的使用数
+static int Benefit(IRValue *param,IRValue *arg)
+{
+    int benefit=0;
+    for(IRInst *user: param->users)
+    {
+        // 基本块实参多为循环变量的初值, 代入后循环次数可能成为常数
+        if(arg->kind!=IRV_CONST || user->op==IR_BRANCH || user->op==IR_JUMP || user->op==IR_CALL)
+        {
+            benefit++;
+            continue;
+        }
+        if(user->op!=IR_BINARY)
+            continue;
+        IRValue *other=(user->ops[0]==param)?user->ops[1]:user->ops[0];
+        bool divisor=user->ops[1]==param && (user->bop==KOOPA_RBO_DIV || user->bop==KOOPA_RBO_MOD);
+        if(other->IsConst() || divisor || user->bop==KOOPA_RBO_MUL ||
+           (arg->const_val>=-kSmallConst && arg->const_val<=kSmallConst))
+            benefit++;
+    }
+    return benefit;
+}
+
+struct Specializer
+{
+    IRModule &module;
+    std::map<IRFunction *,std::vector<IRInst *>> calls;     // 每个函数的所有调用处
+    int budget=kSpecializeBudget;
+
+    explicit Specializer(IRModule &module):module(module)
+    {
+        for(IRFunction *func: module.funcs)
+            for(IRBlock *bb: func->blocks)
+                for(IRInst *inst: bb->insts)
+                    if(inst->op==IR_CALL)
+                        calls[inst->callee].push_back(inst);
+    }
+
+    // 在 func 的入口重新构造常量实参, pos 为插入位置
+    IRValue *Materialize(IRFunction *func,IRValue *v,int &pos)
+    {
+        if(v->kind==IRV_CONST)
+            return module.GetConst(v->const_val);
+        if(v->kind==IRV_GLOBAL)
+            return v;
+        IRInst *inst=v->AsInst();
+        IRValue *base=Materialize(func,inst->ops[0],pos);
+        IRValue *index=module.GetConst(inst->ops[1]->const_val);
+        IRInst *addr=(inst->op==IR_GEP)?module.NewGep(base,index):module.NewGetPtr(base,index);
+        func->Entry()->Insert(pos++,addr);
+        return addr;
+    }
+    void Substitute(IRFunction *func,const ArgSignature &sig)
+    {
+        int pos=0;
+        for(auto &[i,v]: sig)
+            func->params[i]->ReplaceAllUsesWith(Materialize(func,v,pos));
+    }
+    // 把形参 i 原样传给 func 自己的调用
+    static bool PassesThrough(IRFunction *func,IRInst *call,int i)
+    {
+        return call->block->parent==func && call->ops[i]==func->params[i];
+    }
+
+    bool PropagateUniform(IRFunction *func)
+    {
+        const std::vector<IRInst *> &sites=calls[func];
+        ArgSignature sig;
+        for(int i=0;i<(int)func->params.size();++i)
+        {
+            if(func->params[i]->users.empty())
+                continue;
+            IRValue *value=nullptr;
+            bool uniform=true;
+            for(IRInst *call: sites)
+            {
+                if(PassesThrough(func,call,i))
+                    continue;
+                IRValue *arg=call->ops[i];
+                uniform=uniform && IsConstArg(arg) && (value==nullptr || SameArg(value,arg));
+                value=arg;
+            }
+            if(uniform && value!=nullptr && Benefit(func->params[i],value)>0)
+                sig.push_back({i,value});
+        }
+        Substitute(func,sig);
+        return !sig.empty();
+    }
+
+    IRFunction *Clone(IRFunction *func)
+    {
+        std::string name;
+        for(int n=1;;++n)
+        {
+            name=func->name+"_spec"+std::to_string(n);
+            bool used=module.FindFunction(name)!=nullptr;
+            for(IRGlobal *global: module.globals)
+                used=used || global->name==name;
+            if(!used)
+                break;
+        }
+        IRFunction *clone=module.NewFunction(name,func->ret_ty,func->param_tys);
+        // 放在原函数之后, 保持定义在调用之前的顺序
+        module.funcs.pop_back();
+        module.funcs.insert(std::find(module.funcs.begin(),module.funcs.end(),func)+1,clone);
+        std::map<IRValue *,IRValue *> vmap;
+        std::map<IRBlock *,IRBlock *> bmap;
+        for(int i=0;i<(int)func->params.size();++i)
+        {
+            clone->params[i]->name=func->params[i]->name;
+            vmap[func->params[i]]=clone->params[i];
+        }
+        // 按逆后序复制, 操作数的定义总在使用之前复制
+        std::vector<IRBlock *> order=func->ReversePostOrder();
+        for(IRBlock *src: order)
+        {
+            IRBlock *copy=module.NewBlock(clone,src->name);
+            copy->unrolled=src->unrolled;
+            bmap[src]=copy;
+            for(IRValue *param: src->params)
+                vmap[param]=copy->AddParam(param->ty,param->name);
+        }
+        for(IRBlock *src: order)
+        {
+            for(IRInst *inst: src->insts)
+            {
+                IRInst *copy=module.CloneInst(inst,vmap,bmap);
+                vmap[inst]=copy;
+                bmap[src]->Append(copy);
+                if(copy->op==IR_CALL)
+                    calls[copy->callee].push_back(copy);
+            }
+        }
+        clone->ComputePreds();
+        return clone;
+    }
+
+    bool Specialize(IRFunction *func)
+    {
+        int size=func->InstCount();
+        if(size>kMaxSpecializeInsts)
+            return false;
+        // 按常量实参分组, 递归调用留给复制的函数处理
+        std::vector<std::pair<ArgSignature,std::vector<IRInst *>>> groups;
+        for(IRInst *call: calls[func])
+        {
+            if(call->block->parent==func)
+                continue;
+            ArgSignature sig;
+            for(int i=0;i<(int)func->params.size();++i)
+                if(IsConstArg(call->ops[i]) && Benefit(func->params[i],call->ops[i])>0)
+                    sig.push_back({i,call->ops[i]});
+            if(sig.empty())
+                continue;
+            auto it=std::find_if(groups.begin(),groups.end(),[&](const auto &g){ return SameSignature(g.first,sig); });
+            if(it==groups.end())
+                groups.push_back({sig,{call}});
+            else
+                it->second.push_back(call);
+        }
+        std::stable_sort(groups.begin(),groups.end(),
+                         [](const auto &a,const auto &b){ return a.second.size()>b.second.size(); });
+        if((int)groups.size()>kMaxSpecializations)
+            groups.resize(kMaxSpecializations);
+        bool changed=false;
+        for(auto &[sig,sites]: groups)
+        {
+            if(budget<size)
+                break;
+            budget-=size;
+            IRFunction *clone=Clone(func);
+            for(IRBlock *bb: clone->blocks)
+            {
+                for(IRInst *call: bb->insts)
+                {
+                    if(call->op!=IR_CALL || call->callee!=func)
+                        continue;
+                    bool same=true;
+                    for(auto &[i,v]: sig)
+                        same=same && (call->ops[i]==clone->params[i] || SameArg(call->ops[i],v));
+                    if(same)
+                        call->callee=clone;
+                }
+            }
+            Substitute(clone,sig);
+            for(IRInst *call: sites)
+                call->callee=clone;
+            changed=true;
+        }
+        return changed;
+    }
+
+    bool Run()
+    {
+        // 自顶向下: 调用者的形参替换为常数后, 它传给被调用者的实参也成为常数;
+        // SysY 的函数先定义后使用, 逆序处理时调用者 (包括它的复制) 总在被调用者之前
+        bool changed=false;
+        std::vector<IRFunction *> funcs(module.funcs.rbegin(),module.funcs.rend());
+        for(IRFunction *func: funcs)
+        {
+            if(func->IsDecl() || func->name=="@main" || calls[func].empty())
+                continue;
+            changed=PropagateUniform(func) || changed;
+            changed=Specialize(func) || changed;
+        }
+        return changed;
+    }
+};
+
+bool SpecializeFunctions(IRModule &module)
+{
+    Specializer spec(module);
+    return spec.Run();
+}
+
+// 形参只被原样传给自己时也是无用的
+static bool IsDeadParam(IRFunction *func,int i)
+{
+    IRValue *param=func->params[i];
+    for(IRInst *user: param->users)
+    {
+        if(user->op!=IR_CALL || user->callee!=func)
+            return false;
+        for(int j=0;j<(int)user->ops.size();++j)
+            if(user->ops[j]==param && j!=i)
+                return false;
+    }
+    return true;
+}
+
+// 删除第 i 个形参后, 摘要中的参数编号随之前移
+static void RemoveParamIndex(std::set<int> &params,int i)
+{
+    std::set<int> kept;
+    for(int j: params)
+        if(j!=i)
+            kept.insert(j>i?j-1:j);
+    params=kept;
+}
+
+bool RemoveDeadArgs(IRModule &module)
+{
+    std::map<IRFunction *,std::vector<IRInst *>> calls;
+    for(IRFunction *func: module.funcs)
+        for(IRBlock *bb: func->blocks)
+            for(IRInst *inst: bb->insts)
+                if(inst->op==IR_CALL)
+                    calls[inst->callee].push_back(inst);
+    bool changed=false;
+    for(IRFunction *func: module.funcs)
+    {
+        if(func->IsDecl() || func->name=="@main")
+            continue;
+        const std::vector<IRInst *> &sites=calls[func];
+        for(int i=(int)func->params.size()-1;i>=0;--i)
+        {
+            if(!IsDeadParam(func,i))
+                continue;
+            for(IRInst *call: sites)
+            {
+                std::vector<IRValue *> args=call->ops;
+                args.erase(args.begin()+i);
+                call->DropOperands();
+                for(IRValue *arg: args)
+                    call->AddOperand(arg);
+            }
+            func->params.erase(func->params.begin()+i);
+            func->param_tys.erase(func->param_tys.begin()+i);
+            if(!func->param_targets.empty())
+                func->param_targets.erase(func->param_targets.begin()+i);
+            RemoveParamIndex(func->modref.ref_params,i);
+            RemoveParamIndex(func->modref.mod_params,i);
+            changed=true;
+        }
+        for(int i=0;i<(int)func->params.size();++i)
+            func->params[i]->arg_index=i;
+
+        // 返回值在所有调用处都没有被使用
+        if(func->ret_ty->tag==IRT_UNIT)
+            continue;
+        bool used=false;
+        for(IRInst *call: sites)
+            used=used || !call->users.empty();
+        if(used)
+            continue;
+        func->ret_ty=IRType::Unit();
+        for(IRInst *call: sites)
+            call->ty=IRType::Unit();
+        for(IRBlock *bb: func->blocks)
+        {
+            IRInst *term=bb->Terminator();
+            if(term->op!=IR_RET)
+                continue;
+            term->EraseFromParent();
+            bb->Append(module.NewRet(nullptr));
+        }
+        changed=true;
+    }
+    return changed;
+}
@@ -0,0 +1,300 @@
+#include <cassert>
+#include <cstdint>
+#include <set>
+#include "loop.h"
+#include "opt.h"
+
+// 归纳变量强度削弱和线性函数测试替换
+// 基本归纳变量: header 的参数, 从前置块传入初值, 每条回边传入它加上同一个常数 (指针为 getptr 常数)
+// 导出归纳变量: 基本归纳变量乘常数, 以基本归纳变量为下标或基址 (另一个操作数不变) 的 getelemptr/getptr
+// 只削弱代价高的运算: 乘以非 2 的幂, 以及元素大小不是 2 的幂的地址计算, 其余的削弱后只会多出一个循环携带的值
+// 导出归纳变量改为 header 的新参数, 在前置块计算初值, 在每个回边的起点加上步长; 新参数本身也是基本归纳变量,
+// 所以二维数组的地址链可以逐层削弱, 内层循环中不再有乘法
+// Koopa IR 中指针不能比较, 所以测试替换只在整数上进行: 计数器只用于退出条件时, 改为比较它的常数倍
+
+struct IndVar
+{
+    IRValue *init;
+    int step;       // 整数为每次迭代加的值, 指针为每次 getptr 的下标
+};
+
+struct IVSR
+{
+    IRFunction *func;
+    Loop *loop;
+    IRBlock *pre;
+    IRModule *module;
+    std::map<IRValue *,IndVar> ivs;
+    // 由整数归纳变量乘常数得到的归纳变量: 新参数 -> (原参数, 倍数)
+    std::map<IRValue *,std::pair<IRValue *,int>> scaled;
+    std::set<IRInst *> increments;  // 回边上归纳变量的自增, 本身不再作为导出归纳变量
+    bool changed=false;
+
+    IVSR(IRFunction *func,Loop *loop,IRBlock *pre):func(func),loop(loop),pre(pre),module(func->module){}
+
+    bool IsInvariant(IRValue *v) const
+    {
+        if(v->kind!=IRV_INST && v->kind!=IRV_BLOCK_ARG)
+            return true;
+        return !loop->Contains(v->block);
+    }
+    // next 是否为 param 加上常数, 是则返回步长
+    static bool MatchStep(IRValue *param,IRValue *next,int &step)
+    {
+        if(!next->IsInst())
+            return false;
+        IRInst *inst=next->AsInst();
+        if(inst->op==IR_GETPTR && inst->ops[0]==param && inst->ops[1]->IsConst())
+        {
+            step=inst->ops[1]->const_val;
+            return true;
+        }
+        if(inst->op!=IR_BINARY)
+            return false;
+        IRValue *lhs=inst->ops[0],*rhs=inst->ops[1];
+        if(inst->bop==KOOPA_RBO_ADD && rhs==param)
+            std::swap(lhs,rhs);
+        if(lhs!=param || !rhs->IsConst())
+            return false;
+        if(inst->bop==KOOPA_RBO_ADD)
+            step=rhs->const_val;
+        else if(inst->bop==KOOPA_RBO_SUB)
+            step=-(unsigned)rhs->const_val;
+        else
+            return false;
+        return true;
+    }
+    void FindBasicIVs()
+    {
+        IRBlock *header=loop->header;
+        for(int i=0;i<(int)header->params.size();++i)
+        {
+            IRValue *param=header->params[i];
+            IRValue *init=nullptr;
+            bool ok=true,has_step=false;
+            int step=0;
+            for(IRBlock *pred: std::set<IRBlock *>(header->preds.begin(),header->preds.end()))
+            {
+                IRInst *term=pred->Terminator();
+                for(int s=0;s<(int)term->succs.size();++s)
+                {
+                    if(term->succs[s]!=header)
+                        continue;
+                    IRValue *arg=term->SuccArg(s,i);
+                    int st;
+                    if(pred==pre)
+                        init=arg;
+                    else if(!MatchStep(param,arg,st) || (has_step && st!=step))
+                        ok=false;
+                    else
+                    {
+                        step=st;
+                        has_step=true;
+                        increments.insert(arg->AsInst());
+                    }
+                }
+            }
+            if(ok && has_step && init!=nullptr)
+                ivs[param]={init,step};
+        }
+    }
+    bool IsIV(IRValue *v,IRTypeTag tag) const
+    {
+        return ivs.count(v) && v->ty->tag==tag;
+    }
+    static bool IsPowerOf2(long long x)
+    {
+        return x>0 && (x&(x-1))==0;
+    }
+    // inst 是否为导出归纳变量, 是则返回作为归纳变量的操作数位置和步长
+    bool MatchDerived(IRInst *inst,int &pos,int &step) const
+    {
+        if(inst->ops.size()!=2)
+            return false;
+        IRValue *lhs=inst->ops[0],*rhs=inst->ops[1];
+        switch (inst->op)
+        {
+        case IR_BINARY:
+            if(inst->bop==KOOPA_RBO_MUL)
+            {
+                pos=IsIV(lhs,IRT_INT32)?0:1;
+                IRValue *k=inst->ops[1-pos];
+                if(!IsIV(inst->ops[pos],IRT_INT32) || !k->IsConst() || IsPowerOf2(k->const_val))
+                    return false;
+                step=(unsigned)ivs.at(inst->ops[pos]).step*(unsigned)k->const_val;
+                return true;
+            }
+            return false;
+        case IR_GEP:
+        case IR_GETPTR:
+            if(IsInvariant(lhs) && IsIV(rhs,IRT_INT32))
+            {
+                // 元素大小是 2 的幂时后端用移位计算地址, 削弱反而多出一个循环携带的值
+                int elem_size=(inst->op==IR_GEP)?lhs->ty->base->base->Size():lhs->ty->base->Size();
+                if(IsPowerOf2(elem_size))
+                    return false;
+                pos=1;
+                step=ivs.at(rhs).step;
+                return true;
+            }
+            if(IsIV(lhs,IRT_POINTER) && IsInvariant(rhs))
+            {
+                pos=0;
+                step=ivs.at(lhs).step;
+                // getelemptr 得到元素指针, 基址每前进一个数组, 结果前进数组长度个元素
+                if(inst->op==IR_GEP)
+                    step=(unsigned)step*(unsigned)lhs->ty->base->len;
+                return true;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+    void Reduce(IRInst *inst,int pos,int step)
+    {
+        IRBlock *header=loop->header;
+        IRValue *base_iv=inst->ops[pos];
+        const IndVar &iv=ivs.at(base_iv);
+        // 初值: 在前置块中用基本归纳变量的初值计算
+        IRValue *init;
+        int folded;
+        if(inst->op==IR_BINARY && inst->ops[1-pos]->IsConst() && iv.init->IsConst())
+        {
+            bool ok=FoldBinary(inst->bop,pos==0?iv.init->const_val:inst->ops[0]->const_val,
+                               pos==0?inst->ops[1]->const_val:iv.init->const_val,folded);
+            assert(ok);
+            init=module->GetConst(folded);
+        }
+        else
+        {
+            IRInst *clone=module->CloneInst(inst,{{base_iv,iv.init}},{});
+            pre->InsertBeforeTerminator(clone);
+            init=clone;
+        }
+        std::string hint=base_iv->name.empty()?"%iv":base_iv->name+"_iv";
+        IRValue *param=header->AddParam(inst->ty,hint);
+        for(IRBlock *pred: std::set<IRBlock *>(header->preds.begin(),header->preds.end()))
+        {
+            IRValue *arg=init;
+            if(pred!=pre)
+            {
+                IRInst *next=(inst->ty->tag==IRT_POINTER)?module->NewGetPtr(param,module->GetConst(step)):
+                             module->NewBinary(KOOPA_RBO_ADD,param,module->GetConst(step));
+                pred->InsertBeforeTerminator(next);
+                increments.insert(next);
+                arg=next;
+            }
+            IRInst *term=pred->Terminator();
+            for(int s=0;s<(int)term->succs.size();++s)
+            {
+                if(term->succs[s]!=header)
+                    continue;
+                std::vector<IRValue *> args=term->SuccArgs(s);
+                args.push_back(arg);
+                term->SetSuccArgs(s,args);
+            }
+        }
+        if(inst->op==IR_BINARY)
+            scaled[param]={base_iv,inst->ops[1-pos]->const_val};
+        inst->ReplaceAllUsesWith(param);
+        inst->EraseFromParent();
+        ivs[param]={init,step};
+        changed=true;
+    }
+    void ReduceAll()
+    {
+        bool again=true;
+        while(again)
+        {
+            again=false;
+            for(IRBlock *bb: loop->blocks)
+            {
+                std::vector<IRInst *> insts=bb->insts;
+                for(IRInst *inst: insts)
+                {
+                    int pos,step;
+                    if(!increments.count(inst) && MatchDerived(inst,pos,step))
+                    {
+                        Reduce(inst,pos,step);
+                        again=true;
+                    }
+                }
+            }
+        }
+    }
+
+    // 线性函数测试替换: 计数器 i 除了自增只用于 i < n 时, 改为 i*k < n*k
+    // 要求初值和 n 都是常数, 并且整个取值范围乘 k 后不溢出, 保证比较结果不变
+    static bool FitsInt(long long v)
+    {
+        return v>=INT32_MIN && v<=INT32_MAX;
+    }
+    void ReplaceTests()
+    {
+        for(auto &entry: scaled)
+        {
+            IRValue *reduced=entry.first;
+            IRValue *counter=entry.second.first;
+            long long k=entry.second.second;
+            if(!ivs.count(counter) || k<=0)
+                continue;
+            const IndVar &iv=ivs.at(counter);
+            if(!iv.init->IsConst())
+                continue;
+            IRInst *test=nullptr;
+            bool only_test=true;
+            for(IRInst *user: counter->users)
+            {
+                int step;
+                if(MatchStep(counter,user,step))
+                {
+                    for(IRInst *next_user: user->users)
+                        only_test=only_test && next_user->op==IR_JUMP && loop->Contains(next_user->block);
+                    continue;
+                }
+                if(user->op==IR_BINARY && test==nullptr && user->ops[0]==counter && user->ops[1]->IsConst())
+                {
+                    test=user;
+                    continue;
+                }
+                only_test=false;
+            }
+            if(!only_test || test==nullptr)
+                continue;
+            long long n=test->ops[1]->const_val,step=iv.step,init=iv.init->const_val;
+            bool up=(test->bop==KOOPA_RBO_LT || test->bop==KOOPA_RBO_LE) && step>0;
+            bool down=(test->bop==KOOPA_RBO_GT || test->bop==KOOPA_RBO_GE) && step<0;
+            if(!up && !down)
+                continue;
+            if(!FitsInt(init*k) || !FitsInt(n*k) || !FitsInt((n+step)*k))
+                continue;
+            test->SetOperand(0,reduced);
+            test->SetOperand(1,module->GetConst(n*k));
+            changed=true;
+        }
+    }
+};
+
+bool ReduceInductionVariables(IRFunction *func)
+{
+    func->RemoveUnreachable();
+    func->EnsureEntryNoPreds();
+    DomTree dom(func);
+    LoopInfo loops(func,dom);
+    bool changed=false;
+    for(Loop *loop: loops.PostOrder())
+    {
+        IRBlock *pre=EnsurePreheader(func,loop);
+        IVSR ivsr(func,loop,pre);
+        ivsr.FindBasicIVs();
+        if(ivsr.ivs.empty())
+            continue;
+        ivsr.ReduceAll();
+        ivsr.ReplaceTests();
+        changed=changed || ivsr.changed;
+    }
+    if(changed)
+        SimplifyBlockParams(func);
+    return changed;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <cassert>
+#include "alias.h"
+#include "loop.h"
+#include "opt.h"
+
+// 循环不变量外提, 由内层循环到外层循环依次处理
+// 1. 操作数都在循环外定义的纯运算, 以及循环内没有可能别名的写入的 load, 移到前置块
+//    循环可能一次都不执行, 提前的 load 的地址必须一定有效: 常数下标没有越界, 或者 load 在循环的第一次迭代中一定执行
+// 2. 循环内只通过同一个不变地址读写的变量 (标量替换): 在前置块读入一个新的 alloc, 循环内改为读写这个 alloc,
+//    在每个出口写回原地址, 最后由 mem2reg 把新的 alloc 提升为基本块参数, 相当于把循环内的 store 下沉到出口
+//    同样要求地址一定有效, 或者循环内有一定执行的 store
+
+struct LICM
+{
+    IRFunction *func;
+    const AliasInfo &alias;
+    DomTree dom;
+    bool changed=false;
+    bool promoted=false;
+
+    LICM(IRFunction *func,const AliasInfo &alias):func(func),alias(alias),dom(func){}
+
+    static bool IsInvariant(Loop *loop,IRValue *v)
+    {
+        if(v->kind!=IRV_INST && v->kind!=IRV_BLOCK_ARG)
+            return true;
+        return !loop->Contains(v->block);
+    }
+    // 循环内可能修改 ptr 指向的内存的指令
+    static bool IsWrittenIn(Loop *loop,const AliasInfo &alias,IRValue *ptr)
+    {
+        for(IRBlock *bb: loop->blocks)
+        {
+            for(IRInst *inst: bb->insts)
+                if(alias.MayWrite(inst,ptr))
+                    return true;
+        }
+        return false;
+    }
+    // 进入循环时 header 的条件一定成立, 即至少执行一次循环体: 条件中的 header 参数换成前置块传入的值后为常数
+    static bool RunsOnce(Loop *loop,IRBlock *pre)
+    {
+        IRInst *br=loop->header->Terminator();
+        if(br->op!=IR_BRANCH || !loop->Contains(br->succs[0]) || loop->Contains(br->succs[1]) ||
+           !br->ops[0]->IsInst() || br->ops[0]->block!=loop->header || br->ops[0]->AsInst()->op!=IR_BINARY)
+            return false;
+        IRInst *cmp=br->ops[0]->AsInst();
+        IRInst *enter=pre->Terminator();
+        int vals[2];
+        for(int i=0;i<2;++i)
+        {
+            IRValue *v=cmp->ops[i];
+            if(v->kind==IRV_BLOCK_ARG && v->block==loop->header)
+                v=enter->SuccArg(0,v->arg_index);
+            if(!v->IsConst())
+                return false;
+            vals[i]=v->const_val;
+        }
+        switch (cmp->bop)
+        {
+        case KOOPA_RBO_NOT_EQ: return vals[0]!=vals[1];
+        case KOOPA_RBO_EQ: return vals[0]==vals[1];
+        case KOOPA_RBO_GT: return vals[0]>vals[1];
+        case KOOPA_RBO_LT: return vals[0]<vals[1];
+        case KOOPA_RBO_GE: return vals[0]>=vals[1];
+        case KOOPA_RBO_LE: return vals[0]<=vals[1];
+        default: return false;
+        }
+    }
+    // 进入循环后 bb 一定在回到 header 或离开循环之前执行; 循环内有调用时不判断, 调用可能不返回或者先有输出
+    bool Executes(Loop *loop,IRBlock *pre,IRBlock *bb)
+    {
+        bool once=RunsOnce(loop,pre);
+        for(IRBlock *b: loop->blocks)
+        {
+            for(IRInst *inst: b->insts)
+                if(inst->op==IR_CALL)
+                    return false;
+            bool exiting=b->Terminator()->op==IR_RET;
+            for(IRBlock *succ: b->Succs())
+                exiting=exiting || !loop->Contains(succ);
+            if(exiting && !(once && b==loop->header) && !dom.Dominates(bb,b))
+                return false;
+        }
+        for(IRBlock *latch: loop->latches)
+            if(!dom.Dominates(bb,latch))
+                return false;
+        return true;
+    }
+    bool CanHoist(Loop *loop,IRBlock *pre,IRInst *inst)
+    {
+        switch (inst->op)
+        {
+        case IR_BINARY:
+            // 提前执行的除法不能除以 0
+            if(inst->bop==KOOPA_RBO_DIV || inst->bop==KOOPA_RBO_MOD)
+                if(!inst->ops[1]->IsConst() || inst->ops[1]->IsConst(0) || inst->ops[1]->IsConst(-1))
+                    return false;
+            [[fallthrough]];
+        case IR_GEP:
+        case IR_GETPTR:
+            for(IRValue *op: inst->ops)
+                if(!IsInvariant(loop,op))
+                    return false;
+            return true;
+        case IR_LOAD:
+            return IsInvariant(loop,inst->ops[0]) && !IsWrittenIn(loop,alias,inst->ops[0]) &&
+                   (alias.SafeToSpeculate(inst->ops[0]) || Executes(loop,pre,inst->block));
+        default:
+            return false;
+        }
+    }
+    void Hoist(Loop *loop,IRBlock *pre)
+    {
+        bool again=true;
+        while(again)
+        {
+            again=false;
+            for(IRBlock *bb: loop->blocks)
+            {
+                std::vector<IRInst *> kept;
+                std::vector<IRInst *> insts=bb->insts;
+                for(IRInst *inst: insts)
+                {
+                    if(CanHoist(loop,pre,inst))
+                    {
+                        pre->InsertBeforeTerminator(inst);
+                        again=changed=true;
+                    }
+                    else
+                        kept.push_back(inst);
+                }
+                bb->insts=kept;
+            }
+        }
+    }
+    void Promote(Loop *loop,IRBlock *pre)
+    {
+        IRModule *module=func->module;
+        std::vector<IRInst *> mem_insts;
+        std::vector<IRValue *> candidates;
+        std::vector<IRInst *> calls;
+        for(IRBlock *bb: loop->blocks)
+        {
+            for(IRInst *inst: bb->insts)
+            {
+                if(inst->op==IR_LOAD || inst->op==IR_STORE)
+                    mem_insts.push_back(inst);
+                if(inst->op==IR_CALL)
+                    calls.push_back(inst);
+                if(inst->op!=IR_STORE)
+                    continue;
+                IRValue *dest=inst->ops[1];
+                if(dest->ty->base->tag==IRT_INT32 && IsInvariant(loop,dest) &&
+                   std::find(candidates.begin(),candidates.end(),dest)==candidates.end())
+                    candidates.push_back(dest);
+            }
+        }
+        std::vector<IRBlock *> exits=loop->ExitBlocks();
+        for(IRValue *ptr: candidates)
+        {
+            // 前置块中的 load 和出口的 store 在循环一次都不执行时也会执行
+            bool legal=alias.SafeToSpeculate(ptr);
+            for(IRInst *inst: mem_insts)
+                legal=legal || (inst->op==IR_STORE && inst->ops[1]==ptr && Executes(loop,pre,inst->block));
+            // 循环内的调用读写这个变量时, 它必须留在内存中
+            for(IRInst *call: calls)
+                legal=legal && !alias.MayWrite(call,ptr) && !alias.MayRead(call,ptr);
+            for(IRInst *inst: mem_insts)
+            {
+                IRValue *addr=(inst->op==IR_LOAD)?inst->ops[0]:inst->ops[1];
+                legal=legal && (addr==ptr || !alias.MayAlias(addr,ptr));
+            }
+            if(!legal)
+                continue;
+
+            IRInst *slot=module->NewAlloc(IRType::Int32());
+            slot->name="@licm";
+            func->Entry()->Insert(0,slot);
+            IRInst *init=module->NewLoad(ptr);
+            pre->InsertBeforeTerminator(init);
+            pre->InsertBeforeTerminator(module->NewStore(init,slot));
+            for(IRInst *inst: mem_insts)
+            {
+                int i=(inst->op==IR_LOAD)?0:1;
+                if(inst->ops[i]==ptr)
+                    inst->SetOperand(i,slot);
+            }
+            for(IRBlock *exit: exits)
+            {
+                IRInst *val=module->NewLoad(slot);
+                exit->Insert(0,val);
+                exit->Insert(1,module->NewStore(val,ptr));
+            }
+            promoted=changed=true;
+        }
+    }
+};
+
+bool HoistLoopInvariants(IRFunction *func)
+{
+    func->RemoveUnreachable();
+    func->EnsureEntryNoPreds();
+    DomTree dom(func);
+    LoopInfo loops(func,dom);
+    std::vector<Loop *> order=loops.PostOrder();
+    if(order.empty())
+        return false;
+    std::map<Loop *,IRBlock *> preheaders;
+    for(Loop *loop: order)
+    {
+        preheaders[loop]=EnsurePreheader(func,loop);
+        EnsureDedicatedExits(func,loop);
+    }
+    AliasInfo alias(func);
+    LICM licm(func,alias);
+    for(Loop *loop: order)
+    {
+        licm.Hoist(loop,preheaders[loop]);
+        licm.Promote(loop,preheaders[loop]);
+    }
+    if(licm.promoted)
+        PromoteMemoryToRegister(func);
+    return licm.changed;
+}
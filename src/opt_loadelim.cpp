@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cassert>
+#include "alias.h"
+#include "opt.h"
+
+// 冗余 load 消除和 store 到 load 的转发, 可以跨越汇合点 (GVN 只在扩展基本块内进行)
+// 对每个 load 沿控制流向上查找它读取的内存的最近定义, 相当于按需遍历 memory SSA:
+// 遇到地址相同的 store 取存入的值, 遇到地址相同的 load 取它的结果, 遇到可能写这块内存的指令 (由别名分析判断) 时失败
+// 只有一个前驱时在前驱中继续查找; 有多个前驱时分别查找, 全部找到时在汇合点加一个基本块参数 (memory phi) 接收各自的值,
+// 参数在查找前驱之前就加上, 沿回边回到汇合点时以它为值, 因此可以越过不写这块内存的循环; 各路径的值都相同时去掉参数
+// 地址相同指基址, 常数偏移和变量项都相同. 向上查找不能越过基址或变量项的定义, 否则同一个 SSA 值代表的是另一次迭代中的值
+
+static const int kMaxVisitedBlocks=64;  // 每个 load 最多查找的基本块数
+
+struct LoadElim
+{
+    IRFunction *func;
+    AliasInfo alias;
+    // 当前查找的地址
+    IRValue *ptr=nullptr;
+    PtrInfo info;
+    std::set<IRValue *> leaves;                 // 地址依赖的值: 基址和变量项
+    std::map<IRBlock *,IRValue *> at_entry;     // 基本块入口处的值, 找不到时为 nullptr
+    struct NewParam
+    {
+        IRBlock *bb;
+        IRValue *param;
+        bool has_args;      // 入边上已经加了实参
+        bool removed=false;
+    };
+    std::vector<NewParam> created;
+    int budget=0;
+
+    explicit LoadElim(IRFunction *func):func(func),alias(func){}
+
+    bool SameAddr(IRValue *q) const
+    {
+        if(q==ptr)
+            return true;
+        PtrInfo other=AnalyzePtr(q);
+        return other.base==info.base && other.offset==info.offset && other.terms==info.terms;
+    }
+
+    // 在 bb 的第 pos 条指令之前查找
+    IRValue *Find(IRBlock *bb,int pos)
+    {
+        for(int i=pos-1;i>=0;--i)
+        {
+            IRInst *inst=bb->insts[i];
+            if(leaves.count(inst))
+                return nullptr;
+            if(inst->op==IR_STORE && SameAddr(inst->ops[1]))
+                return inst->ops[0];
+            if(inst->op==IR_LOAD && SameAddr(inst->ops[0]))
+                return inst;
+            if(alias.MayWrite(inst,ptr))
+                return nullptr;
+        }
+        return AtEntry(bb);
+    }
+
+    IRValue *AtEntry(IRBlock *bb)
+    {
+        auto it=at_entry.find(bb);
+        if(it!=at_entry.end())
+            return it->second;
+        if(bb==func->Entry() || --budget<0)
+            return at_entry[bb]=nullptr;
+        for(IRValue *param: bb->params)
+            if(leaves.count(param))
+                return at_entry[bb]=nullptr;
+
+        std::vector<IRBlock *> preds=bb->preds;
+        std::sort(preds.begin(),preds.end());
+        preds.erase(std::unique(preds.begin(),preds.end()),preds.end());
+        if(preds.size()==1)
+            return at_entry[bb]=Find(preds[0],preds[0]->insts.size());
+
+        // 先放一个参数作为入口处的值, 沿回边回到这里时直接使用它
+        IRValue *param=bb->AddParam(IRType::Int32(),"%mem");
+        int index=created.size();
+        created.push_back({bb,param,false});
+        at_entry[bb]=param;
+        std::vector<IRValue *> vals;
+        IRValue *same=nullptr;
+        bool trivial=true;
+        for(IRBlock *pred: preds)
+        {
+            IRValue *v=Find(pred,pred->insts.size());
+            if(v==nullptr)
+                return at_entry[bb]=nullptr;
+            vals.push_back(v);
+            if(v!=param && v!=same)
+            {
+                trivial=trivial && same==nullptr;
+                same=v;
+            }
+        }
+        if(same==nullptr)
+            return at_entry[bb]=nullptr;
+        // 各路径上的值相同 (或者就是这个参数自己), 不需要参数
+        if(trivial)
+        {
+            param->ReplaceAllUsesWith(same);
+            for(auto &entry: at_entry)
+                if(entry.second==param)
+                    entry.second=same;
+            bb->RemoveParam(bb->params.size()-1);
+            created[index].removed=true;
+            return same;
+        }
+        for(int i=0;i<(int)preds.size();++i)
+        {
+            IRInst *term=preds[i]->Terminator();
+            for(int s=0;s<(int)term->succs.size();++s)
+            {
+                if(term->succs[s]!=bb)
+                    continue;
+                std::vector<IRValue *> args=term->SuccArgs(s);
+                args.push_back(vals[i]);
+                term->SetSuccArgs(s,args);
+            }
+        }
+        created[index].has_args=true;
+        return param;
+    }
+
+    // load 在 bb 中的第 pos 条指令, 返回它读到的已知值
+    IRValue *Query(IRBlock *bb,int pos)
+    {
+        IRInst *load=bb->insts[pos];
+        ptr=load->ops[0];
+        info=AnalyzePtr(ptr);
+        leaves.clear();
+        leaves.insert(info.base);
+        for(auto &[v,scale]: info.terms)
+            leaves.insert(v);
+        at_entry.clear();
+        created.clear();
+        budget=kMaxVisitedBlocks;
+        IRValue *res=Find(bb,pos);
+        if(res!=nullptr)
+            return res;
+        // 任何一处失败都会使整个查找失败, 删除加过的参数; 后加的参数可能使用先加的, 按相反的顺序删除
+        for(auto it=created.rbegin();it!=created.rend();++it)
+        {
+            if(it->removed)
+                continue;
+            IRBlock *param_bb=it->bb;
+            int i=std::find(param_bb->params.begin(),param_bb->params.end(),it->param)-param_bb->params.begin();
+            if(it->has_args)
+                RemoveBlockParam(param_bb,i);
+            else
+                param_bb->RemoveParam(i);
+        }
+        return nullptr;
+    }
+
+    bool Run()
+    {
+        bool changed=false;
+        for(IRBlock *bb: func->ReversePostOrder())
+        {
+            for(int i=0;i<(int)bb->insts.size();)
+            {
+                IRInst *inst=bb->insts[i];
+                IRValue *v=nullptr;
+                if(inst->op==IR_LOAD && inst->ty->tag==IRT_INT32)
+                    v=Query(bb,i);
+                if(v==nullptr)
+                {
+                    i++;
+                    continue;
+                }
+                inst->ReplaceAllUsesWith(v);
+                inst->EraseFromParent();
+                changed=true;
+            }
+        }
+        return changed;
+    }
+};
+
+bool EliminateRedundantLoads(IRFunction *func)
+{
+    func->RemoveUnreachable();
+    func->ComputePreds();
+    LoadElim elim(func);
+    return elim.Run();
+}
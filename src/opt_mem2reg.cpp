@@ -0,0 +1,240 @@
+#include <cassert>
+#include <set>
+#include "dom.h"
+#include "opt.h"
+
+// SSA 构造 (mem2reg): 把地址没有泄露的 i32 和指针局部变量提升为 SSA 值
+// 指针局部变量是前端存放数组参数的 alloc, 提升后数组访问的基址直接是参数, 别名分析可以识别
+// 在定义所在基本块的迭代支配边界上插入基本块参数, 再沿支配树重命名, 跳转时把变量的当前值作为实参传入
+
+// 只被直接 load/store 的 i32 或指针 alloc
+static bool IsPromotable(IRInst *alloc)
+{
+    if(alloc->op!=IR_ALLOC || (alloc->alloc_ty->tag!=IRT_INT32 && alloc->alloc_ty->tag!=IRT_POINTER))
+        return false;
+    for(IRInst *user: alloc->users)
+    {
+        if(user->op==IR_LOAD)
+            continue;
+        if(user->op==IR_STORE && user->ops[1]==alloc && user->ops[0]!=alloc)
+            continue;
+        return false;
+    }
+    return true;
+}
+
+struct Mem2Reg
+{
+    IRFunction *func;
+    const DomTree &dom;
+    std::map<IRInst *,int> index;                   // 被提升的 alloc 的编号
+    std::map<IRBlock *,std::vector<int>> placed;    // 每个基本块新增的参数依次对应的变量
+
+    Mem2Reg(IRFunction *func,const DomTree &dom):func(func),dom(dom){}
+
+    void Rename(IRBlock *bb,std::vector<IRValue *> cur)
+    {
+        const std::vector<int> &vars=placed[bb];
+        int first=bb->params.size()-vars.size();
+        for(int i=0;i<(int)vars.size();++i)
+            cur[vars[i]]=bb->params[first+i];
+
+        std::vector<IRInst *> kept;
+        for(IRInst *inst: bb->insts)
+        {
+            IRInst *slot=(inst->op==IR_LOAD)?inst->ops[0]->AsInst():
+                         (inst->op==IR_STORE)?inst->ops[1]->AsInst():nullptr;
+            auto it=(slot==nullptr)?index.end():index.find(slot);
+            if(it==index.end())
+            {
+                kept.push_back(inst);
+                continue;
+            }
+            if(inst->op==IR_LOAD)
+                inst->ReplaceAllUsesWith(cur[it->second]);
+            else
+                cur[it->second]=inst->ops[0];
+            inst->block=nullptr;
+            inst->DropOperands();
+        }
+        bb->insts=kept;
+
+        IRInst *term=bb->Terminator();
+        if(term!=nullptr)
+        {
+            for(int s=0;s<(int)term->succs.size();++s)
+            {
+                const std::vector<int> &succ_vars=placed[term->succs[s]];
+                if(succ_vars.empty())
+                    continue;
+                std::vector<IRValue *> args=term->SuccArgs(s);
+                for(int var: succ_vars)
+                    args.push_back(cur[var]);
+                term->SetSuccArgs(s,args);
+            }
+        }
+        for(IRBlock *child: dom.Children(bb))
+            Rename(child,cur);
+    }
+};
+
+bool PromoteMemoryToRegister(IRFunction *func)
+{
+    IRModule *module=func->module;
+    func->RemoveUnreachable();
+    std::vector<IRInst *> allocs;
+    for(IRBlock *bb: func->blocks)
+        for(IRInst *inst: bb->insts)
+            if(IsPromotable(inst))
+                allocs.push_back(inst);
+    if(allocs.empty())
+        return false;
+    // 入口基本块不能有参数
+    func->EnsureEntryNoPreds();
+    DomTree dom(func);
+    Mem2Reg m2r(func,dom);
+
+    for(int i=0;i<(int)allocs.size();++i)
+    {
+        IRInst *alloc=allocs[i];
+        m2r.index[alloc]=i;
+        std::set<IRBlock *> defs;
+        for(IRInst *user: alloc->users)
+            if(user->op==IR_STORE)
+                defs.insert(user->block);
+
+        std::string hint=alloc->name;
+        if(!hint.empty())
+            hint[0]='%';
+        std::vector<IRBlock *> worklist(defs.begin(),defs.end());
+        std::set<IRBlock *> has_param;
+        while(!worklist.empty())
+        {
+            IRBlock *bb=worklist.back();
+            worklist.pop_back();
+            for(IRBlock *df: dom.Frontier(bb))
+            {
+                if(!has_param.insert(df).second)
+                    continue;
+                df->AddParam(alloc->alloc_ty,hint);
+                m2r.placed[df].push_back(i);
+                if(!defs.count(df))
+                    worklist.push_back(df);
+            }
+        }
+    }
+
+    std::vector<IRValue *> init;
+    for(IRInst *alloc: allocs)
+        init.push_back(module->GetUndef(alloc->alloc_ty));
+    m2r.Rename(func->Entry(),init);
+    for(IRInst *alloc: allocs)
+    {
+        assert(alloc->users.empty());
+        alloc->EraseFromParent();
+    }
+    SimplifyBlockParams(func);
+    return true;
+}
+
+// 所有边传入 bb 第 i 个参数的实参
+static std::vector<IRValue *> IncomingArgs(IRBlock *bb,int i)
+{
+    std::vector<IRValue *> args;
+    for(IRBlock *pred: std::set<IRBlock *>(bb->preds.begin(),bb->preds.end()))
+    {
+        IRInst *term=pred->Terminator();
+        for(int s=0;s<(int)term->succs.size();++s)
+            if(term->succs[s]==bb)
+                args.push_back(term->SuccArg(s,i));
+    }
+    return args;
+}
+void RemoveBlockParam(IRBlock *bb,int i)
+{
+    for(IRBlock *pred: std::set<IRBlock *>(bb->preds.begin(),bb->preds.end()))
+    {
+        IRInst *term=pred->Terminator();
+        for(int s=0;s<(int)term->succs.size();++s)
+        {
+            if(term->succs[s]!=bb)
+                continue;
+            std::vector<IRValue *> args=term->SuccArgs(s);
+            args.erase(args.begin()+i);
+            term->SetSuccArgs(s,args);
+        }
+    }
+    bb->RemoveParam(i);
+}
+
+bool SimplifyBlockParams(IRFunction *func)
+{
+    bool changed=false;
+    func->ComputePreds();
+    // 所有入边传入同一个值 (或参数自身) 的参数可以用这个值代替
+    bool again=true;
+    while(again)
+    {
+        again=false;
+        for(IRBlock *bb: func->blocks)
+        {
+            for(int i=(int)bb->params.size()-1;i>=0;--i)
+            {
+                IRValue *param=bb->params[i];
+                IRValue *same=nullptr;
+                bool trivial=true;
+                for(IRValue *arg: IncomingArgs(bb,i))
+                {
+                    if(arg==param || arg==same)
+                        continue;
+                    if(same!=nullptr)
+                    {
+                        trivial=false;
+                        break;
+                    }
+                    same=arg;
+                }
+                if(!trivial || same==nullptr)
+                    continue;
+                RemoveBlockParam(bb,i);
+                param->ReplaceAllUsesWith(same);
+                again=changed=true;
+            }
+        }
+    }
+
+    // 只作为实参传给其他无用参数的参数也是无用的
+    std::set<IRValue *> live;
+    std::vector<IRValue *> worklist;
+    for(IRBlock *bb: func->blocks)
+    {
+        for(IRValue *param: bb->params)
+        {
+            for(IRInst *user: param->users)
+            {
+                bool only_arg=(user->op==IR_JUMP) || (user->op==IR_BRANCH && user->ops[0]!=param);
+                if(!only_arg && live.insert(param).second)
+                    worklist.push_back(param);
+            }
+        }
+    }
+    while(!worklist.empty())
+    {
+        IRValue *param=worklist.back();
+        worklist.pop_back();
+        for(IRValue *arg: IncomingArgs(param->block,param->arg_index))
+            if(arg->kind==IRV_BLOCK_ARG && live.insert(arg).second)
+                worklist.push_back(arg);
+    }
+    for(IRBlock *bb: func->blocks)
+    {
+        for(int i=(int)bb->params.size()-1;i>=0;--i)
+        {
+            if(live.count(bb->params[i]))
+                continue;
+            RemoveBlockParam(bb,i);
+            changed=true;
+        }
+    }
+    return changed;
+}
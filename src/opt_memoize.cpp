@@ -0,0 +1,179 @@
+#include "opt.h"
+
+// 自动记忆化 (-fauto-memoize): 参数都是整数的纯自递归函数, 同样的参数总是得到同样的结果,
+// 给它加一张全局的直接映射缓存表 [[i32, 参数个数+2], kMemoSlots], 每项依次为各个参数, 结果, 有效标志
+// 新的入口按参数的散列值找到表项, 参数全部相同时直接返回记录的结果, 否则执行原来的函数体,
+// 每个 ret 改为跳到统一的出口, 在那里写入表项后返回. 冲突时新结果覆盖旧结果, 比较了全部参数, 不会取错
+// 只处理递归调用多 (有两处以上, 或在循环中) 并且递归调用的实参都是参数加减小常数或常数的函数,
+// 这类函数 (如朴素的 Fibonacci 和组合数) 实参范围小而重复调用多, 其余函数查表的开销得不偿失
+
+static const int kMemoSlots=1024;   // 缓存表的项数, 2 的幂
+static const int kMaxMemoArgs=3;
+static const int kMaxArgStep=16;    // 递归调用的实参与参数相差的常数的上限
+static const int kHashMul=31;
+
+struct Memoizer
+{
+    IRFunction *func;
+    IRModule *module;
+
+    explicit Memoizer(IRFunction *func):func(func),module(func->module){}
+
+    // 实参只在参数附近变化: 常数, 参数 (或尾递归消除后的循环变量), 以及它们加减小常数
+    static bool IsNarrowArg(IRValue *v)
+    {
+        if(v->kind==IRV_CONST || v->kind==IRV_FUNC_ARG || v->kind==IRV_BLOCK_ARG)
+            return true;
+        if(v->kind!=IRV_INST)
+            return false;
+        IRInst *inst=v->AsInst();
+        if(inst->op!=IR_BINARY || (inst->bop!=KOOPA_RBO_ADD && inst->bop!=KOOPA_RBO_SUB))
+            return false;
+        IRValue *c=inst->ops[1],*x=inst->ops[0];
+        if(!c->IsConst())
+            std::swap(c,x);
+        return c->IsConst() && c->const_val>=-kMaxArgStep && c->const_val<=kMaxArgStep &&
+               (x->kind==IRV_FUNC_ARG || x->kind==IRV_BLOCK_ARG);
+    }
+
+    bool Profitable()
+    {
+        if(func->IsDecl() || func->name=="@main" || !func->modref.IsPure() || func->ret_ty->tag!=IRT_INT32)
+            return false;
+        if(func->params.empty() || (int)func->params.size()>kMaxMemoArgs)
+            return false;
+        for(IRValue *param: func->params)
+            if(param->ty->tag!=IRT_INT32)
+                return false;
+        int self_calls=0;
+        for(IRBlock *bb: func->blocks)
+        {
+            for(IRInst *inst: bb->insts)
+            {
+                if(inst->op!=IR_CALL || inst->callee!=func)
+                    continue;
+                self_calls++;
+                for(IRValue *arg: inst->ops)
+                    if(!IsNarrowArg(arg))
+                        return false;
+            }
+        }
+        return self_calls>=2 || (self_calls==1 && func->HasLoop());
+    }
+
+    IRGlobal *NewTable()
+    {
+        std::string base="@_memo_"+func->name.substr(1),name=base;
+        for(int i=0;;++i)
+        {
+            bool used=module->FindFunction(name)!=nullptr;
+            for(IRGlobal *global: module->globals)
+                used=used || global->name==name;
+            if(!used)
+                break;
+            name=base+"_"+std::to_string(i);
+        }
+        int nargs=func->params.size();
+        return module->NewGlobal(IRType::Array(IRType::Array(IRType::Int32(),nargs+2),kMemoSlots),name);
+    }
+
+    void Run()
+    {
+        int nargs=func->params.size();
+        IRGlobal *table=NewTable();
+        std::vector<IRBlock *> body=func->blocks;
+        IRBlock *old_entry=func->Entry();
+        // 后端的标号在整个模块中不能重复, 名字带上函数名
+        std::string suffix="_"+func->name.substr(1);
+        IRBlock *entry=module->NewBlock(func,"%_memo_entry"+suffix);
+        IRBlock *hit=module->NewBlock(func,"%_memo_hit"+suffix);
+        IRBlock *save=module->NewBlock(func,"%_memo_save"+suffix);
+        IRValue *result=save->AddParam(IRType::Int32(),"memo_ret");
+        func->blocks.pop_back();
+        func->blocks.pop_back();
+        func->blocks.pop_back();
+        func->blocks.insert(func->blocks.begin(),entry);
+        func->blocks.push_back(hit);
+        func->blocks.push_back(save);
+
+        // alloc 留在入口基本块中
+        std::vector<IRInst *> rest;
+        for(IRInst *inst: old_entry->insts)
+        {
+            if(inst->op==IR_ALLOC)
+                entry->Append(inst);
+            else
+                rest.push_back(inst);
+        }
+        old_entry->insts=rest;
+        for(IRBlock *bb: body)
+        {
+            IRInst *term=bb->Terminator();
+            if(term->op!=IR_RET)
+                continue;
+            IRValue *v=term->ops[0];
+            term->EraseFromParent();
+            bb->Append(module->NewJump(save,{v}));
+        }
+
+        // 入口: 散列, 取表项, 比较有效标志和全部参数
+        IRValue *hash=func->params[0];
+        for(int i=1;i<nargs;++i)
+        {
+            IRInst *mul=module->NewBinary(KOOPA_RBO_MUL,hash,module->GetConst(kHashMul));
+            IRInst *add=module->NewBinary(KOOPA_RBO_ADD,mul,func->params[i]);
+            entry->Append(mul);
+            entry->Append(add);
+            hash=add;
+        }
+        IRInst *index=module->NewBinary(KOOPA_RBO_AND,hash,module->GetConst(kMemoSlots-1));
+        IRInst *slot=module->NewGep(table,index);
+        entry->Append(index);
+        entry->Append(slot);
+        auto field=[&](IRBlock *bb,int j)
+        {
+            IRInst *ptr=module->NewGep(slot,module->GetConst(j));
+            bb->Append(ptr);
+            return ptr;
+        };
+        IRInst *valid=module->NewLoad(field(entry,nargs+1));
+        entry->Append(valid);
+        IRValue *cond=valid;
+        for(int i=0;i<nargs;++i)
+        {
+            IRInst *key=module->NewLoad(field(entry,i));
+            IRInst *eq=module->NewBinary(KOOPA_RBO_EQ,key,func->params[i]);
+            IRInst *both=module->NewBinary(KOOPA_RBO_AND,cond,eq);
+            entry->Append(key);
+            entry->Append(eq);
+            entry->Append(both);
+            cond=both;
+        }
+        entry->Append(module->NewBranch(cond,hit,{},old_entry,{}));
+
+        IRInst *cached=module->NewLoad(field(hit,nargs));
+        hit->Append(cached);
+        hit->Append(module->NewRet(cached));
+
+        for(int i=0;i<nargs;++i)
+            save->Append(module->NewStore(func->params[i],field(save,i)));
+        save->Append(module->NewStore(result,field(save,nargs)));
+        save->Append(module->NewStore(module->GetConst(1),field(save,nargs+1)));
+        save->Append(module->NewRet(result));
+        func->ComputePreds();
+    }
+};
+
+bool MemoizeRecursion(IRModule &module)
+{
+    bool changed=false;
+    for(IRFunction *func: module.funcs)
+    {
+        Memoizer memo(func);
+        if(!memo.Profitable())
+            continue;
+        memo.Run();
+        changed=true;
+    }
+    return changed;
+}
@@ -0,0 +1,232 @@
+#include <cassert>
+#include <set>
+#include "opt.h"
+
+// 稀疏条件常量传播 (Wegman-Zadeck)
+// 值的格: 未知 (TOP) > 常数 > 非常数 (BOTTOM), 只沿可执行的边传播
+// 基本块参数的值为所有可执行入边上实参的交汇; 条件为常数的 br 只有一条边可执行
+
+enum LatticeKind
+{
+    LAT_TOP,
+    LAT_CONST,
+    LAT_BOTTOM
+};
+struct Lattice
+{
+    LatticeKind kind=LAT_TOP;
+    int val=0;
+
+    bool operator==(const Lattice &other) const { return kind==other.kind && (kind!=LAT_CONST || val==other.val); }
+    bool operator!=(const Lattice &other) const { return !(*this==other); }
+};
+static Lattice Meet(const Lattice &a,const Lattice &b)
+{
+    if(a.kind==LAT_TOP)
+        return b;
+    if(b.kind==LAT_TOP)
+        return a;
+    if(a==b)
+        return a;
+    return {LAT_BOTTOM,0};
+}
+
+struct SCCP
+{
+    IRFunction *func;
+    std::map<IRValue *,Lattice> lat;
+    std::set<IRBlock *> exec_bbs;
+    std::set<std::pair<IRBlock *,int>> exec_edges;  // 前驱和它的第几个跳转目标
+    std::vector<std::pair<IRBlock *,int>> edge_worklist;
+    std::vector<IRValue *> value_worklist;
+
+    explicit SCCP(IRFunction *func):func(func){}
+
+    Lattice Get(IRValue *v)
+    {
+        switch (v->kind)
+        {
+        case IRV_CONST:
+            return {LAT_CONST,v->const_val};
+        case IRV_UNDEF:
+            return {LAT_TOP,0};
+        case IRV_INST:
+        case IRV_BLOCK_ARG:
+            return lat[v];
+        default:
+            return {LAT_BOTTOM,0};
+        }
+    }
+    void Update(IRValue *v,const Lattice &l)
+    {
+        Lattice &old=lat[v];
+        if(old==l)
+            return;
+        assert(old.kind<=l.kind);
+        old=l;
+        value_worklist.push_back(v);
+    }
+    void MarkEdge(IRBlock *bb,int s)
+    {
+        if(exec_edges.insert({bb,s}).second)
+            edge_worklist.push_back({bb,s});
+    }
+    // 重新计算 bb 的参数
+    void VisitParams(IRBlock *bb)
+    {
+        std::vector<Lattice> vals(bb->params.size());
+        for(IRBlock *pred: std::set<IRBlock *>(bb->preds.begin(),bb->preds.end()))
+        {
+            IRInst *term=pred->Terminator();
+            for(int s=0;s<(int)term->succs.size();++s)
+            {
+                if(term->succs[s]!=bb || !exec_edges.count({pred,s}))
+                    continue;
+                for(int i=0;i<(int)vals.size();++i)
+                    vals[i]=Meet(vals[i],Get(term->SuccArg(s,i)));
+            }
+        }
+        for(int i=0;i<(int)vals.size();++i)
+            Update(bb->params[i],vals[i]);
+    }
+    void VisitInst(IRInst *inst)
+    {
+        switch (inst->op)
+        {
+        case IR_BINARY:
+        {
+            Lattice lhs=Get(inst->ops[0]),rhs=Get(inst->ops[1]);
+            Lattice res{LAT_BOTTOM,0};
+            // x*0 与 x&0 不论 x 是什么都为 0
+            bool zero=(inst->bop==KOOPA_RBO_MUL || inst->bop==KOOPA_RBO_AND) &&
+                      ((lhs.kind==LAT_CONST && lhs.val==0) || (rhs.kind==LAT_CONST && rhs.val==0));
+            if(zero)
+                res={LAT_CONST,0};
+            else if(lhs.kind==LAT_TOP || rhs.kind==LAT_TOP)
+                res={LAT_TOP,0};
+            else if(lhs.kind==LAT_CONST && rhs.kind==LAT_CONST && FoldBinary(inst->bop,lhs.val,rhs.val,res.val))
+                res.kind=LAT_CONST;
+            Update(inst,res);
+            break;
+        }
+        case IR_BRANCH:
+        {
+            Lattice cond=Get(inst->ops[0]);
+            if(cond.kind==LAT_CONST)
+                MarkEdge(inst->block,cond.val!=0?0:1);
+            else if(cond.kind==LAT_BOTTOM)
+            {
+                MarkEdge(inst->block,0);
+                MarkEdge(inst->block,1);
+            }
+            break;
+        }
+        case IR_JUMP:
+            MarkEdge(inst->block,0);
+            break;
+        case IR_RET:
+        case IR_STORE:
+            break;
+        default:
+            // load, call, alloc, 地址计算
+            if(inst->ty->tag!=IRT_UNIT)
+                Update(inst,{LAT_BOTTOM,0});
+            break;
+        }
+    }
+    void Run()
+    {
+        func->ComputePreds();
+        IRBlock *entry=func->Entry();
+        exec_bbs.insert(entry);
+        for(IRInst *inst: entry->insts)
+            VisitInst(inst);
+        while(!edge_worklist.empty() || !value_worklist.empty())
+        {
+            while(!edge_worklist.empty())
+            {
+                auto edge=edge_worklist.back();
+                edge_worklist.pop_back();
+                IRBlock *succ=edge.first->Terminator()->succs[edge.second];
+                VisitParams(succ);
+                if(exec_bbs.insert(succ).second)
+                    for(IRInst *inst: succ->insts)
+                        VisitInst(inst);
+            }
+            while(!value_worklist.empty())
+            {
+                IRValue *v=value_worklist.back();
+                value_worklist.pop_back();
+                for(IRInst *user: v->users)
+                {
+                    if(!exec_bbs.count(user->block))
+                        continue;
+                    VisitInst(user);
+                    if(user->op==IR_JUMP || user->op==IR_BRANCH)
+                        for(IRBlock *succ: user->succs)
+                            VisitParams(succ);
+                }
+            }
+        }
+    }
+    bool Rewrite()
+    {
+        bool changed=false;
+        IRModule *module=func->module;
+        for(IRBlock *bb: func->blocks)
+        {
+            if(!exec_bbs.count(bb))
+                continue;
+            for(IRValue *param: bb->params)
+            {
+                Lattice l=Get(param);
+                if(l.kind==LAT_CONST && !param->users.empty())
+                {
+                    param->ReplaceAllUsesWith(module->GetConst(l.val));
+                    changed=true;
+                }
+            }
+            std::vector<IRInst *> dead;
+            for(IRInst *inst: bb->insts)
+            {
+                Lattice l=Get(inst);
+                if(inst->op==IR_BINARY && l.kind==LAT_CONST)
+                {
+                    inst->ReplaceAllUsesWith(module->GetConst(l.val));
+                    dead.push_back(inst);
+                }
+            }
+            for(IRInst *inst: dead)
+                inst->EraseFromParent();
+            changed=changed || !dead.empty();
+
+            // 只有一条边可执行的 br 改为 jump
+            IRInst *term=bb->Terminator();
+            if(term!=nullptr && term->op==IR_BRANCH)
+            {
+                bool t=exec_edges.count({bb,0}),f=exec_edges.count({bb,1});
+                if(t!=f)
+                {
+                    int s=t?0:1;
+                    IRInst *jump=module->NewJump(term->succs[s],term->SuccArgs(s));
+                    term->EraseFromParent();
+                    bb->Append(jump);
+                    changed=true;
+                }
+            }
+        }
+        if(func->RemoveUnreachable())
+            changed=true;
+        return changed;
+    }
+};
+
+bool SparseCondConstProp(IRFunction *func)
+{
+    SCCP sccp(func);
+    sccp.Run();
+    bool changed=sccp.Rewrite();
+    if(changed)
+        SimplifyBlockParams(func);
+    return changed;
+}
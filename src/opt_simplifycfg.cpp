@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <set>
+#include "opt.h"
+
+// 控制流图化简, 反复进行以下变换直到没有改动:
+// 1. 条件为常数, 或两个目标及实参都相同的 br 改为 jump
+// 2. 没有参数、只有一条 jump 的基本块: 把它的前驱直接连到 jump 的目标上
+// 3. 以 jump 结尾的基本块和它唯一的后继 (该后继只有这一条入边) 合并
+
+static bool FoldBranch(IRFunction *func,IRBlock *bb)
+{
+    IRInst *term=bb->Terminator();
+    if(term->op!=IR_BRANCH)
+        return false;
+    int s;
+    if(term->ops[0]->IsConst())
+        s=term->ops[0]->const_val!=0?0:1;
+    else if(term->succs[0]==term->succs[1] && term->SuccArgs(0)==term->SuccArgs(1))
+        s=0;
+    else
+        return false;
+    IRInst *jump=func->module->NewJump(term->succs[s],term->SuccArgs(s));
+    term->EraseFromParent();
+    bb->Append(jump);
+    return true;
+}
+
+static bool SkipForwarder(IRFunction *func,IRBlock *bb)
+{
+    if(bb==func->Entry() || !bb->params.empty() || bb->insts.size()!=1)
+        return false;
+    IRInst *jump=bb->Terminator();
+    if(jump->op!=IR_JUMP || jump->succs[0]==bb)
+        return false;
+    // 实参来自支配 bb 的定义, 在 bb 的各个前驱末尾同样可用
+    IRBlock *target=jump->succs[0];
+    std::vector<IRValue *> args=jump->SuccArgs(0);
+    bool changed=false;
+    for(IRBlock *pred: std::set<IRBlock *>(bb->preds.begin(),bb->preds.end()))
+    {
+        IRInst *term=pred->Terminator();
+        for(int s=0;s<(int)term->succs.size();++s)
+        {
+            if(term->succs[s]!=bb)
+                continue;
+            term->succs[s]=target;
+            term->SetSuccArgs(s,args);
+            changed=true;
+        }
+    }
+    return changed;
+}
+
+static bool MergeIntoPred(IRFunction *func,IRBlock *bb)
+{
+    IRInst *jump=bb->Terminator();
+    if(jump->op!=IR_JUMP)
+        return false;
+    IRBlock *succ=jump->succs[0];
+    if(succ==bb || succ==func->Entry() || succ->preds.size()!=1)
+        return false;
+    std::vector<IRValue *> args=jump->SuccArgs(0);
+    jump->EraseFromParent();
+    for(int i=0;i<(int)succ->params.size();++i)
+        succ->params[i]->ReplaceAllUsesWith(args[i]);
+    succ->params.clear();
+    for(IRInst *inst: succ->insts)
+        bb->Append(inst);
+    succ->insts.clear();
+    auto &blocks=func->blocks;
+    blocks.erase(std::find(blocks.begin(),blocks.end(),succ));
+    return true;
+}
+
+bool SimplifyCFG(IRFunction *func)
+{
+    bool changed=false;
+    bool again=true;
+    func->RemoveUnreachable();
+    while(again)
+    {
+        again=false;
+        func->ComputePreds();
+        for(int i=0;i<(int)func->blocks.size();++i)
+        {
+            IRBlock *bb=func->blocks[i];
+            // 前驱在每次改动之后重新计算
+            bool modified=FoldBranch(func,bb);
+            modified=SkipForwarder(func,bb) || modified;
+            if(modified)
+                func->ComputePreds();
+            while(MergeIntoPred(func,bb))
+            {
+                func->ComputePreds();
+                modified=true;
+            }
+            again=again || modified;
+        }
+        if(func->RemoveUnreachable())
+            again=true;
+        changed=changed || again;
+    }
+    return changed;
+}
@@ -0,0 +1,88 @@
+#include <cassert>
+#include <string>
+#include "alias.h"
+#include "opt.h"
+
+// 标量替换 (SROA): 把只用常数下标访问的小局部数组拆成每个元素一个 i32 alloc, 之后由 mem2reg 提升为 SSA 值
+// 数组的地址只能经过 getelemptr/getptr 得到元素地址, 再被 load/store 直接使用; 传给函数, 存入内存或作为基本块参数时
+// 地址逃逸, 不能拆开. 下标为变量但没有被用来访问内存的地址计算 (例如被删空的初始化循环) 不影响, 与数组一起删除
+// 只为实际访问到的元素建立 alloc; 有越界的常数下标时不拆
+
+static const int kMaxElements=32;   // 拆开的数组的元素数上限
+
+// 数组 alloc 的所有访问都是常数下标的 i32 load/store 时, 返回这些访问以及它们的字节偏移
+static bool CollectAccesses(IRInst *alloc,std::vector<std::pair<IRInst *,int>> &accesses,
+                            std::vector<IRInst *> &addrs)
+{
+    int size=alloc->alloc_ty->Size();
+    std::vector<IRValue *> worklist{alloc};
+    while(!worklist.empty())
+    {
+        IRValue *v=worklist.back();
+        worklist.pop_back();
+        for(IRInst *user: v->users)
+        {
+            if((user->op==IR_GEP || user->op==IR_GETPTR) && user->ops[0]==v)
+            {
+                addrs.push_back(user);
+                worklist.push_back(user);
+                continue;
+            }
+            bool load=user->op==IR_LOAD;
+            bool store=user->op==IR_STORE && user->ops[1]==v && user->ops[0]!=v;
+            if(!load && !store)
+                return false;
+            PtrInfo info=AnalyzePtr(v);
+            if(v->ty->base->tag!=IRT_INT32 || !info.terms.empty() || info.offset<0 || info.offset>=size ||
+               info.offset%4!=0)
+                return false;
+            accesses.push_back({user,info.offset});
+        }
+    }
+    return true;
+}
+
+bool ScalarReplaceArrays(IRFunction *func)
+{
+    IRModule *module=func->module;
+    bool changed=false;
+    for(IRBlock *bb: func->blocks)
+    {
+        for(int i=0;i<(int)bb->insts.size();++i)
+        {
+            IRInst *alloc=bb->insts[i];
+            if(alloc->op!=IR_ALLOC || alloc->alloc_ty->tag!=IRT_ARRAY || alloc->alloc_ty->Size()>kMaxElements*4)
+                continue;
+            std::vector<std::pair<IRInst *,int>> accesses;
+            std::vector<IRInst *> addrs;
+            if(!CollectAccesses(alloc,accesses,addrs))
+                continue;
+
+            // 每个访问到的元素一个 alloc, 放在原来数组的位置
+            std::map<int,IRInst *> scalars;
+            for(auto &[inst,offset]: accesses)
+            {
+                IRInst *&scalar=scalars[offset];
+                if(scalar==nullptr)
+                {
+                    scalar=module->NewAlloc(IRType::Int32());
+                    if(!alloc->name.empty())
+                        scalar->name=alloc->name+"_"+std::to_string(offset/4);
+                    bb->Insert(i++,scalar);
+                }
+                inst->SetOperand(inst->op==IR_LOAD?0:1,scalar);
+            }
+            // 地址计算都已不再被使用, 后计算的先删除
+            for(auto it=addrs.rbegin();it!=addrs.rend();++it)
+            {
+                assert((*it)->users.empty());
+                (*it)->EraseFromParent();
+            }
+            assert(alloc->users.empty());
+            alloc->EraseFromParent();
+            --i;
+            changed=true;
+        }
+    }
+    return changed;
+}
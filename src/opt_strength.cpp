@@ -0,0 +1,112 @@
+#include <cassert>
+#include "const_arith.h"
+#include "opt.h"
+
+// 把 ArithPlan 翻译为 Koopa 指令, 插入到 pos 之前, 返回结果
+static IRValue *EmitPlan(IRModule *module,const ArithPlan &plan,IRValue *x,IRBlock *bb,int &pos)
+{
+    std::vector<IRValue *> vals{x};
+    for(const ArithStep &step: plan.steps)
+    {
+        IRValue *lhs=vals[step.lhs],*rhs=vals[step.rhs];
+        IRValue *imm=module->GetConst(step.imm);
+        IRValue *res=nullptr;
+        switch (step.op)
+        {
+        case AS_LI:
+            res=imm;
+            break;
+        case AS_SLLI:
+            res=module->NewBinary(KOOPA_RBO_SHL,lhs,imm);
+            break;
+        case AS_SRLI:
+            res=module->NewBinary(KOOPA_RBO_SHR,lhs,imm);
+            break;
+        case AS_SRAI:
+            res=module->NewBinary(KOOPA_RBO_SAR,lhs,imm);
+            break;
+        case AS_ADD:
+            res=module->NewBinary(KOOPA_RBO_ADD,lhs,rhs);
+            break;
+        case AS_SUB:
+            res=module->NewBinary(KOOPA_RBO_SUB,lhs,rhs);
+            break;
+        case AS_ADDI:
+            res=module->NewBinary(KOOPA_RBO_ADD,lhs,imm);
+            break;
+        case AS_ANDI:
+            res=module->NewBinary(KOOPA_RBO_AND,lhs,imm);
+            break;
+        case AS_NEG:
+            res=module->NewBinary(KOOPA_RBO_SUB,module->GetConst(0),lhs);
+            break;
+        case AS_MULI:
+            res=module->NewBinary(KOOPA_RBO_MUL,lhs,imm);
+            break;
+        case AS_MULHI:
+            // Koopa IR 没有取高位的乘法
+            assert(false);
+        }
+        if(res->IsInst())
+            bb->Insert(pos++,res->AsInst());
+        vals.push_back(res);
+    }
+    return vals[plan.Result()];
+}
+
+// 计算展开后需要的指令数 (AS_LI 不产生指令)
+static int PlanInsts(const ArithPlan &plan)
+{
+    int cnt=0;
+    for(const ArithStep &step: plan.steps)
+        if(step.op!=AS_LI)
+            cnt++;
+    return cnt;
+}
+
+bool StrengthReduce(IRFunction *func,int max_insts)
+{
+    bool changed=false;
+    IRModule *module=func->module;
+    for(IRBlock *bb: func->blocks)
+    {
+        for(int i=0;i<(int)bb->insts.size();++i)
+        {
+            IRInst *inst=bb->insts[i];
+            if(inst->op!=IR_BINARY)
+                continue;
+            IRValue *lhs=inst->ops[0],*rhs=inst->ops[1];
+            if(lhs->IsConst() && rhs->IsConst())
+                continue;
+            ArithPlan plan;
+            IRValue *x=lhs;
+            bool ok=false;
+            switch (inst->bop)
+            {
+            case KOOPA_RBO_MUL:
+                if(lhs->IsConst())
+                    std::swap(lhs,rhs);
+                x=lhs;
+                ok=rhs->IsConst() && PlanMulConst(rhs->const_val,max_insts,plan);
+                break;
+            case KOOPA_RBO_DIV:
+                ok=rhs->IsConst() && PlanDivConst(rhs->const_val,false,plan);
+                break;
+            case KOOPA_RBO_MOD:
+                ok=rhs->IsConst() && PlanModConst(rhs->const_val,false,plan);
+                break;
+            default:
+                break;
+            }
+            if(!ok || PlanInsts(plan)>max_insts)
+                continue;
+            int pos=i;
+            IRValue *res=EmitPlan(module,plan,x,bb,pos);
+            inst->ReplaceAllUsesWith(res);
+            inst->EraseFromParent();
+            i=pos-1;
+            changed=true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,229 @@
+#include <cassert>
+#include <set>
+#include "opt.h"
+
+// 尾递归消除: 把对自身的尾调用改为跳回函数开头的循环
+// 前端把每个参数存入入口处的 alloc, 循环的下一次迭代只需把新的实参写入这些 alloc
+// 形如 return f(...) op x 的递归, 当 op 满足结合律和交换律时, 用一个累加器记录尚未完成的运算
+
+struct TailSite
+{
+    IRInst *call;
+    IRInst *acc_op;     // 调用结果参与的运算, 没有时为空
+    IRValue *operand;   // 运算的另一个操作数
+};
+
+static bool IsAccumulatorOp(koopa_raw_binary_op_t op)
+{
+    return op==KOOPA_RBO_ADD || op==KOOPA_RBO_MUL || op==KOOPA_RBO_AND ||
+           op==KOOPA_RBO_OR || op==KOOPA_RBO_XOR;
+}
+static int Identity(koopa_raw_binary_op_t op)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_MUL:
+        return 1;
+    case KOOPA_RBO_AND:
+        return -1;
+    default:
+        return 0;
+    }
+}
+// 只通过 load/store 直接访问的 alloc, 地址没有泄露, 被调用者不会修改它
+static bool IsLocalSlot(IRValue *v)
+{
+    IRInst *alloc=v->AsInst();
+    if(alloc==nullptr || alloc->op!=IR_ALLOC)
+        return false;
+    for(IRInst *user: alloc->users)
+    {
+        if(user->op==IR_LOAD)
+            continue;
+        if(user->op==IR_STORE && user->ops[1]==alloc && user->ops[0]!=alloc)
+            continue;
+        return false;
+    }
+    return true;
+}
+// 指针是否可能指向本函数的栈帧, 这样的实参在下一次迭代中会被覆盖
+static bool PointsToFrame(IRValue *v)
+{
+    if(v->ty->tag!=IRT_POINTER)
+        return false;
+    if(v->kind==IRV_FUNC_ARG || v->kind==IRV_GLOBAL)
+        return false;
+    IRInst *inst=v->AsInst();
+    if(inst==nullptr)
+        return true;
+    switch (inst->op)
+    {
+    case IR_GEP:
+    case IR_GETPTR:
+        return PointsToFrame(inst->ops[0]);
+    case IR_LOAD:
+    {
+        // 前端把指针参数存入 alloc 后再读出
+        if(!IsLocalSlot(inst->ops[0]))
+            return true;
+        for(IRInst *user: inst->ops[0]->users)
+            if(user->op==IR_STORE && PointsToFrame(user->ops[0]))
+                return true;
+        return false;
+    }
+    default:
+        return true;
+    }
+}
+static bool IsSelfCall(IRInst *inst,IRFunction *func)
+{
+    if(inst->op!=IR_CALL || inst->callee!=func)
+        return false;
+    for(IRValue *arg: inst->ops)
+        if(PointsToFrame(arg))
+            return false;
+    return true;
+}
+// 位于调用和返回之间的指令可以留在原处: 没有副作用, 且不读取被调用者可能修改的内存
+static bool CanSkip(IRInst *inst)
+{
+    if(inst->op==IR_LOAD)
+        return IsLocalSlot(inst->ops[0]);
+    return inst->op==IR_BINARY || inst->op==IR_GEP || inst->op==IR_GETPTR;
+}
+// bb 是否以尾递归结尾
+static bool MatchTailSite(IRBlock *bb,IRFunction *func,TailSite &site)
+{
+    IRInst *ret=bb->Terminator();
+    int n=bb->insts.size();
+    if(ret==nullptr || ret->op!=IR_RET || n<2)
+        return false;
+    // %r = call @f(...); ret %r 或者 call @f(...); ret
+    IRInst *prev=bb->insts[n-2];
+    if(IsSelfCall(prev,func))
+    {
+        site={prev,nullptr,nullptr};
+        if(ret->ops.empty())
+            return prev->users.empty();
+        return ret->ops[0]==prev && prev->users.size()==1;
+    }
+    // %r = call @f(...); ...; %s = op %r, %e; ret %s
+    if(ret->ops.empty() || prev->op!=IR_BINARY || !IsAccumulatorOp(prev->bop) || ret->ops[0]!=prev)
+        return false;
+    if(prev->users.size()!=1)
+        return false;
+    for(int i=n-3;i>=0;--i)
+    {
+        IRInst *inst=bb->insts[i];
+        if(IsSelfCall(inst,func))
+        {
+            if(inst->users.size()!=1 || inst->users[0]!=prev)
+                return false;
+            IRValue *operand=(prev->ops[0]==inst)?prev->ops[1]:prev->ops[0];
+            site={inst,prev,operand};
+            return true;
+        }
+        if(!CanSkip(inst))
+            return false;
+    }
+    return false;
+}
+
+bool EliminateTailRecursion(IRFunction *func)
+{
+    IRModule *module=func->module;
+    IRBlock *entry=func->Entry();
+    // 每个参数只被存入入口处的一个 alloc
+    std::vector<IRInst *> param_stores;
+    for(IRValue *param: func->params)
+    {
+        if(param->users.size()!=1)
+            return false;
+        IRInst *store=param->users[0];
+        if(store->op!=IR_STORE || store->ops[0]!=param || store->block!=entry || !IsLocalSlot(store->ops[1]))
+            return false;
+        param_stores.push_back(store);
+    }
+
+    std::vector<TailSite> sites;
+    std::set<IRBlock *> site_bbs;
+    bool has_acc=false;
+    koopa_raw_binary_op_t acc_bop=KOOPA_RBO_ADD;
+    for(IRBlock *bb: func->blocks)
+    {
+        TailSite site;
+        if(!MatchTailSite(bb,func,site))
+            continue;
+        if(site.acc_op!=nullptr)
+        {
+            if(has_acc && site.acc_op->bop!=acc_bop)
+                continue;
+            has_acc=true;
+            acc_bop=site.acc_op->bop;
+        }
+        sites.push_back(site);
+        site_bbs.insert(bb);
+    }
+    if(sites.empty())
+        return false;
+
+    // 入口只保留 alloc 和参数的 store, 其余指令移入循环头
+    IRBlock *header=module->NewBlock(func,entry->name+"_tailrec");
+    func->blocks.pop_back();
+    func->blocks.insert(func->blocks.begin()+1,header);
+    std::set<IRInst *> kept(param_stores.begin(),param_stores.end());
+    std::vector<IRInst *> rest;
+    for(IRInst *inst: entry->insts)
+    {
+        if(inst->op==IR_ALLOC || kept.count(inst))
+            rest.push_back(inst);
+        else
+            header->Append(inst);
+    }
+    entry->insts=rest;
+
+    IRInst *acc=nullptr;
+    if(has_acc)
+    {
+        acc=module->NewAlloc(IRType::Int32());
+        acc->name="%acc";
+        entry->Insert(0,acc);
+        entry->Append(module->NewStore(module->GetConst(Identity(acc_bop)),acc));
+        // 其他返回处补上累加器中尚未完成的运算
+        for(IRBlock *bb: func->blocks)
+        {
+            IRInst *ret=bb->Terminator();
+            if(ret==nullptr || ret->op!=IR_RET || site_bbs.count(bb))
+                continue;
+            IRInst *val=module->NewLoad(acc);
+            IRInst *res=module->NewBinary(acc_bop,val,ret->ops[0]);
+            bb->InsertBeforeTerminator(val);
+            bb->InsertBeforeTerminator(res);
+            ret->SetOperand(0,res);
+        }
+    }
+    entry->Append(module->NewJump(header));
+
+    for(const TailSite &site: sites)
+    {
+        IRBlock *bb=site.call->block;
+        std::vector<IRValue *> args=site.call->ops;
+        bb->Terminator()->EraseFromParent();
+        if(site.acc_op!=nullptr)
+        {
+            site.acc_op->EraseFromParent();
+            IRInst *val=module->NewLoad(acc);
+            IRInst *res=module->NewBinary(acc_bop,val,site.operand);
+            bb->Append(val);
+            bb->Append(res);
+            bb->Append(module->NewStore(res,acc));
+        }
+        site.call->EraseFromParent();
+        // 实参都已经求值, 可以直接覆盖参数所在的 alloc
+        for(int i=0;i<(int)args.size();++i)
+            bb->Append(module->NewStore(args[i],param_stores[i]->ops[1]));
+        bb->Append(module->NewJump(header));
+    }
+    func->ComputePreds();
+    return true;
+}
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdio>
+#include "loop.h"
+#include "opt.h"
+
+// 循环展开, 只处理前端 while 循环的形式: header 计算条件并用 br 退出, 循环体只有一条回边, 不从其他地方退出
+// 退出条件为 i op n, 其中 i 是 header 的参数, 每次迭代加常数, n 在循环外定义
+// 1. 完全展开: 初值和 n 都是常数时模拟出迭代次数, 次数较少时把循环体复制这么多份串起来, 最后进入原循环,
+//    原循环的条件在最后一次判断时为假, 由之后的常量传播删除
+// 2. 部分展开: 新建一个每次执行 k 次迭代的主循环, 主循环的条件保证这 k 次迭代都不会退出, 所以其中不再判断;
+//    主循环退出后进入原循环执行剩余的不足 k 次迭代; 这两个循环之后不再展开, 包括内联到调用者中以后
+// 3. 运行时展开: n 不是常数时同样生成主循环, 在前置块计算主循环的条件; 调整后的边界可能溢出时直接进入原循环
+
+static const int kFullUnrollInsts=128;      // 完全展开后的指令数上限
+static const int kMaxFullTripCount=32;
+static const int kUnrolledBodyInsts=64;     // 部分展开后主循环体的指令数上限
+static const int kMaxUnrollFactor=8;
+static const int kGrowthBudget=512;         // 每个函数因展开增加的指令数上限
+static const int kSimulateLimit=1<<16;      // 模拟迭代次数的上限
+static const int kArgRegs=8;
+
+static bool IsCompare(koopa_raw_binary_op_t op)
+{
+    return op==KOOPA_RBO_EQ || op==KOOPA_RBO_NOT_EQ || op==KOOPA_RBO_GT || op==KOOPA_RBO_LT ||
+           op==KOOPA_RBO_GE || op==KOOPA_RBO_LE;
+}
+// 结果取反的比较
+static koopa_raw_binary_op_t InvertedCompare(koopa_raw_binary_op_t op)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_EQ:
+        return KOOPA_RBO_NOT_EQ;
+    case KOOPA_RBO_NOT_EQ:
+        return KOOPA_RBO_EQ;
+    case KOOPA_RBO_GT:
+        return KOOPA_RBO_LE;
+    case KOOPA_RBO_LT:
+        return KOOPA_RBO_GE;
+    case KOOPA_RBO_GE:
+        return KOOPA_RBO_LT;
+    default:
+        return KOOPA_RBO_GT;
+    }
+}
+// 交换操作数后等价的比较
+static koopa_raw_binary_op_t SwappedCompare(koopa_raw_binary_op_t op)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_GT:
+        return KOOPA_RBO_LT;
+    case KOOPA_RBO_LT:
+        return KOOPA_RBO_GT;
+    case KOOPA_RBO_GE:
+        return KOOPA_RBO_LE;
+    case KOOPA_RBO_LE:
+        return KOOPA_RBO_GE;
+    default:
+        return op;
+    }
+}
+
+struct Unroller
+{
+    IRFunction *func;
+    Loop *loop;
+    IRBlock *pre;
+    IRModule *module;
+    IRBlock *latch=nullptr;
+    int body_succ=0;            // header 的 br 中留在循环内的目标
+    int iv_index=-1;            // 作为计数器的 header 参数
+    IRValue *init=nullptr,*bound=nullptr;
+    int step=0;
+    koopa_raw_binary_op_t op=KOOPA_RBO_LT;  // 继续循环的条件: iv op bound
+    int size=0;
+    int values=0;               // 循环内定义的值的个数
+    int insert_pos=0;           // 新建的基本块放在循环之后
+
+    Unroller(IRFunction *func,Loop *loop,IRBlock *pre):func(func),loop(loop),pre(pre),module(func->module){}
+
+    bool IsInvariant(IRValue *v) const
+    {
+        if(v->kind!=IRV_INST && v->kind!=IRV_BLOCK_ARG)
+            return true;
+        return !loop->Contains(v->block);
+    }
+    // 识别循环的形式和退出条件
+    bool Analyze()
+    {
+        IRBlock *header=loop->header;
+        if(!loop->children.empty() || loop->latches.size()!=1 || header->unrolled)
+            return false;
+        latch=loop->latches[0];
+        if(latch==header || latch->Terminator()->op!=IR_JUMP)
+            return false;
+        // 含有调用的循环开销主要在调用上, 展开只会增加代码
+        for(IRBlock *bb: loop->blocks)
+        {
+            size+=bb->insts.size();
+            values+=bb->params.size();
+            for(IRInst *inst: bb->insts)
+            {
+                if(inst->op==IR_CALL)
+                    return false;
+                values+=(inst->ty->tag!=IRT_UNIT);
+            }
+            if(bb==header)
+                continue;
+            for(IRBlock *succ: bb->Succs())
+                if(!loop->Contains(succ))
+                    return false;
+        }
+        IRInst *br=header->Terminator();
+        if(br->op!=IR_BRANCH || br->succs[0]==br->succs[1])
+            return false;
+        body_succ=loop->Contains(br->succs[0])?0:1;
+        if(!loop->Contains(br->succs[body_succ]) || loop->Contains(br->succs[1-body_succ]) ||
+           br->succs[body_succ]==header)
+            return false;
+
+        if(!br->ops[0]->IsInst())
+            return false;
+        IRInst *cmp=br->ops[0]->AsInst();
+        if(cmp->block!=header || cmp->op!=IR_BINARY || !IsCompare(cmp->bop))
+            return false;
+        op=body_succ==0?cmp->bop:InvertedCompare(cmp->bop);
+        IRValue *iv=cmp->ops[0];
+        bound=cmp->ops[1];
+        if(iv->kind!=IRV_BLOCK_ARG || iv->block!=header)
+        {
+            std::swap(iv,bound);
+            op=SwappedCompare(op);
+        }
+        if(iv->kind!=IRV_BLOCK_ARG || iv->block!=header || !IsInvariant(bound))
+            return false;
+        iv_index=iv->arg_index;
+        init=pre->Terminator()->SuccArg(0,iv_index);
+        // 回边传入 iv 加减常数
+        IRValue *next=latch->Terminator()->SuccArg(0,iv_index);
+        if(!next->IsInst() || next->AsInst()->op!=IR_BINARY)
+            return false;
+        IRInst *inc=next->AsInst();
+        if(inc->ops[0]!=iv || !inc->ops[1]->IsConst())
+            return false;
+        if(inc->bop==KOOPA_RBO_ADD)
+            step=inc->ops[1]->const_val;
+        else if(inc->bop==KOOPA_RBO_SUB && inc->ops[1]->const_val!=INT_MIN)
+            step=-inc->ops[1]->const_val;
+        else
+            return false;
+        return step!=0;
+    }
+    // 初值和边界都是常数时按 32 位回绕的语义模拟, 得到迭代次数, 超过上限时返回 -1
+    int ConstTripCount() const
+    {
+        if(!init->IsConst() || !bound->IsConst())
+            return -1;
+        int v=init->const_val,cond;
+        for(int count=0;count<=kSimulateLimit;++count)
+        {
+            FoldBinary(op,v,bound->const_val,cond);
+            if(!cond)
+                return count;
+            FoldBinary(KOOPA_RBO_ADD,v,step,v);
+        }
+        return -1;
+    }
+    // 主循环的条件: iv 再前进 k-1 次仍满足退出条件, 只对单调逼近边界的比较成立
+    bool CanRunUnroll() const
+    {
+        bool up=(op==KOOPA_RBO_LT || op==KOOPA_RBO_LE) && step>0;
+        bool down=(op==KOOPA_RBO_GT || op==KOOPA_RBO_GE) && step<0;
+        long long abs_step=step>0?step:-(long long)step;
+        return (up || down) && abs_step*kMaxUnrollFactor<=INT_MAX/2;
+    }
+
+    IRBlock *NewBlock(const std::string &suffix)
+    {
+        IRBlock *bb=module->NewBlock(func,loop->header->name+suffix);
+        func->blocks.pop_back();
+        func->blocks.insert(func->blocks.begin()+insert_pos++,bb);
+        return bb;
+    }
+    // 复制一次迭代, header 的参数取 args; header 的 br 改为直接进入循环体
+    // 返回复制的 header, back_jump 为复制的回边跳转, 仍跳到原 header
+    IRBlock *CloneIteration(const std::vector<IRValue *> &args,IRInst *&back_jump)
+    {
+        IRBlock *header=loop->header;
+        std::map<IRValue *,IRValue *> vmap;
+        std::map<IRBlock *,IRBlock *> bmap;
+        for(int i=0;i<(int)header->params.size();++i)
+            vmap[header->params[i]]=args[i];
+        for(IRBlock *bb: loop->blocks)
+        {
+            IRBlock *copy=NewBlock("_unroll");
+            bmap[bb]=copy;
+            if(bb==header)
+                continue;
+            for(IRValue *param: bb->params)
+                vmap[param]=copy->AddParam(param->ty,param->name);
+        }
+        // 按逆后序复制, 操作数的定义总在使用之前复制
+        for(IRBlock *bb: loop->blocks)
+        {
+            for(IRInst *inst: bb->insts)
+            {
+                IRInst *clone=module->CloneInst(inst,vmap,bmap);
+                vmap[inst]=clone;
+                bmap[bb]->Append(clone);
+            }
+        }
+        IRBlock *copy=bmap[header];
+        IRInst *br=copy->Terminator();
+        IRInst *jump=module->NewJump(br->succs[body_succ],br->SuccArgs(body_succ));
+        br->EraseFromParent();
+        copy->Append(jump);
+        // 回边按映射表会跳到复制的 header, 改回原 header
+        back_jump=bmap[latch]->Terminator();
+        back_jump->succs[0]=header;
+        return copy;
+    }
+    // 复制 k 次迭代串起来, 从 from 以 args 进入; 最后一次迭代的回边跳转留给调用者处理
+    IRInst *CloneChain(IRBlock *from,const std::vector<IRValue *> &args,int k)
+    {
+        IRInst *back_jump=nullptr;
+        std::vector<IRValue *> cur=args;
+        for(int t=0;t<k;++t)
+        {
+            IRInst *prev=back_jump;
+            IRBlock *copy=CloneIteration(cur,back_jump);
+            if(t==0)
+                from->Append(module->NewJump(copy));
+            else
+            {
+                IRBlock *bb=prev->block;
+                prev->EraseFromParent();
+                bb->Append(module->NewJump(copy));
+            }
+            cur=back_jump->SuccArgs(0);
+        }
+        return back_jump;
+    }
+
+    // 完全展开: 前置块依次进入 trip 份循环体, 最后进入原 header
+    void FullUnroll(int trip)
+    {
+        IRInst *jump=pre->Terminator();
+        std::vector<IRValue *> args=jump->SuccArgs(0);
+        jump->EraseFromParent();
+        CloneChain(pre,args,trip);
+    }
+    // 部分展开: 前置块进入主循环 (运行时边界可能溢出时进入原循环), 主循环不满足条件时进入原循环
+    void PartialUnroll(int k)
+    {
+        IRBlock *header=loop->header;
+        IRBlock *main_header=NewBlock("_unrolled");
+        header->unrolled=main_header->unrolled=true;
+        std::vector<IRValue *> params;
+        for(IRValue *param: header->params)
+            params.push_back(main_header->AddParam(param->ty,param->name));
+        // 主循环条件 iv op bound-(k-1)*step, 调整后的边界不溢出时与 k 次迭代都满足原条件等价
+        long long delta=(long long)(k-1)*step;
+        IRValue *main_bound;
+        IRValue *ok=nullptr;
+        if(bound->IsConst())
+        {
+            long long b=(long long)bound->const_val-delta;
+            assert(b>=INT_MIN && b<=INT_MAX);
+            main_bound=module->GetConst(b);
+        }
+        else
+        {
+            IRInst *sub=module->NewBinary(KOOPA_RBO_SUB,bound,module->GetConst(delta));
+            pre->InsertBeforeTerminator(sub);
+            main_bound=sub;
+            IRInst *check=step>0?module->NewBinary(KOOPA_RBO_GE,bound,module->GetConst(INT_MIN+delta)):
+                                 module->NewBinary(KOOPA_RBO_LE,bound,module->GetConst(INT_MAX+delta));
+            pre->InsertBeforeTerminator(check);
+            ok=check;
+        }
+        IRInst *jump=pre->Terminator();
+        std::vector<IRValue *> args=jump->SuccArgs(0);
+        jump->EraseFromParent();
+        if(ok!=nullptr)
+            pre->Append(module->NewBranch(ok,main_header,args,header,args));
+        else
+            pre->Append(module->NewJump(main_header,args));
+
+        IRInst *cond=module->NewBinary(op,params[iv_index],main_bound);
+        main_header->Append(cond);
+        IRBlock *entry=NewBlock("_unrolled_body");
+        main_header->Append(module->NewBranch(cond,entry,{},header,params));
+        IRInst *back_jump=CloneChain(entry,params,k);
+        back_jump->succs[0]=main_header;
+    }
+    bool FitsBound(int k) const
+    {
+        if(!bound->IsConst())
+            return true;
+        long long b=(long long)bound->const_val-(long long)(k-1)*step;
+        return b>=INT_MIN && b<=INT_MAX;
+    }
+
+    // 选择展开方式并执行, 返回增加的指令数, 没有展开时返回 0
+    // 叶函数的循环内的值大部分能放进 max_values 个寄存器时, 部分展开后也不能超过
+    int Run(int budget,int max_values,bool report)
+    {
+        int last=0;
+        for(IRBlock *bb: loop->blocks)
+            last=std::max(last,(int)(std::find(func->blocks.begin(),func->blocks.end(),bb)-func->blocks.begin()));
+        insert_pos=last+1;
+        int trip=ConstTripCount();
+        if(trip==0)
+            return 0;
+        if(trip>0 && trip<=kMaxFullTripCount && trip*size<=std::min(kFullUnrollInsts,budget))
+        {
+            FullUnroll(trip);
+            if(report)
+                fprintf(stderr,"%s: 完全展开循环 %s, %d 次迭代\n",func->name.c_str(),loop->header->name.c_str(),trip);
+            return trip*size;
+        }
+        if(!CanRunUnroll())
+            return 0;
+        int k=kMaxUnrollFactor;
+        while(k>1 && (k*size>kUnrolledBodyInsts || (k+1)*size>budget || (trip>0 && k>trip) || !FitsBound(k) ||
+                     (values<=2*max_values && k*values>max_values)))
+            k/=2;
+        if(k<2)
+            return 0;
+        PartialUnroll(k);
+        if(report)
+            fprintf(stderr,"%s: %s循环 %s, 展开 %d 次\n",func->name.c_str(),trip>0?"部分展开":"运行时展开",
+                    loop->header->name.c_str(),k);
+        return (k+1)*size;
+    }
+};
+
+bool UnrollLoops(IRFunction *func,const OptOptions &opts)
+{
+    func->RemoveUnreachable();
+    func->EnsureEntryNoPreds();
+    DomTree dom(func);
+    LoopInfo loops(func,dom);
+    std::vector<Loop *> order=loops.PostOrder();
+    if(order.empty())
+        return false;
+    std::map<Loop *,IRBlock *> preheaders;
+    for(Loop *loop: order)
+        preheaders[loop]=EnsurePreheader(func,loop);
+    // 只展开最内层循环, 它们互不相交, 展开一个循环不影响其他循环的分析结果
+    int budget=kGrowthBudget;
+    // RISCV 后端把叶函数中的值放在空闲的 a 寄存器里, 展开后放不下的值改为放在栈上, 得不偿失
+    int max_values=INT_MAX;
+    bool leaf=true;
+    for(IRBlock *bb: func->blocks)
+        for(IRInst *inst: bb->insts)
+            leaf=leaf && inst->op!=IR_CALL;
+    if(opts.for_riscv && leaf)
+        max_values=std::max(kArgRegs-(int)func->params.size(),0);
+    bool changed=false;
+    for(Loop *loop: order)
+    {
+        Unroller unroller(func,loop,preheaders[loop]);
+        if(!unroller.Analyze())
+            continue;
+        int growth=unroller.Run(budget,max_values,opts.report);
+        budget-=growth;
+        changed=changed || growth>0;
+    }
+    if(changed)
+        func->ComputePreds();
+    return changed;
+}
@@ -7,8 +7,11 @@
 #include <sstream>
 #include<vector>
 #include <map>
+#include <set>
+#include <algorithm>
 #include "koopa.h"
 #include "riscv.h"
+#include "const_arith.h"
 
 
 static const std::string regs_name[REG_NUM+1]=
@@ -33,15 +36,131 @@ static std::map<koopa_raw_binary_op_t, std::string> op_names =
     {KOOPA_RBO_DIV, "div"},
     {KOOPA_RBO_MOD, "rem"},
     {KOOPA_RBO_AND, "and"},
-    {KOOPA_RBO_OR, "or"}
+    {KOOPA_RBO_OR, "or"},
+    {KOOPA_RBO_XOR, "xor"},
+    {KOOPA_RBO_SHL, "sll"},
+    {KOOPA_RBO_SHR, "srl"},
+    {KOOPA_RBO_SAR, "sra"}
 };
 
+// 指令选择模式表
+// 每条模式描述一棵以二元运算为根的 Koopa 值树: 根的运算符, 两个叶子的形式, 以及对应的 RISCV 指令
+// 模式按表中顺序 (即代价从低到高) 匹配, 第一条匹配成功的模式生效, 都不匹配时退回通用的寄存器形式
+enum OperandForm
+{
+    FORM_REG,       // 任意值, 放入寄存器
+    FORM_ZERO,      // 整数 0
+    FORM_IMM12,     // 整数 c, c 可以编码为 12 位立即数
+    FORM_IMM12_NEG, // 整数 c, -c 可以编码为 12 位立即数
+    FORM_IMM12_INC, // 整数 c, c+1 可以编码为 12 位立即数
+    FORM_SHAMT      // 整数 c, 0 <= c < 32
+};
+enum PostOp
+{
+    POST_NONE,
+    POST_NOT,   // xori rd, rd, 1
+    POST_SEQZ,  // seqz rd, rd
+    POST_SNEZ   // snez rd, rd
+};
+// rd = inst rs[, imm_sign*c+imm_bias]; post rd
+struct BinaryPattern
+{
+    koopa_raw_binary_op_t op;
+    OperandForm lhs;
+    OperandForm rhs;
+    const char *inst;
+    int imm_sign;
+    int imm_bias;
+    PostOp post;
+};
+// br (op lhs, rhs), true, false => inst lhs[, rhs], true
+struct BranchPattern
+{
+    koopa_raw_binary_op_t op;
+    OperandForm lhs;
+    OperandForm rhs;
+    const char *inst;
+};
+
+static constexpr BinaryPattern binary_patterns[] =
+{
+    {KOOPA_RBO_SUB,    FORM_ZERO, FORM_REG,       "neg",  0,  0, POST_NONE},
+    {KOOPA_RBO_EQ,     FORM_REG,  FORM_ZERO,      "seqz", 0,  0, POST_NONE},
+    {KOOPA_RBO_NOT_EQ, FORM_REG,  FORM_ZERO,      "snez", 0,  0, POST_NONE},
+    {KOOPA_RBO_ADD,    FORM_REG,  FORM_IMM12,     "addi", 1,  0, POST_NONE},
+    {KOOPA_RBO_SUB,    FORM_REG,  FORM_IMM12_NEG, "addi", -1, 0, POST_NONE},
+    {KOOPA_RBO_AND,    FORM_REG,  FORM_IMM12,     "andi", 1,  0, POST_NONE},
+    {KOOPA_RBO_OR,     FORM_REG,  FORM_IMM12,     "ori",  1,  0, POST_NONE},
+    {KOOPA_RBO_XOR,    FORM_REG,  FORM_IMM12,     "xori", 1,  0, POST_NONE},
+    {KOOPA_RBO_LT,     FORM_REG,  FORM_IMM12,     "slti", 1,  0, POST_NONE},
+    {KOOPA_RBO_LE,     FORM_REG,  FORM_IMM12_INC, "slti", 1,  1, POST_NONE},
+    {KOOPA_RBO_GE,     FORM_REG,  FORM_IMM12,     "slti", 1,  0, POST_NOT},
+    {KOOPA_RBO_GT,     FORM_REG,  FORM_IMM12_INC, "slti", 1,  1, POST_NOT},
+    {KOOPA_RBO_EQ,     FORM_REG,  FORM_IMM12,     "xori", 1,  0, POST_SEQZ},
+    {KOOPA_RBO_NOT_EQ, FORM_REG,  FORM_IMM12,     "xori", 1,  0, POST_SNEZ},
+    {KOOPA_RBO_SHL,    FORM_REG,  FORM_SHAMT,     "slli", 1,  0, POST_NONE},
+    {KOOPA_RBO_SHR,    FORM_REG,  FORM_SHAMT,     "srli", 1,  0, POST_NONE},
+    {KOOPA_RBO_SAR,    FORM_REG,  FORM_SHAMT,     "srai", 1,  0, POST_NONE}
+};
+
+static constexpr BranchPattern branch_patterns[] =
+{
+    {KOOPA_RBO_EQ,     FORM_REG, FORM_ZERO, "beqz"},
+    {KOOPA_RBO_NOT_EQ, FORM_REG, FORM_ZERO, "bnez"},
+    {KOOPA_RBO_LT,     FORM_REG, FORM_ZERO, "bltz"},
+    {KOOPA_RBO_GT,     FORM_REG, FORM_ZERO, "bgtz"},
+    {KOOPA_RBO_LE,     FORM_REG, FORM_ZERO, "blez"},
+    {KOOPA_RBO_GE,     FORM_REG, FORM_ZERO, "bgez"},
+    {KOOPA_RBO_EQ,     FORM_REG, FORM_REG,  "beq"},
+    {KOOPA_RBO_NOT_EQ, FORM_REG, FORM_REG,  "bne"},
+    {KOOPA_RBO_LT,     FORM_REG, FORM_REG,  "blt"},
+    {KOOPA_RBO_GT,     FORM_REG, FORM_REG,  "bgt"},
+    {KOOPA_RBO_LE,     FORM_REG, FORM_REG,  "ble"},
+    {KOOPA_RBO_GE,     FORM_REG, FORM_REG,  "bge"}
+};
+
+// 编译期为模式表建立按运算符分组的索引 (稳定的计数排序, 组内保持表中的优先级顺序)
+#define BINARY_OP_NUM (KOOPA_RBO_SAR+1)
+template<size_t N>
+struct PatternIndex
+{
+    int begin[BINARY_OP_NUM+1];
+    int order[N];
+};
+template<typename Pattern,size_t N>
+static constexpr PatternIndex<N> BuildPatternIndex(const Pattern (&table)[N])
+{
+    PatternIndex<N> index{};
+    for(size_t i=0;i<N;++i)
+        index.begin[table[i].op+1]++;
+    for(int op=0;op<BINARY_OP_NUM;++op)
+        index.begin[op+1]+=index.begin[op];
+    int fill[BINARY_OP_NUM]{};
+    for(size_t i=0;i<N;++i)
+    {
+        int op=table[i].op;
+        index.order[index.begin[op]+fill[op]]=i;
+        fill[op]++;
+    }
+    return index;
+}
+static constexpr auto binary_pattern_index=BuildPatternIndex(binary_patterns);
+static constexpr auto branch_pattern_index=BuildPatternIndex(branch_patterns);
+static_assert(binary_pattern_index.begin[BINARY_OP_NUM]==sizeof(binary_patterns)/sizeof(BinaryPattern),
+              "binary pattern index is incomplete");
+static_assert(branch_pattern_index.begin[BINARY_OP_NUM]==sizeof(branch_patterns)/sizeof(BranchPattern),
+              "branch pattern index is incomplete");
+
 static std::map<koopa_raw_value_t,var_info_t> is_visited;
 static StackFrame stack_frame;
 static RegManager reg_manager;
 static int global_cnt=0;
-static std::vector<int> aggregate_vals;
 static int branch_cnt=0;
+static koopa_raw_basic_block_t current_bb=nullptr;
+// 当前函数中提升到寄存器的全局变量基址
+static std::map<koopa_raw_value_t,std::string> global_base_regs;
+// 当前函数保存在栈上的 callee-saved 寄存器及其位置
+static std::vector<std::pair<std::string,int>> saved_regs;
 
 
 static void GenLoadStoreInst(std::string op,std::string reg1,int imm,std::string reg2)
@@ -52,11 +171,14 @@ static void GenLoadStoreInst(std::string op,std::string reg1,int imm,std::string
     }
     else
     {
+        // 高 20 位用 lui 加到基址上, 低 12 位编码进访存指令
+        int hi=(imm+0x800)>>12;
+        int lo=imm-(hi<<12);
         int reg_id=reg_manager.alloc_reg();
         std::string reg_tmp=gen_reg(reg_id);
-        std::cout<<"  li "<<reg_tmp<<", "<<imm<<std::endl;
+        std::cout<<"  lui "<<reg_tmp<<", "<<(hi&0xfffff)<<std::endl;
         std::cout<<"  add "<<reg_tmp<<", "<<reg_tmp<<", "<<reg2<<std::endl;
-        std::cout << "  " << op << " " << reg1 << ", " << 0 << "(" << reg_tmp << ")" << std::endl;
+        std::cout << "  " << op << " " << reg1 << ", " << lo << "(" << reg_tmp << ")" << std::endl;
         reg_manager.free(reg_id);
     }
 }
@@ -76,6 +198,450 @@ static void GenAddInst(std::string src_reg,std::string dest_reg,int imm)
     }
 }
 
+static bool IsInteger(const koopa_raw_value_t &val)
+{
+    return val->kind.tag==KOOPA_RVT_INTEGER;
+}
+static bool FitImm12(long long imm)
+{
+    return imm>=-MAX_IMMEDIATE_VAL && imm<MAX_IMMEDIATE_VAL;
+}
+static bool MatchForm(OperandForm form,const koopa_raw_value_t &val)
+{
+    if(form==FORM_REG)
+        return true;
+    if(!IsInteger(val))
+        return false;
+    long long c=val->kind.data.integer.value;
+    switch (form)
+    {
+    case FORM_ZERO:
+        return c==0;
+    case FORM_IMM12:
+        return FitImm12(c);
+    case FORM_IMM12_NEG:
+        return FitImm12(-c);
+    case FORM_IMM12_INC:
+        return FitImm12(c+1);
+    case FORM_SHAMT:
+        return c>=0 && c<32;
+    default:
+        return false;
+    }
+}
+// 交换两个操作数后与原运算等价的运算符
+static bool CommuteOp(koopa_raw_binary_op_t op,koopa_raw_binary_op_t &res)
+{
+    switch (op)
+    {
+    case KOOPA_RBO_ADD:
+    case KOOPA_RBO_MUL:
+    case KOOPA_RBO_AND:
+    case KOOPA_RBO_OR:
+    case KOOPA_RBO_XOR:
+    case KOOPA_RBO_EQ:
+    case KOOPA_RBO_NOT_EQ:
+        res=op;
+        return true;
+    case KOOPA_RBO_LT:
+        res=KOOPA_RBO_GT;
+        return true;
+    case KOOPA_RBO_GT:
+        res=KOOPA_RBO_LT;
+        return true;
+    case KOOPA_RBO_LE:
+        res=KOOPA_RBO_GE;
+        return true;
+    case KOOPA_RBO_GE:
+        res=KOOPA_RBO_LE;
+        return true;
+    default:
+        return false;
+    }
+}
+template<typename Pattern,size_t N>
+static const Pattern *MatchPattern(const Pattern (&table)[N],const PatternIndex<N> &index,
+                                   koopa_raw_binary_op_t op,const koopa_raw_value_t &lhs,const koopa_raw_value_t &rhs)
+{
+    for(int i=index.begin[op];i<index.begin[op+1];++i)
+    {
+        const Pattern &pat=table[index.order[i]];
+        if(MatchForm(pat.lhs,lhs) && MatchForm(pat.rhs,rhs))
+            return &pat;
+    }
+    return nullptr;
+}
+// 为 op(lhs, rhs) 选择模式, 常量在左侧时也尝试交换操作数后的形式
+// 选中交换后的模式时, op/lhs/rhs 会被改写
+template<typename Pattern,size_t N>
+static const Pattern *SelectPattern(const Pattern (&table)[N],const PatternIndex<N> &index,
+                                    koopa_raw_binary_op_t &op,koopa_raw_value_t &lhs,koopa_raw_value_t &rhs)
+{
+    const Pattern *pat=MatchPattern(table,index,op,lhs,rhs);
+    koopa_raw_binary_op_t swapped;
+    if(IsInteger(lhs) && !IsInteger(rhs) && CommuteOp(op,swapped))
+    {
+        const Pattern *swapped_pat=MatchPattern(table,index,swapped,rhs,lhs);
+        bool is_generic=(pat==nullptr) || (pat->lhs==FORM_REG && pat->rhs==FORM_REG);
+        if(swapped_pat!=nullptr && is_generic)
+        {
+            std::swap(lhs,rhs);
+            op=swapped;
+            return swapped_pat;
+        }
+    }
+    return pat;
+}
+
+// 判断比较运算是否只作为紧随其后的 br 的条件, 此时由 br 选择融合的比较跳转指令, 不单独生成
+static bool IsFusedCond(const koopa_raw_value_t &value)
+{
+    if(value->kind.tag!=KOOPA_RVT_BINARY || value->used_by.len!=1 || current_bb==nullptr)
+        return false;
+    koopa_raw_value_t user=reinterpret_cast<koopa_raw_value_t>(value->used_by.buffer[0]);
+    if(user->kind.tag!=KOOPA_RVT_BRANCH || user->kind.data.branch.cond!=value)
+        return false;
+    const koopa_raw_slice_t &insts=current_bb->insts;
+    if(insts.len==0 || insts.buffer[insts.len-1]!=user)
+        return false;
+    koopa_raw_binary_op_t op=value->kind.data.binary.op;
+    koopa_raw_value_t lhs=value->kind.data.binary.lhs,rhs=value->kind.data.binary.rhs;
+    return SelectPattern(branch_patterns,branch_pattern_index,op,lhs,rhs)!=nullptr;
+}
+
+// 乘数/除数为常数时, 用移位, 加减和 mulh 代替 mul/div/rem
+static bool PlanConstArith(const koopa_raw_binary_t &binary,koopa_raw_value_t &x,ArithPlan &plan)
+{
+    koopa_raw_value_t lhs=binary.lhs,rhs=binary.rhs;
+    switch (binary.op)
+    {
+    case KOOPA_RBO_MUL:
+        if(IsInteger(lhs) && !IsInteger(rhs))
+            std::swap(lhs,rhs);
+        x=lhs;
+        return !IsInteger(lhs) && IsInteger(rhs) && PlanMulConst(rhs->kind.data.integer.value,3,plan);
+    case KOOPA_RBO_DIV:
+        x=lhs;
+        return !IsInteger(lhs) && IsInteger(rhs) && PlanDivConst(rhs->kind.data.integer.value,true,plan);
+    case KOOPA_RBO_MOD:
+        x=lhs;
+        return !IsInteger(lhs) && IsInteger(rhs) && PlanModConst(rhs->kind.data.integer.value,true,plan);
+    default:
+        return false;
+    }
+}
+// 按强度削弱的序列生成指令, 返回结果所在的寄存器
+static bool StepUsesRhs(const ArithStep &step)
+{
+    return step.op==AS_ADD || step.op==AS_SUB;
+}
+static int GenArithPlan(const ArithPlan &plan,int x_reg_id)
+{
+    // 中间结果在最后一次使用之后释放
+    std::vector<int> last_use(plan.steps.size()+1,-1);
+    for(size_t i=0;i<plan.steps.size();++i)
+    {
+        const ArithStep &step=plan.steps[i];
+        if(step.op!=AS_LI)
+            last_use[step.lhs]=i;
+        if(StepUsesRhs(step))
+            last_use[step.rhs]=i;
+    }
+    std::vector<int> regs{x_reg_id};
+    for(size_t i=0;i<plan.steps.size();++i)
+    {
+        const ArithStep &step=plan.steps[i];
+        int dst_id=reg_manager.alloc_reg();
+        std::string dst=gen_reg(dst_id),lhs=gen_reg(regs[step.lhs]),rhs=gen_reg(regs[step.rhs]);
+        switch (step.op)
+        {
+        case AS_LI:
+            std::cout<<"  li "<<dst<<", "<<step.imm<<std::endl;
+            break;
+        case AS_SLLI:
+            std::cout<<"  slli "<<dst<<", "<<lhs<<", "<<step.imm<<std::endl;
+            break;
+        case AS_SRLI:
+            std::cout<<"  srli "<<dst<<", "<<lhs<<", "<<step.imm<<std::endl;
+            break;
+        case AS_SRAI:
+            std::cout<<"  srai "<<dst<<", "<<lhs<<", "<<step.imm<<std::endl;
+            break;
+        case AS_ADD:
+            std::cout<<"  add "<<dst<<", "<<lhs<<", "<<rhs<<std::endl;
+            break;
+        case AS_SUB:
+            std::cout<<"  sub "<<dst<<", "<<lhs<<", "<<rhs<<std::endl;
+            break;
+        case AS_ADDI:
+        case AS_ANDI:
+        {
+            const char *op=(step.op==AS_ADDI)?"add":"and";
+            if(FitImm12(step.imm))
+                std::cout<<"  "<<op<<"i "<<dst<<", "<<lhs<<", "<<step.imm<<std::endl;
+            else
+            {
+                std::cout<<"  li "<<dst<<", "<<step.imm<<std::endl;
+                std::cout<<"  "<<op<<" "<<dst<<", "<<lhs<<", "<<dst<<std::endl;
+            }
+            break;
+        }
+        case AS_NEG:
+            std::cout<<"  neg "<<dst<<", "<<lhs<<std::endl;
+            break;
+        case AS_MULI:
+            std::cout<<"  li "<<dst<<", "<<step.imm<<std::endl;
+            std::cout<<"  mul "<<dst<<", "<<lhs<<", "<<dst<<std::endl;
+            break;
+        case AS_MULHI:
+            std::cout<<"  li "<<dst<<", "<<step.imm<<std::endl;
+            std::cout<<"  mulh "<<dst<<", "<<lhs<<", "<<dst<<std::endl;
+            break;
+        }
+        regs.push_back(dst_id);
+        for(size_t k=1;k<regs.size()-1;++k)
+            if(last_use[k]==(int)i)
+                reg_manager.free(regs[k]);
+    }
+    return regs.back();
+}
+
+// 地址表达式: base + sum(index*scale) + offset
+// getelemptr/getptr 链在使用处合并为一次计算, 常量下标折叠进 offset, 最终 offset 编码进 lw/sw 的立即数
+struct AddrTerm
+{
+    koopa_raw_value_t index;
+    int scale;
+};
+struct AddrExpr
+{
+    koopa_raw_value_t base;
+    std::vector<AddrTerm> terms;
+    long long offset;
+};
+static std::map<koopa_raw_value_t,bool> is_folded_addr;
+
+static bool IsPtrArith(const koopa_raw_value_t &val)
+{
+    return val->kind.tag==KOOPA_RVT_GET_ELEM_PTR || val->kind.tag==KOOPA_RVT_GET_PTR;
+}
+static koopa_raw_value_t PtrArithSrc(const koopa_raw_value_t &val)
+{
+    if(val->kind.tag==KOOPA_RVT_GET_ELEM_PTR)
+        return val->kind.data.get_elem_ptr.src;
+    return val->kind.data.get_ptr.src;
+}
+static koopa_raw_value_t PtrArithIndex(const koopa_raw_value_t &val)
+{
+    if(val->kind.tag==KOOPA_RVT_GET_ELEM_PTR)
+        return val->kind.data.get_elem_ptr.index;
+    return val->kind.data.get_ptr.index;
+}
+static int PtrArithScale(const koopa_raw_value_t &val)
+{
+    koopa_raw_type_t base=PtrArithSrc(val)->ty->data.pointer.base;
+    if(val->kind.tag==KOOPA_RVT_GET_ELEM_PTR)
+        return get_var_size(base->data.array.base);
+    return get_var_size(base);
+}
+static bool IsFoldedAddr(const koopa_raw_value_t &val);
+// 从 val 向上直到第一个不折叠的指针, 下标是否全为常量 (此时在多处重复计算地址没有额外代价)
+static bool IsConstAddrChain(const koopa_raw_value_t &val)
+{
+    if(!IsInteger(PtrArithIndex(val)))
+        return false;
+    koopa_raw_value_t src=PtrArithSrc(val);
+    return !IsFoldedAddr(src) || IsConstAddrChain(src);
+}
+// 判断 getelemptr/getptr 是否不单独生成, 而是折叠进使用者的地址计算
+// 要求所有使用者都只把它当作地址, 且只有一个使用者或整条链的下标都是常量
+static bool IsFoldedAddr(const koopa_raw_value_t &val)
+{
+    if(!IsPtrArith(val))
+        return false;
+    auto it=is_folded_addr.find(val);
+    if(it!=is_folded_addr.end())
+        return it->second;
+    bool folded=(val->used_by.len>0);
+    for(uint32_t i=0;i<val->used_by.len && folded;++i)
+    {
+        koopa_raw_value_t user=reinterpret_cast<koopa_raw_value_t>(val->used_by.buffer[i]);
+        switch (user->kind.tag)
+        {
+        case KOOPA_RVT_LOAD:
+            folded=(user->kind.data.load.src==val);
+            break;
+        case KOOPA_RVT_STORE:
+            folded=(user->kind.data.store.dest==val && user->kind.data.store.value!=val);
+            break;
+        case KOOPA_RVT_GET_ELEM_PTR:
+        case KOOPA_RVT_GET_PTR:
+            folded=(PtrArithSrc(user)==val && PtrArithIndex(user)!=val);
+            break;
+        default:
+            folded=false;
+        }
+    }
+    if(folded && val->used_by.len>1)
+        folded=IsConstAddrChain(val);
+    is_folded_addr[val]=folded;
+    return folded;
+}
+static void AddAddrTerm(AddrExpr &expr,const koopa_raw_value_t &index,int scale)
+{
+    if(IsInteger(index))
+        expr.offset+=(long long)index->kind.data.integer.value*scale;
+    else
+        expr.terms.push_back({index,scale});
+}
+// 收集 ptr 对应的地址表达式, 折叠的 getelemptr/getptr 被展开
+static void CollectAddr(const koopa_raw_value_t &ptr,AddrExpr &expr)
+{
+    if(!IsFoldedAddr(ptr))
+    {
+        expr.base=ptr;
+        expr.offset=0;
+        expr.terms.clear();
+        return;
+    }
+    CollectAddr(PtrArithSrc(ptr),expr);
+    AddAddrTerm(expr,PtrArithIndex(ptr),PtrArithScale(ptr));
+}
+// val 是否只在 bb 中被使用; 折叠的 getelemptr/getptr 在它的使用者处才计算地址, 重新读取它的操作数,
+// 所以看的是它的使用者所在的基本块
+static bool UsedOnlyIn(const koopa_raw_value_t &val,koopa_raw_basic_block_t bb,
+                       std::map<koopa_raw_value_t,koopa_raw_basic_block_t> &def_bb)
+{
+    for(uint32_t i=0;i<val->used_by.len;++i)
+    {
+        koopa_raw_value_t user=reinterpret_cast<koopa_raw_value_t>(val->used_by.buffer[i]);
+        if(IsFoldedAddr(user)?!UsedOnlyIn(user,bb,def_bb):def_bb[user]!=bb)
+            return false;
+    }
+    return true;
+}
+static int Log2(int x)
+{
+    if(x<=0 || (x&(x-1))!=0)
+        return -1;
+    int k=0;
+    while((1<<k)<x)
+        k++;
+    return k;
+}
+// 全局变量加偏移的符号表达式, 如 g_0+8
+static std::string GlobalSym(const std::string &name,long long offset)
+{
+    if(offset==0)
+        return name;
+    return name+(offset>0?"+":"")+std::to_string(offset);
+}
+// 生成计算地址表达式的指令, 返回基址寄存器, offset 为可编码进 lw/sw 的 12 位立即数或 %lo
+static std::string GenAddr(const AddrExpr &expr,std::string &offset)
+{
+    long long imm=expr.offset;
+    std::string base_reg;
+    std::string lo_offset;  // 基址由 lui %hi 得到时, 低 12 位留给访存指令
+    int acc_reg_id=-1;  // 基址寄存器是否为本函数分配, 可以直接在其上累加
+    const koopa_raw_value_t &base=expr.base;
+    if(base->kind.tag==KOOPA_RVT_ALLOC)
+    {
+        base_reg="sp";
+        imm+=is_visited[base].stack_location;
+    }
+    else if(base->kind.tag==KOOPA_RVT_GLOBAL_ALLOC)
+    {
+        const var_info_t &ginfo=is_visited[base];
+        auto hoisted=global_base_regs.find(base);
+        if(hoisted!=global_base_regs.end())
+            base_reg=hoisted->second;
+        else
+        {
+            // 常数偏移并入符号, 变址加在 %hi 和 %lo 之间; 小数据段中的全局变量由链接器松弛为 gp 相对寻址
+            std::string sym=GlobalSym(ginfo.global_name,imm);
+            imm=0;
+            acc_reg_id=reg_manager.alloc_reg();
+            base_reg=gen_reg(acc_reg_id);
+            std::cout<<"  lui "<<base_reg<<", %hi("<<sym<<")"<<std::endl;
+            lo_offset="%lo("+sym+")";
+        }
+    }
+    else
+    {
+        bool base_on_reg=(is_visited[base].type==VAR_TYPE::ON_REG);
+        var_info_t base_var=Visit(base);
+        assert(base_var.type==VAR_TYPE::ON_REG);
+        base_reg=gen_reg(base_var.reg_id);
+        if(!base_on_reg)
+            acc_reg_id=base_var.reg_id;
+    }
+
+    for(const AddrTerm &term: expr.terms)
+    {
+        bool index_on_reg=(is_visited[term.index].type==VAR_TYPE::ON_REG);
+        var_info_t index_var=Visit(term.index);
+        assert(index_var.type==VAR_TYPE::ON_REG);
+        int scaled_id=index_var.reg_id;
+        bool scaled_owned=!index_on_reg;
+        if(term.scale!=1)
+        {
+            if(!scaled_owned)
+                scaled_id=reg_manager.alloc_reg();
+            scaled_owned=true;
+            std::string index_reg=gen_reg(index_var.reg_id),scaled_reg=gen_reg(scaled_id);
+            int shamt=Log2(term.scale);
+            if(shamt>=0)
+                std::cout<<"  slli "<<scaled_reg<<", "<<index_reg<<", "<<shamt<<std::endl;
+            else
+            {
+                int scale_id=reg_manager.alloc_reg();
+                std::cout<<"  li "<<gen_reg(scale_id)<<", "<<term.scale<<std::endl;
+                std::cout<<"  mul "<<scaled_reg<<", "<<index_reg<<", "<<gen_reg(scale_id)<<std::endl;
+                reg_manager.free(scale_id);
+            }
+        }
+        std::string scaled_reg=gen_reg(scaled_id);
+        if(acc_reg_id!=-1)
+        {
+            std::cout<<"  add "<<base_reg<<", "<<base_reg<<", "<<scaled_reg<<std::endl;
+            if(scaled_owned)
+                reg_manager.free(scaled_id);
+        }
+        else
+        {
+            acc_reg_id=scaled_owned?scaled_id:reg_manager.alloc_reg();
+            std::cout<<"  add "<<gen_reg(acc_reg_id)<<", "<<base_reg<<", "<<scaled_reg<<std::endl;
+            base_reg=gen_reg(acc_reg_id);
+        }
+    }
+
+    if(!lo_offset.empty())
+    {
+        offset=lo_offset;
+        return base_reg;
+    }
+    if(!FitImm12(imm))
+    {
+        if(acc_reg_id==-1)
+            acc_reg_id=reg_manager.alloc_reg();
+        GenAddInst(base_reg,gen_reg(acc_reg_id),imm);
+        base_reg=gen_reg(acc_reg_id);
+        imm=0;
+    }
+    offset=std::to_string(imm);
+    return base_reg;
+}
+// 按地址访问全局变量, op 为 lw 或 sw
+static void GenGlobalLoadStore(const std::string &op,const std::string &reg,const koopa_raw_value_t &global)
+{
+    AddrExpr expr;
+    expr.base=global;
+    expr.offset=0;
+    std::string offset;
+    std::string addr_reg=GenAddr(expr,offset);
+    std::cout<<"  "<<op<<" "<<reg<<", "<<offset<<"("<<addr_reg<<")"<<std::endl;
+}
+
 // 访问 raw program
 void Visit(const koopa_raw_program_t &program)
 {
@@ -93,97 +659,698 @@ void Visit(const koopa_raw_slice_t &slice)
     dbg_rscv_printf("Visit slice\n");
     for (size_t i = 0; i < slice.len; ++i)
     {
-        auto ptr = slice.buffer[i];
-        // 根据 slice 的 kind 决定将 ptr 视作何种元素
-        switch (slice.kind)
+        auto ptr = slice.buffer[i];
+        // 根据 slice 的 kind 决定将 ptr 视作何种元素
+        switch (slice.kind)
+        {
+        case KOOPA_RSIK_FUNCTION:
+            // 访问函数
+            Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
+            break;
+        case KOOPA_RSIK_BASIC_BLOCK:
+            // 访问基本块
+            Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
+            break;
+        case KOOPA_RSIK_VALUE:
+            // 访问指令
+            Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
+            break;
+        default:
+            // 我们暂时不会遇到其他内容, 于是不对其做任何处理
+            assert(false);
+        }
+    }
+}
+static const std::string global_base_reg_names[GLOBAL_BASE_REG_NUM]={"s8","s9","s10","s11"};
+
+static std::vector<koopa_raw_basic_block_t> BlockSuccs(const koopa_raw_basic_block_t &bb)
+{
+    std::vector<koopa_raw_basic_block_t> succs;
+    if(bb->insts.len==0)
+        return succs;
+    koopa_raw_value_t term=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[bb->insts.len-1]);
+    if(term->kind.tag==KOOPA_RVT_BRANCH)
+    {
+        succs.push_back(term->kind.data.branch.true_bb);
+        succs.push_back(term->kind.data.branch.false_bb);
+    }
+    else if(term->kind.tag==KOOPA_RVT_JUMP)
+        succs.push_back(term->kind.data.jump.target);
+    return succs;
+}
+// 计算每个基本块的循环嵌套深度: 深度优先搜索找回边, 每个循环头对应一个自然循环
+static std::map<koopa_raw_basic_block_t,int> ComputeLoopDepth(const koopa_raw_function_t &func)
+{
+    std::map<koopa_raw_basic_block_t,std::vector<koopa_raw_basic_block_t>> preds;
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for(koopa_raw_basic_block_t succ: BlockSuccs(bb))
+            preds[succ].push_back(bb);
+    }
+
+    // 0: 未访问, 1: 在搜索栈上, 2: 已完成
+    std::map<koopa_raw_basic_block_t,int> state;
+    std::map<koopa_raw_basic_block_t,std::vector<koopa_raw_basic_block_t>> latches;
+    std::vector<std::pair<koopa_raw_basic_block_t,size_t>> stack;
+    koopa_raw_basic_block_t entry=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[0]);
+    stack.push_back({entry,0});
+    state[entry]=1;
+    while(!stack.empty())
+    {
+        koopa_raw_basic_block_t bb=stack.back().first;
+        std::vector<koopa_raw_basic_block_t> succs=BlockSuccs(bb);
+        if(stack.back().second==succs.size())
+        {
+            state[bb]=2;
+            stack.pop_back();
+            continue;
+        }
+        koopa_raw_basic_block_t succ=succs[stack.back().second++];
+        if(state[succ]==1)
+            latches[succ].push_back(bb);
+        else if(state[succ]==0)
+        {
+            state[succ]=1;
+            stack.push_back({succ,0});
+        }
+    }
+
+    std::map<koopa_raw_basic_block_t,int> depth;
+    for(const auto &loop: latches)
+    {
+        koopa_raw_basic_block_t header=loop.first;
+        std::set<koopa_raw_basic_block_t> body{header};
+        std::vector<koopa_raw_basic_block_t> worklist=loop.second;
+        while(!worklist.empty())
+        {
+            koopa_raw_basic_block_t bb=worklist.back();
+            worklist.pop_back();
+            if(!body.insert(bb).second)
+                continue;
+            for(koopa_raw_basic_block_t pred: preds[bb])
+                worklist.push_back(pred);
+        }
+        for(koopa_raw_basic_block_t bb: body)
+            depth[bb]++;
+    }
+    return depth;
+}
+static long long LoopWeight(int depth)
+{
+    long long w=1;
+    for(int d=0;d<std::min(depth,4);++d)
+        w*=8;
+    return w;
+}
+// 每个全局变量按循环深度加权的访问次数, 即基址放在寄存器中能省去的 lui 数
+static std::map<koopa_raw_value_t,long long> GlobalAccessWeights(const koopa_raw_function_t &func,
+    std::map<koopa_raw_basic_block_t,int> &depth)
+{
+    std::map<koopa_raw_value_t,long long> weight;
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        long long w=LoopWeight(depth[bb]);
+        for(uint32_t j=0;j<bb->insts.len;++j)
+        {
+            koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            koopa_raw_value_t addr=nullptr;
+            if(inst->kind.tag==KOOPA_RVT_LOAD)
+                addr=inst->kind.data.load.src;
+            else if(inst->kind.tag==KOOPA_RVT_STORE)
+                addr=inst->kind.data.store.dest;
+            else if(IsPtrArith(inst) && !IsFoldedAddr(inst))
+                addr=PtrArithSrc(inst);
+            if(addr==nullptr)
+                continue;
+            // 折叠的地址链在每个使用处重新计算, 访问记在链的起点上
+            AddrExpr expr;
+            CollectAddr(addr,expr);
+            addr=expr.base;
+            if(addr->kind.tag!=KOOPA_RVT_GLOBAL_ALLOC)
+                continue;
+            weight[addr]+=w;
+        }
+    }
+    return weight;
+}
+// 选出访问次数超过 min_weight 的全局变量, 最多 max_num 个, 在建立栈帧时把基址放入寄存器
+static std::vector<koopa_raw_value_t> SelectHoistedGlobals(const koopa_raw_function_t &func,
+    std::map<koopa_raw_basic_block_t,int> &depth,size_t max_num,long long min_weight)
+{
+    std::map<koopa_raw_value_t,long long> weight=GlobalAccessWeights(func,depth);
+    std::vector<std::pair<long long,koopa_raw_value_t>> cands;
+    for(const auto &it: weight)
+        if(it.second>min_weight)
+            cands.push_back({it.second,it.first});
+    std::stable_sort(cands.begin(),cands.end(),[](const auto &a,const auto &b){ return a.first>b.first; });
+    std::vector<koopa_raw_value_t> res;
+    for(size_t i=0;i<cands.size() && i<max_num;++i)
+        res.push_back(cands[i].second);
+    return res;
+}
+
+// 当前函数的帧布局, 由 Prologue 计算
+struct SpilledParam
+{
+    koopa_raw_value_t param;
+    int reg_id;
+    int stack_location;
+};
+static std::map<koopa_raw_value_t,int> home_regs;       // 叶函数中放在寄存器里而不是栈上的值
+static std::vector<std::pair<koopa_raw_value_t,std::string>> hoisted_globals;  // 建立栈帧时载入基址的全局变量
+static std::vector<SpilledParam> spilled_params;        // 建立栈帧时保存到栈上的参数
+static std::set<koopa_raw_basic_block_t> frameless_bbs; // 不需要栈帧的基本块
+// 只在定义所在的基本块中使用的值, 各基本块共用栈帧底部的一段位置
+static std::set<koopa_raw_value_t> block_local_values;
+static int local_slot_base=0,local_slot_next=0;
+static bool is_leaf_func=false;
+static bool in_frame=false;     // 当前基本块中栈帧是否已经建立
+static int frame_setup_cnt=0;
+static koopa_raw_value_t current_value=nullptr;     // 正在生成的指令
+
+static std::vector<koopa_raw_value_t> Operands(const koopa_raw_value_t &inst)
+{
+    const auto &kind=inst->kind;
+    std::vector<koopa_raw_value_t> ops;
+    switch (kind.tag)
+    {
+    case KOOPA_RVT_LOAD:
+        ops={kind.data.load.src};
+        break;
+    case KOOPA_RVT_STORE:
+        ops={kind.data.store.value,kind.data.store.dest};
+        break;
+    case KOOPA_RVT_BINARY:
+        ops={kind.data.binary.lhs,kind.data.binary.rhs};
+        break;
+    case KOOPA_RVT_GET_ELEM_PTR:
+    case KOOPA_RVT_GET_PTR:
+        ops={PtrArithSrc(inst),PtrArithIndex(inst)};
+        break;
+    case KOOPA_RVT_BRANCH:
+        ops={kind.data.branch.cond};
+        for(uint32_t i=0;i<kind.data.branch.true_args.len;++i)
+            ops.push_back(reinterpret_cast<koopa_raw_value_t>(kind.data.branch.true_args.buffer[i]));
+        for(uint32_t i=0;i<kind.data.branch.false_args.len;++i)
+            ops.push_back(reinterpret_cast<koopa_raw_value_t>(kind.data.branch.false_args.buffer[i]));
+        break;
+    case KOOPA_RVT_JUMP:
+        for(uint32_t i=0;i<kind.data.jump.args.len;++i)
+            ops.push_back(reinterpret_cast<koopa_raw_value_t>(kind.data.jump.args.buffer[i]));
+        break;
+    case KOOPA_RVT_RETURN:
+        if(kind.data.ret.value)
+            ops={kind.data.ret.value};
+        break;
+    case KOOPA_RVT_CALL:
+        for(uint32_t i=0;i<kind.data.call.args.len;++i)
+            ops.push_back(reinterpret_cast<koopa_raw_value_t>(kind.data.call.args.buffer[i]));
+        break;
+    default:
+        break;
+    }
+    return ops;
+}
+// 指令是否有需要存放的结果 (融合进跳转的比较和折叠的地址计算没有), 需要 current_bb 为指令所在的基本块
+static bool HasResult(const koopa_raw_value_t &inst)
+{
+    if(inst->ty->tag==KOOPA_RTT_UNIT || IsFusedCond(inst))
+        return false;
+    return !(IsPtrArith(inst) && IsFoldedAddr(inst));
+}
+// 只被直接 load/store 的 i32 变量可以放在寄存器里
+static bool IsScalarAlloc(const koopa_raw_value_t &alloc)
+{
+    if(alloc->ty->data.pointer.base->tag!=KOOPA_RTT_INT32)
+        return false;
+    for(uint32_t i=0;i<alloc->used_by.len;++i)
+    {
+        koopa_raw_value_t user=reinterpret_cast<koopa_raw_value_t>(alloc->used_by.buffer[i]);
+        if(user->kind.tag==KOOPA_RVT_LOAD && user->kind.data.load.src==alloc)
+            continue;
+        if(user->kind.tag==KOOPA_RVT_STORE && user->kind.data.store.dest==alloc && user->kind.data.store.value!=alloc)
+            continue;
+        return false;
+    }
+    return true;
+}
+// 叶函数中没有调用会破坏 a 寄存器, 按加权使用次数把值放进空闲的 a 寄存器;
+// 全局变量的基址按加权访问次数一起参与选择, 选中时在建立栈帧时载入
+static void SelectHomes(const koopa_raw_function_t &func,std::map<koopa_raw_basic_block_t,int> &depth,
+    std::vector<int> &free_regs)
+{
+    std::map<koopa_raw_value_t,long long> weight;
+    std::vector<koopa_raw_value_t> cands;
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        long long w=LoopWeight(depth[bb]);
+        current_bb=bb;
+        for(uint32_t j=0;j<bb->params.len;++j)
+            cands.push_back(reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j]));
+        for(uint32_t j=0;j<bb->insts.len;++j)
+        {
+            koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            if(HasResult(inst) && (inst->kind.tag!=KOOPA_RVT_ALLOC || IsScalarAlloc(inst)))
+            {
+                cands.push_back(inst);
+                weight[inst]+=w;
+            }
+            for(const koopa_raw_value_t &op: Operands(inst))
+                weight[op]+=w;
+        }
+    }
+    current_bb=nullptr;
+    std::set<koopa_raw_value_t> globals;
+    for(const auto &it: GlobalAccessWeights(func,depth))
+    {
+        if(it.second<=2)
+            continue;
+        globals.insert(it.first);
+        cands.push_back(it.first);
+        weight[it.first]=it.second;
+    }
+    std::stable_sort(cands.begin(),cands.end(),[&](const auto &a,const auto &b){ return weight[a]>weight[b]; });
+    for(size_t i=0;i<cands.size() && !free_regs.empty();++i)
+    {
+        if(globals.count(cands[i]))
+            hoisted_globals.push_back({cands[i],gen_reg(free_regs.back())});
+        else
+            home_regs[cands[i]]=free_regs.back();
+        reg_manager.reserve(free_regs.back());
+        free_regs.pop_back();
+    }
+}
+// 读取 op 是否需要栈帧, 需要 current_bb 为使用者所在的基本块
+static bool ReadsFrame(const koopa_raw_value_t &op)
+{
+    switch (op->kind.tag)
+    {
+    case KOOPA_RVT_INTEGER:
+    case KOOPA_RVT_UNDEF:
+        return false;
+    case KOOPA_RVT_GLOBAL_ALLOC:
+        return global_base_regs.count(op)!=0;
+    case KOOPA_RVT_FUNC_ARG_REF:
+        return is_visited[op].type==VAR_TYPE::ON_STACK;
+    default:
+        return home_regs.count(op)==0 && !IsFusedCond(op);
+    }
+}
+static bool BlockNeedsFrame(const koopa_raw_basic_block_t &bb)
+{
+    current_bb=bb;
+    // 基本块参数放在栈上时, 传参的跳转和参数所在的基本块都需要栈帧
+    bool res=false;
+    for(uint32_t i=0;i<bb->params.len;++i)
+        res=res || home_regs.count(reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[i]))==0;
+    for(koopa_raw_basic_block_t succ: BlockSuccs(bb))
+        for(uint32_t i=0;i<succ->params.len;++i)
+            res=res || home_regs.count(reinterpret_cast<koopa_raw_value_t>(succ->params.buffer[i]))==0;
+    for(uint32_t i=0;i<bb->insts.len && !res;++i)
+    {
+        koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[i]);
+        if(inst->kind.tag==KOOPA_RVT_CALL || (HasResult(inst) && home_regs.count(inst)==0))
+            res=true;
+        for(const koopa_raw_value_t &op: Operands(inst))
+            res=res || ReadsFrame(op);
+    }
+    current_bb=nullptr;
+    return res;
+}
+// 收缩包装: 从入口出发, 只经过不需要栈帧的基本块能到达, 且所有前驱也都是这样的基本块, 这些块中不建立栈帧
+// 从这些块跳到其他块时再建立栈帧, 于是递归函数的边界情况等快速路径可以完全跳过序言
+static void ComputeFramelessBlocks(const koopa_raw_function_t &func)
+{
+    std::map<koopa_raw_basic_block_t,std::vector<koopa_raw_basic_block_t>> preds;
+    std::set<koopa_raw_basic_block_t> cands;
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for(koopa_raw_basic_block_t succ: BlockSuccs(bb))
+            preds[succ].push_back(bb);
+        if(!BlockNeedsFrame(bb))
+            cands.insert(bb);
+    }
+    koopa_raw_basic_block_t entry=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[0]);
+    if(!cands.count(entry))
+        return;
+
+    std::set<koopa_raw_basic_block_t> region{entry};
+    std::vector<koopa_raw_basic_block_t> worklist{entry};
+    while(!worklist.empty())
+    {
+        koopa_raw_basic_block_t bb=worklist.back();
+        worklist.pop_back();
+        for(koopa_raw_basic_block_t succ: BlockSuccs(bb))
+            if(cands.count(succ) && region.insert(succ).second)
+                worklist.push_back(succ);
+    }
+    bool changed=true;
+    while(changed)
+    {
+        changed=false;
+        for(auto it=region.begin();it!=region.end();)
+        {
+            bool keep=true;
+            for(koopa_raw_basic_block_t pred: preds[*it])
+                keep=keep && region.count(pred);
+            if(keep)
+                ++it;
+            else
+            {
+                it=region.erase(it);
+                changed=true;
+            }
+        }
+    }
+    frameless_bbs=region;
+}
+// 非叶函数中, 在调用之后还要使用的参数需要在建立栈帧时保存到栈上
+static bool ParamNeedsSpill(const koopa_raw_value_t &param,const koopa_raw_function_t &func)
+{
+    koopa_raw_basic_block_t entry=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[0]);
+    // 入口中第一条调用之前的使用直接读参数寄存器
+    std::set<koopa_raw_value_t> before_call;
+    if(!frameless_bbs.count(entry))
+    {
+        for(uint32_t i=0;i<entry->insts.len;++i)
+        {
+            koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(entry->insts.buffer[i]);
+            if(inst->kind.tag==KOOPA_RVT_CALL)
+                break;
+            before_call.insert(inst);
+        }
+    }
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        if(frameless_bbs.count(bb))
+            continue;
+        for(uint32_t j=0;j<bb->insts.len;++j)
+        {
+            koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            if(before_call.count(inst))
+                continue;
+            for(const koopa_raw_value_t &op: Operands(inst))
+                if(op==param)
+                    return true;
+        }
+    }
+    return false;
+}
+
+// 建立栈帧: 调整 sp, 保存 ra 和 callee-saved 寄存器, 载入全局变量基址, 保存参数
+static void GenFrameSetup()
+{
+    int stack_size=stack_frame.get_stack_size();
+    if(stack_size!=0)
+        GenAddInst("sp","sp",-stack_size);
+    if(stack_frame.is_store_ra())
+        GenLoadStoreInst("sw","ra",stack_size-4,"sp");
+    for(const auto &saved: saved_regs)
+        GenLoadStoreInst("sw",saved.first,saved.second,"sp");
+    for(const auto &hoisted: hoisted_globals)
+    {
+        std::string gname=is_visited[hoisted.first].global_name;
+        std::cout<<"  lui "<<hoisted.second<<", %hi("<<gname<<")"<<std::endl;
+        std::cout<<"  addi "<<hoisted.second<<", "<<hoisted.second<<", %lo("<<gname<<")"<<std::endl;
+    }
+    for(const SpilledParam &spilled: spilled_params)
+        GenLoadStoreInst("sw",gen_reg(spilled.reg_id),spilled.stack_location,"sp");
+}
+// 跳转目标需要栈帧而当前还没有建立时, 改为跳到建立栈帧的跳板, 跳板由 GenFrameSetupStubs 在跳转指令之后生成
+static std::string JumpLabel(const koopa_raw_basic_block_t &target,std::vector<std::pair<std::string,std::string>> &stubs)
+{
+    std::string label=target->name+1;
+    if(in_frame || frameless_bbs.count(target))
+        return label;
+    std::string stub="frame_setup_"+std::to_string(frame_setup_cnt);
+    frame_setup_cnt++;
+    stubs.push_back({stub,label});
+    return stub;
+}
+static void GenFrameSetupStubs(const std::vector<std::pair<std::string,std::string>> &stubs)
+{
+    for(const auto &stub: stubs)
+    {
+        std::cout<<stub.first<<":"<<std::endl;
+        GenFrameSetup();
+        int new_reg=reg_manager.alloc_reg();
+        std::cout<<"  la "<<gen_reg(new_reg)<<", "<<stub.second<<std::endl;
+        std::cout<<"  jr "<<gen_reg(new_reg)<<std::endl;
+        reg_manager.free(new_reg);
+    }
+}
+// 指令结果的目标寄存器: 有归宿寄存器的直接写入, 否则分配临时寄存器
+static int ResultReg()
+{
+    auto it=home_regs.find(current_value);
+    if(it!=home_regs.end())
+        return it->second;
+    return reg_manager.alloc_reg();
+}
+// 保存指令结果: 放入归宿寄存器, 或者放到新的栈位置
+static var_info_t SaveResult(int reg_id)
+{
+    var_info_t res;
+    auto it=home_regs.find(current_value);
+    if(it!=home_regs.end())
+    {
+        if(it->second!=reg_id)
+            std::cout<<"  mv "<<gen_reg(it->second)<<", "<<gen_reg(reg_id)<<std::endl;
+        res.type=VAR_TYPE::ON_REG;
+        res.reg_id=it->second;
+        return res;
+    }
+    res.type=VAR_TYPE::ON_STACK;
+    if(block_local_values.count(current_value))
+        res.stack_location=local_slot_base+4*(local_slot_next++);
+    else
+        res.stack_location=stack_frame.push();
+    GenLoadStoreInst("sw",gen_reg(reg_id),res.stack_location,"sp");
+    return res;
+}
+
+void Prologue(const koopa_raw_function_t &func)
+{
+    std::cout<<std::endl<<"  # prologue"<<std::endl;
+    home_regs.clear();
+    global_base_regs.clear();
+    hoisted_globals.clear();
+    saved_regs.clear();
+    spilled_params.clear();
+    frameless_bbs.clear();
+    reg_manager.unreserve_all();
+
+    bool store_ra=false;
+    int max_args_num=0;
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for(uint32_t j=0;j<bb->insts.len;++j)
+        {
+            koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
+            if(inst->kind.tag==KOOPA_RVT_CALL)
+            {
+                store_ra=true;
+                int args_num=inst->kind.data.call.args.len;
+                if(args_num>max_args_num)
+                    max_args_num=args_num;
+            }
+        }
+    }
+    is_leaf_func=!store_ra;
+
+    int reg_param_num=std::min((int)func->params.len,PARAM_REG_NUM);
+    for(int i=0;i<func->params.len;++i)
+    {
+        koopa_raw_value_t param = reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]);
+        var_info_t param_info;
+        if(i<PARAM_REG_NUM)
+        {
+            param_info.type=VAR_TYPE::ON_REG;
+            param_info.reg_id=(i+7);
+        }
+        else
+            param_info.type=VAR_TYPE::ON_STACK;
+        is_visited[param]=param_info;
+    }
+
+    std::map<koopa_raw_basic_block_t,int> depth=ComputeLoopDepth(func);
+    std::vector<std::string> callee_saved;
+    if(is_leaf_func)
+    {
+        // 叶函数: 参数寄存器一直保留, 其余 a 寄存器存放值和全局变量基址, 不需要保存
+        std::vector<int> free_regs;
+        for(int i=0;i<reg_param_num;++i)
+            reg_manager.reserve(i+7);
+        for(int id=7+reg_param_num;id<REG_NUM;++id)
+            free_regs.push_back(id);
+        SelectHomes(func,depth,free_regs);
+    }
+    else
+    {
+        // 每个提升的基址在序言和尾声中需要约 4 条指令, 每次访问省去一条 lui
+        std::vector<koopa_raw_value_t> hoisted=SelectHoistedGlobals(func,depth,GLOBAL_BASE_REG_NUM,4);
+        for(size_t i=0;i<hoisted.size();++i)
         {
-        case KOOPA_RSIK_FUNCTION:
-            // 访问函数
-            Visit(reinterpret_cast<koopa_raw_function_t>(ptr));
-            break;
-        case KOOPA_RSIK_BASIC_BLOCK:
-            // 访问基本块
-            Visit(reinterpret_cast<koopa_raw_basic_block_t>(ptr));
-            break;
-        case KOOPA_RSIK_VALUE:
-            // 访问指令
-            Visit(reinterpret_cast<koopa_raw_value_t>(ptr));
-            break;
-        default:
-            // 我们暂时不会遇到其他内容, 于是不对其做任何处理
-            assert(false);
+            hoisted_globals.push_back({hoisted[i],global_base_reg_names[i]});
+            callee_saved.push_back(global_base_reg_names[i]);
         }
     }
-}
-void Prologue(const koopa_raw_function_t &func)
-{
-    std::cout<<std::endl<<"  # prologue"<<std::endl;
-    int stack_size=0;
-    bool store_ra=false;
-    int max_args_num=0;
+    for(const auto &hoisted: hoisted_globals)
+        global_base_regs[hoisted.first]=hoisted.second;
+
+    ComputeFramelessBlocks(func);
+    std::vector<int> spilled;
+    if(!is_leaf_func)
+    {
+        for(int i=0;i<reg_param_num;++i)
+            if(ParamNeedsSpill(reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]),func))
+                spilled.push_back(i);
+    }
+
+    // 只在本基本块中使用的值生存期不跨越基本块, 它们的栈位置可以在基本块之间复用
+    std::map<koopa_raw_value_t,koopa_raw_basic_block_t> def_bb;
     for(uint32_t i=0;i<func->bbs.len;++i)
     {
         koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for(uint32_t j=0;j<bb->insts.len;++j)
+            def_bb[reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j])]=bb;
+    }
+    block_local_values.clear();
+    int stack_size=0,max_locals=0;
+    for(uint32_t i=0;i<func->bbs.len;++i)
+    {
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        current_bb=bb;
+        for(uint32_t j=0;j<bb->params.len;++j)
+            if(!home_regs.count(reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j])))
+                stack_size+=4;
+        int locals=0;
         for(uint32_t j=0;j<bb->insts.len;++j)
         {
             koopa_raw_value_t inst=reinterpret_cast<koopa_raw_value_t>(bb->insts.buffer[j]);
-            if(inst->ty->tag!=KOOPA_RTT_UNIT)
+            if(!HasResult(inst) || home_regs.count(inst))
+                continue;
+            if(inst->kind.tag==KOOPA_RVT_ALLOC)
             {
-                if(inst->kind.tag==KOOPA_RVT_ALLOC)
-                    stack_size+=get_var_size(inst->ty->data.pointer.base);
-                else
-                    stack_size=stack_size+4;
+                stack_size+=get_var_size(inst->ty->data.pointer.base);
+                continue;
             }
-            if(inst->kind.tag==KOOPA_RVT_CALL)
+            if(UsedOnlyIn(inst,bb,def_bb))
             {
-                store_ra=true;
-                int args_num=inst->kind.data.call.args.len;
-                if(args_num>max_args_num)
-                    max_args_num=args_num;
+                block_local_values.insert(inst);
+                locals++;
             }
+            else
+                stack_size+=4;
         }
+        max_locals=std::max(max_locals,locals);
     }
+    current_bb=nullptr;
+    stack_size+=max_locals*4;
 
     if(store_ra)
         stack_size+=4;
     if(max_args_num>8)
         stack_size+=(max_args_num-8)*4;
+    stack_size+=(callee_saved.size()+spilled.size())*4;
     
     stack_size=(stack_size+15)&(~15);
-
     stack_frame.set_stack_size(stack_size,store_ra,max_args_num);
-    if(stack_size<MAX_IMMEDIATE_VAL)
+    // 共用的位置紧接在传参区域之后, 偏移最小, 访问时最不容易超出立即数范围
+    local_slot_base=stack_frame.push(max_locals*4);
+
+    // 栈顶依次为 ra, callee-saved 寄存器, 保存的参数
+    int location=stack_size-(store_ra?4:0);
+    for(const std::string &reg: callee_saved)
     {
-        std::cout<<"  addi sp, sp, "<<-stack_size<<std::endl;
+        location-=4;
+        saved_regs.push_back({reg,location});
     }
-    else
+    for(int i: spilled)
     {
-        std::cout<<"  li t0, "<<-stack_size<<std::endl;
-        std::cout<<"  add sp, sp, t0"<<std::endl;
+        location-=4;
+        spilled_params.push_back({reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]),i+7,location});
     }
-
-    if(store_ra)
-        GenLoadStoreInst("sw","ra",stack_size-4,"sp");
-    
-    for(int i=0;i<func->params.len;++i)
+    for(uint32_t i=PARAM_REG_NUM;i<func->params.len;++i)
+        is_visited[reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i])].stack_location=stack_size+(i-8)*4;
+    // 跳转可能出现在目标基本块之前, 基本块参数的位置需要预先分配
+    for(uint32_t i=0;i<func->bbs.len;++i)
     {
-        
-        koopa_raw_value_t param = reinterpret_cast<koopa_raw_value_t>(func->params.buffer[i]);
-        var_info_t param_info;
-        if(i<PARAM_REG_NUM)
-        {
-            param_info.type=VAR_TYPE::ON_REG;
-            param_info.reg_id=(i+7);
-        }
-        else
+        koopa_raw_basic_block_t bb=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[i]);
+        for(uint32_t j=0;j<bb->params.len;++j)
         {
-            param_info.type=VAR_TYPE::ON_STACK;
-            param_info.stack_location=stack_size+(i-8)*4;
+            koopa_raw_value_t param=reinterpret_cast<koopa_raw_value_t>(bb->params.buffer[j]);
+            var_info_t info;
+            if(home_regs.count(param))
+            {
+                info.type=VAR_TYPE::ON_REG;
+                info.reg_id=home_regs[param];
+            }
+            else
+            {
+                info.type=VAR_TYPE::ON_STACK;
+                info.stack_location=stack_frame.push();
+            }
+            is_visited[param]=info;
         }
-        is_visited[param]=param_info;
     }
 
+    koopa_raw_basic_block_t entry=reinterpret_cast<koopa_raw_basic_block_t>(func->bbs.buffer[0]);
+    if(!frameless_bbs.count(entry))
+        GenFrameSetup();
+}
+// 指针是否可能指向当前函数的栈帧
+// SysY 中指针类型的局部变量只能保存参数, 所以从内存读出的指针不会指向栈帧
+static bool PointsToFrame(const koopa_raw_value_t &ptr)
+{
+    switch (ptr->kind.tag)
+    {
+    case KOOPA_RVT_GLOBAL_ALLOC:
+    case KOOPA_RVT_FUNC_ARG_REF:
+    case KOOPA_RVT_LOAD:
+        return false;
+    case KOOPA_RVT_GET_ELEM_PTR:
+        return PointsToFrame(ptr->kind.data.get_elem_ptr.src);
+    case KOOPA_RVT_GET_PTR:
+        return PointsToFrame(ptr->kind.data.get_ptr.src);
+    default:
+        return true;
+    }
+}
+// 调用之后紧接着返回它的结果, 且实参都在寄存器中, 不引用栈帧, 可以拆掉栈帧后直接跳转到被调用者
+// 需要 current_bb 为调用所在的基本块
+static bool IsTailCall(const koopa_raw_value_t &value)
+{
+    if(value->kind.tag!=KOOPA_RVT_CALL || current_bb==nullptr)
+        return false;
+    const koopa_raw_slice_t &insts=current_bb->insts;
+    if(insts.len<2 || reinterpret_cast<koopa_raw_value_t>(insts.buffer[insts.len-2])!=value)
+        return false;
+    koopa_raw_value_t last=reinterpret_cast<koopa_raw_value_t>(insts.buffer[insts.len-1]);
+    if(last->kind.tag!=KOOPA_RVT_RETURN)
+        return false;
+    koopa_raw_value_t ret_val=last->kind.data.ret.value;
+    if(ret_val==nullptr?value->used_by.len!=0:ret_val!=value)
+        return false;
+    const koopa_raw_call_t &call=value->kind.data.call;
+    if(call.args.len>PARAM_REG_NUM)
+        return false;
+    for(size_t i=0;i<call.args.len;++i)
+    {
+        koopa_raw_value_t arg=reinterpret_cast<koopa_raw_value_t>(call.args.buffer[i]);
+        if(arg->ty->tag==KOOPA_RTT_POINTER && PointsToFrame(arg))
+            return false;
+    }
+    return true;
 }
+static void GenTailCall(const koopa_raw_call_t &call);
+
 // 访问函数
 void Visit(const koopa_raw_function_t &func)
 {
@@ -196,6 +1363,7 @@ void Visit(const koopa_raw_function_t &func)
     Prologue(func);
     // 访问所有基本块
     Visit(func->bbs);
+    reg_manager.unreserve_all();
     std::cout<<std::endl;
 }
 
@@ -205,7 +1373,31 @@ void Visit(const koopa_raw_basic_block_t &bb)
     dbg_rscv_printf("Visit basic block\n");
     // 访问所有指令
     std::cout << bb->name + 1 << ":" << std::endl;
+    current_bb=bb;
+    in_frame=!frameless_bbs.count(bb);
+    local_slot_next=0;
+    // 栈帧建立之后从栈上读取保存的参数
+    for(const SpilledParam &spilled: spilled_params)
+    {
+        var_info_t info;
+        info.type=in_frame?VAR_TYPE::ON_STACK:VAR_TYPE::ON_REG;
+        info.stack_location=spilled.stack_location;
+        info.reg_id=spilled.reg_id;
+        is_visited[spilled.param]=info;
+    }
+    // 非叶函数中, 栈帧建立之前参数寄存器不能用作临时寄存器
+    if(!is_leaf_func)
+    {
+        for(int i=0;i<PARAM_REG_NUM;++i)
+        {
+            if(!in_frame)
+                reg_manager.reserve(i+7);
+            else
+                reg_manager.unreserve(i+7);
+        }
+    }
     Visit(bb->insts);
+    current_bb=nullptr;
 }
 
 // 访问指令
@@ -232,9 +1424,7 @@ var_info_t Visit(const koopa_raw_value_t &value)
         else if (info.type==VAR_TYPE::ON_GLOBAL)
         {
             int reg_id = reg_manager.alloc_reg();
-
-            std::cout << "  la " << gen_reg(reg_id) << ", " << is_visited[value].global_name << std::endl;
-            std::cout << "  lw " << gen_reg(reg_id) << ", 0(" << gen_reg(reg_id) << ")" << std::endl;
+            GenGlobalLoadStore("lw",gen_reg(reg_id),value);
             info.type = VAR_TYPE::ON_REG;
             info.reg_id = reg_id;
             return info;
@@ -244,11 +1434,17 @@ var_info_t Visit(const koopa_raw_value_t &value)
     // 根据指令类型判断后续需要如何访问
     const auto &kind = value->kind;
     var_info_t vinfo;
+    koopa_raw_value_t outer_value=current_value;
+    current_value=value;
     bool is_ret = (value->ty->tag != KOOPA_RTT_UNIT);
     int var_size=4;
     switch (kind.tag)
     {
     case KOOPA_RVT_RETURN:
+        // 尾调用已经返回
+        if(current_bb->insts.len>=2 &&
+           IsTailCall(reinterpret_cast<koopa_raw_value_t>(current_bb->insts.buffer[current_bb->insts.len-2])))
+            break;
         // 访问 return 指令
         Visit(kind.data.ret);
         reg_manager.free_regs();
@@ -257,14 +1453,28 @@ var_info_t Visit(const koopa_raw_value_t &value)
         // 访问 integer 指令
         vinfo=Visit(kind.data.integer);
         break;
+    case KOOPA_RVT_UNDEF:
+        // 未初始化的值随意取, 用 x0
+        vinfo.type=VAR_TYPE::ON_REG;
+        vinfo.reg_id=ZERO_REG_ID;
+        break;
     case KOOPA_RVT_BINARY:
         // 访问 binary 指令
+        if(IsFusedCond(value))
+            break;
         vinfo=Visit(kind.data.binary);
         is_visited[value]=vinfo;
         reg_manager.free_regs();
         break;
     case KOOPA_RVT_ALLOC:
         std::cout <<std::endl<< "  # alloc" << std::endl;
+        if(home_regs.count(value))
+        {
+            vinfo.type=VAR_TYPE::ON_REG;
+            vinfo.reg_id=home_regs[value];
+            is_visited[value]=vinfo;
+            break;
+        }
         vinfo.type=VAR_TYPE::ON_STACK;
         var_size=get_var_size(value->ty->data.pointer.base);
         vinfo.stack_location=stack_frame.push(var_size);
@@ -287,21 +1497,32 @@ var_info_t Visit(const koopa_raw_value_t &value)
         reg_manager.free_regs();
         break;
     case KOOPA_RVT_CALL:
+        if(IsTailCall(value))
+        {
+            GenTailCall(kind.data.call);
+            reg_manager.free_regs();
+            break;
+        }
         vinfo=Visit(kind.data.call,is_ret);
         is_visited[value]=vinfo;
         reg_manager.free_regs();
         break;
     case KOOPA_RVT_GLOBAL_ALLOC:
-        vinfo=Visit(kind.data.global_alloc);
+        vinfo=Visit(kind.data.global_alloc,value);
         assert(vinfo.type==VAR_TYPE::ON_GLOBAL);
         is_visited[value]=vinfo;
         break;
     case KOOPA_RVT_GET_ELEM_PTR:
+        // 折叠的地址计算在使用处生成
+        if(IsFoldedAddr(value))
+            break;
         vinfo=Visit(kind.data.get_elem_ptr);
         is_visited[value]=vinfo;
         reg_manager.free_regs();
         break;
     case KOOPA_RVT_GET_PTR:
+        if(IsFoldedAddr(value))
+            break;
         vinfo=Visit(kind.data.get_ptr);
         is_visited[value]=vinfo;
         reg_manager.free_regs();
@@ -311,26 +1532,24 @@ var_info_t Visit(const koopa_raw_value_t &value)
         printf("RVT type %d do not support.\n",kind.tag);
         assert(false);
     }
+    current_value=outer_value;
     return vinfo;
 }
 
 void Epilogue()
 {
+    // 没有建立栈帧的路径直接返回
+    if(!in_frame)
+        return;
     std::cout<<std::endl<<"  # epilogue"<<std::endl;
     int stack_size=stack_frame.get_stack_size();
     bool store_ra=stack_frame.is_store_ra();
     if(store_ra)
         GenLoadStoreInst("lw","ra",stack_size-4,"sp");
-    
-    if (stack_size < MAX_IMMEDIATE_VAL)
-    {
-        std::cout << "  addi sp, sp, " << stack_size << std::endl;
-    }
-    else
-    {
-        std::cout << "  li t0, " << stack_size << std::endl;
-        std::cout << "  add sp, sp, t0" << std::endl;
-    }
+    for(const auto &saved: saved_regs)
+        GenLoadStoreInst("lw",saved.first,saved.second,"sp");
+    if(stack_size!=0)
+        GenAddInst("sp","sp",stack_size);
 }
 
 // 访问对应类型指令的函数定义略
@@ -379,6 +1598,42 @@ var_info_t Visit(const koopa_raw_binary_t &binary)
     std::cout << std::endl
               << "  # binary" << std::endl;
 
+    koopa_raw_value_t arith_src;
+    ArithPlan plan;
+    if(PlanConstArith(binary,arith_src,plan))
+    {
+        var_info_t src_var=Visit(arith_src);
+        assert(src_var.type==VAR_TYPE::ON_REG);
+        int res_reg_id=GenArithPlan(plan,src_var.reg_id);
+        return SaveResult(res_reg_id);
+    }
+
+    koopa_raw_binary_op_t pat_op=binary.op;
+    koopa_raw_value_t pat_lhs=binary.lhs,pat_rhs=binary.rhs;
+    const BinaryPattern *pat=SelectPattern(binary_patterns,binary_pattern_index,pat_op,pat_lhs,pat_rhs);
+    if(pat!=nullptr)
+    {
+        // 模式中恰有一个叶子放在寄存器里, 另一个叶子是编码进指令的常量
+        bool lhs_is_reg=(pat->lhs==FORM_REG);
+        var_info_t src_var=Visit(lhs_is_reg?pat_lhs:pat_rhs);
+        assert(src_var.type==VAR_TYPE::ON_REG);
+        long long imm=(lhs_is_reg?pat_rhs:pat_lhs)->kind.data.integer.value;
+
+        int dst_reg_id=ResultReg();
+        std::string dst_reg=gen_reg(dst_reg_id);
+        std::cout<<"  "<<pat->inst<<" "<<dst_reg<<", "<<gen_reg(src_var.reg_id);
+        if(pat->imm_sign!=0)
+            std::cout<<", "<<pat->imm_sign*imm+pat->imm_bias;
+        std::cout<<std::endl;
+        if(pat->post==POST_NOT)
+            std::cout<<"  xori "<<dst_reg<<", "<<dst_reg<<", 1"<<std::endl;
+        else if(pat->post==POST_SEQZ)
+            std::cout<<"  seqz "<<dst_reg<<", "<<dst_reg<<std::endl;
+        else if(pat->post==POST_SNEZ)
+            std::cout<<"  snez "<<dst_reg<<", "<<dst_reg<<std::endl;
+        return SaveResult(dst_reg_id);
+    }
+
     var_info_t lvar=Visit(binary.lhs);
     var_info_t rvar=Visit(binary.rhs);
     
@@ -397,7 +1652,7 @@ var_info_t Visit(const koopa_raw_binary_t &binary)
 
     var_info_t tmp_result;
     tmp_result.type=VAR_TYPE::ON_REG;
-    tmp_result.reg_id=reg_manager.alloc_reg();
+    tmp_result.reg_id=ResultReg();
     
     std::string new_reg=gen_reg(tmp_result.reg_id),
                 l_reg=gen_reg(lvar.reg_id),
@@ -414,6 +1669,10 @@ var_info_t Visit(const koopa_raw_binary_t &binary)
     case KOOPA_RBO_MOD:
     case KOOPA_RBO_AND:
     case KOOPA_RBO_OR:
+    case KOOPA_RBO_XOR:
+    case KOOPA_RBO_SHL:
+    case KOOPA_RBO_SHR:
+    case KOOPA_RBO_SAR:
         std::cout << "  " <<op_names[op] << " " <<new_reg<< ", " <<l_reg<< ", " << r_reg<<std::endl;
         break;
     case KOOPA_RBO_EQ:
@@ -432,12 +1691,7 @@ var_info_t Visit(const koopa_raw_binary_t &binary)
         std::cout << "  slt " << new_reg << ", " << l_reg << ", " << r_reg << std::endl;
         std::cout << "  xori " << new_reg << ", " << new_reg << ", 1" << std::endl;
     }
-    
-    var_info_t res;
-    res.type=VAR_TYPE::ON_STACK;
-    res.stack_location=stack_frame.push();
-    GenLoadStoreInst("sw",new_reg,res.stack_location,"sp");
-    return res;
+    return SaveResult(tmp_result.reg_id);
 }
 
 void Visit(const koopa_raw_store_t &store)
@@ -446,7 +1700,7 @@ void Visit(const koopa_raw_store_t &store)
     std::cout << std::endl
               << "  # store" << std::endl;
     koopa_raw_value_t dst=store.dest;
-    assert(is_visited.find(dst)!=is_visited.end());
+    assert(IsFoldedAddr(dst) || is_visited.find(dst)!=is_visited.end());
 
     var_info_t src_var = Visit(store.value);
     assert(src_var.type == VAR_TYPE::ON_REG);
@@ -454,21 +1708,27 @@ void Visit(const koopa_raw_store_t &store)
     var_info_t dst_var;
     if(dst->kind.tag==KOOPA_RVT_GLOBAL_ALLOC)
     {
-        dst_var = is_visited[store.dest];
-        int reg_id=reg_manager.alloc_reg();
-        std::cout<<"  la "<<gen_reg(reg_id)<<", "<<dst_var.global_name<<std::endl;
-        std::cout<<"  sw "<<gen_reg(src_var.reg_id)<<", 0("<<gen_reg(reg_id)<<")"<<std::endl;
+        GenGlobalLoadStore("sw",gen_reg(src_var.reg_id),dst);
     }
-    else if(dst->kind.tag==KOOPA_RVT_GET_ELEM_PTR ||
-            dst->kind.tag==KOOPA_RVT_GET_PTR)
+    else if(dst->kind.tag!=KOOPA_RVT_ALLOC)
     {
-        dst_var=Visit(store.dest);
-        std::cout<<"  sw "<<gen_reg(src_var.reg_id)<<", ("<<gen_reg(dst_var.reg_id)<<")"<<std::endl;
+        // 地址计算, 或者作为值传递的指针 (如基本块参数)
+        AddrExpr expr;
+        CollectAddr(dst,expr);
+        std::string offset;
+        std::string addr_reg=GenAddr(expr,offset);
+        std::cout<<"  sw "<<gen_reg(src_var.reg_id)<<", "<<offset<<"("<<addr_reg<<")"<<std::endl;
     }
     else
     {
         dst_var = is_visited[store.dest];
-        GenLoadStoreInst("sw", gen_reg(src_var.reg_id),dst_var.stack_location,"sp");
+        if(dst_var.type==VAR_TYPE::ON_REG)
+        {
+            if(dst_var.reg_id!=src_var.reg_id)
+                std::cout<<"  mv "<<gen_reg(dst_var.reg_id)<<", "<<gen_reg(src_var.reg_id)<<std::endl;
+        }
+        else
+            GenLoadStoreInst("sw", gen_reg(src_var.reg_id),dst_var.stack_location,"sp");
     }
 }
 
@@ -478,51 +1738,148 @@ var_info_t Visit(const koopa_raw_load_t &load)
     std::cout << std::endl
               << "  # load" << std::endl;
 
-    var_info_t src_var=Visit(load.src);
-    assert(src_var.type==VAR_TYPE::ON_REG);
-    int src_reg=src_var.reg_id;
-    if(load.src->kind.tag==KOOPA_RVT_GET_ELEM_PTR || 
-       load.src->kind.tag==KOOPA_RVT_GET_PTR)
+    int src_reg;
+    if(load.src->kind.tag==KOOPA_RVT_GLOBAL_ALLOC)
     {
-        src_reg=reg_manager.alloc_reg();
-        std::cout<<"  lw "<<gen_reg(src_reg)<<", ("<<gen_reg(src_var.reg_id)<<")"<<std::endl;
+        src_reg=ResultReg();
+        GenGlobalLoadStore("lw",gen_reg(src_reg),load.src);
     }
-    var_info_t dst_var;
-    dst_var.type=VAR_TYPE::ON_STACK;
-    dst_var.stack_location=stack_frame.push();
-    GenLoadStoreInst("sw", gen_reg(src_reg), dst_var.stack_location, "sp");
-    return dst_var;
+    else if(load.src->kind.tag!=KOOPA_RVT_ALLOC)
+    {
+        AddrExpr expr;
+        CollectAddr(load.src,expr);
+        std::string offset;
+        std::string addr_reg=GenAddr(expr,offset);
+        src_reg=ResultReg();
+        std::cout<<"  lw "<<gen_reg(src_reg)<<", "<<offset<<"("<<addr_reg<<")"<<std::endl;
+    }
+    else
+    {
+        var_info_t src_var=Visit(load.src);
+        assert(src_var.type==VAR_TYPE::ON_REG);
+        src_reg=src_var.reg_id;
+    }
+    return SaveResult(src_reg);
 }
 
+// 把实参传给目标基本块的参数, 这是一组并行赋值
+// 每次完成一个目标不再被其他赋值读取的赋值; 只剩下环时, 先把环中一个参数的旧值读入临时寄存器
+static void GenBlockArgs(const koopa_raw_basic_block_t &target,const koopa_raw_slice_t &args)
+{
+    struct Move
+    {
+        koopa_raw_value_t src,dst;
+        int reg;    // 非负时 src 的旧值已经保存在这个寄存器中
+    };
+    std::vector<Move> moves;
+    for(uint32_t i=0;i<args.len;++i)
+    {
+        koopa_raw_value_t src=reinterpret_cast<koopa_raw_value_t>(args.buffer[i]);
+        koopa_raw_value_t dst=reinterpret_cast<koopa_raw_value_t>(target->params.buffer[i]);
+        if(src!=dst)
+            moves.push_back({src,dst,-1});
+    }
+    while(!moves.empty())
+    {
+        size_t k=0;
+        for(;k<moves.size();++k)
+        {
+            bool is_read=false;
+            for(size_t j=0;j<moves.size() && !is_read;++j)
+                is_read=(j!=k && moves[j].reg<0 && moves[j].src==moves[k].dst);
+            if(!is_read)
+                break;
+        }
+        if(k==moves.size())
+        {
+            koopa_raw_value_t dst=moves[0].dst;
+            int reg_id=Visit(dst).reg_id;
+            if(reg_manager.is_reserved(reg_id))
+            {
+                int tmp=reg_manager.alloc_reg();
+                std::cout<<"  mv "<<gen_reg(tmp)<<", "<<gen_reg(reg_id)<<std::endl;
+                reg_id=tmp;
+            }
+            for(Move &move: moves)
+                if(move.reg<0 && move.src==dst)
+                    move.reg=reg_id;
+            continue;
+        }
+        Move move=moves[k];
+        moves.erase(moves.begin()+k);
+        int reg_id=move.reg;
+        if(reg_id<0)
+        {
+            var_info_t info=Visit(move.src);
+            assert(info.type==VAR_TYPE::ON_REG);
+            reg_id=info.reg_id;
+        }
+        const var_info_t &param=is_visited[move.dst];
+        if(param.type==VAR_TYPE::ON_REG)
+            std::cout<<"  mv "<<gen_reg(param.reg_id)<<", "<<gen_reg(reg_id)<<std::endl;
+        else
+            GenLoadStoreInst("sw",gen_reg(reg_id),param.stack_location,"sp");
+        if(move.reg<0 && reg_id!=ZERO_REG_ID)
+            reg_manager.free(reg_id);
+    }
+    reg_manager.free_regs();
+}
 void Visit(const koopa_raw_branch_t &branch)
 {
     dbg_rscv_printf("Visit branch\n");
     std::cout << std::endl
               << "  # branch" << std::endl;
-    std::string label_true=branch.true_bb->name+1;
-    std::string label_false=branch.false_bb->name+1;
+    std::vector<std::pair<std::string,std::string>> stubs;
+    std::string label_true=JumpLabel(branch.true_bb,stubs);
+    std::string label_false=JumpLabel(branch.false_bb,stubs);
     std::string label_inter="inter_label_"+std::to_string(branch_cnt);
     branch_cnt++;
-    var_info_t var=Visit(branch.cond);
-    std::string var_name;
-    if(var.type==VAR_TYPE::ON_REG)
-        var_name=gen_reg(var.reg_id);
+    if(IsFusedCond(branch.cond))
+    {
+        // 比较运算与跳转融合为一条比较跳转指令
+        koopa_raw_binary_op_t op=branch.cond->kind.data.binary.op;
+        koopa_raw_value_t lhs=branch.cond->kind.data.binary.lhs,
+                          rhs=branch.cond->kind.data.binary.rhs;
+        const BranchPattern *pat=SelectPattern(branch_patterns,branch_pattern_index,op,lhs,rhs);
+        var_info_t lvar=Visit(lhs);
+        assert(lvar.type==VAR_TYPE::ON_REG);
+        std::string operands=gen_reg(lvar.reg_id);
+        if(pat->rhs!=FORM_ZERO)
+        {
+            var_info_t rvar=Visit(rhs);
+            assert(rvar.type==VAR_TYPE::ON_REG);
+            operands+=", "+gen_reg(rvar.reg_id);
+        }
+        std::cout<<"  "<<pat->inst<<" "<<operands<<", "<<label_inter<<std::endl;
+    }
     else
-        var_name=std::to_string(var.stack_location)+"(sp)";
+    {
+        var_info_t var=Visit(branch.cond);
+        std::string var_name;
+        if(var.type==VAR_TYPE::ON_REG)
+            var_name=gen_reg(var.reg_id);
+        else
+            var_name=std::to_string(var.stack_location)+"(sp)";
 
-    std::cout << "  bnez  " << var_name << ", " << label_inter
-              << std::endl;
+        std::cout << "  bnez  " << var_name << ", " << label_inter
+                  << std::endl;
+    }
+    reg_manager.free_regs();
+    GenBlockArgs(branch.false_bb,branch.false_args);
     int new_reg = reg_manager.alloc_reg();
     std::cout << "  la " << gen_reg(new_reg) << ", " << label_false << std::endl;
     std::cout << "  jr " << gen_reg(new_reg) << std::endl;
     
     std::cout<<label_inter<<":"<<std::endl;
 
+    reg_manager.free_regs();
+    GenBlockArgs(branch.true_bb,branch.true_args);
     new_reg = reg_manager.alloc_reg();
     std::cout << "  la " << gen_reg(new_reg) << ", " << label_true << std::endl;
     std::cout << "  jr " << gen_reg(new_reg) << std::endl;
 
     reg_manager.free_regs();
+    GenFrameSetupStubs(stubs);
 }
 
 void Visit(const koopa_raw_jump_t &jump)
@@ -530,19 +1887,19 @@ void Visit(const koopa_raw_jump_t &jump)
     dbg_rscv_printf("Visit jump\n");
     std::cout << std::endl
               << "  # jump" << std::endl;
-    std::string label_target = jump.target->name + 1;
+    std::vector<std::pair<std::string,std::string>> stubs;
+    std::string label_target = JumpLabel(jump.target,stubs);
+    GenBlockArgs(jump.target,jump.args);
     int new_reg = reg_manager.alloc_reg();
     std::cout << "  la " << gen_reg(new_reg) << ", " << label_target << std::endl;
     std::cout << "  jr " << gen_reg(new_reg) << std::endl;
     reg_manager.free_regs();
+    GenFrameSetupStubs(stubs);
 }
 
-var_info_t Visit(const koopa_raw_call_t &call,bool is_ret)
+// 把实参放入参数寄存器和栈上的参数区
+static void GenCallArgs(const koopa_raw_call_t &call)
 {
-    dbg_rscv_printf("Visit func\n");
-    std::cout << std::endl
-              << "  # func" << std::endl;
-    
     reg_manager.free_regs();
     for(int i=0;i<call.args.len;++i)
     {
@@ -564,20 +1921,136 @@ var_info_t Visit(const koopa_raw_call_t &call,bool is_ret)
         }
         
     }
-
+}
+// 尾调用: 恢复寄存器, 释放栈帧后跳转, 被调用者直接返回到当前函数的调用者
+static void GenTailCall(const koopa_raw_call_t &call)
+{
+    std::cout << std::endl
+              << "  # tail call" << std::endl;
+    GenCallArgs(call);
+    Epilogue();
+    std::cout<<"  tail "<<call.callee->name+1<<std::endl;
+}
+var_info_t Visit(const koopa_raw_call_t &call,bool is_ret)
+{
+    dbg_rscv_printf("Visit func\n");
+    std::cout << std::endl
+              << "  # func" << std::endl;
+    GenCallArgs(call);
     std::cout<<"  call "<<call.callee->name+1<<std::endl;
 
     var_info_t info;
     if(is_ret)
+        info=SaveResult(7);
+    return info;
+}
+
+// 全局数据所在的段
+// 全零的放入 .bss, 从不被写入的放入 .rodata
+// 不使用 .sdata 等小数据段: 全局变量都用 %hi/%lo 寻址, 链接时没有 --relax-gp 也不会改写为 gp 相对寻址, 放入小数据段没有好处
+static bool IsZeroData(const koopa_raw_value_t &init)
+{
+    switch (init->kind.tag)
     {
-        info.type=VAR_TYPE::ON_STACK;
-        info.stack_location=stack_frame.push();
-        GenLoadStoreInst("sw","a0",info.stack_location,"sp");
+    case KOOPA_RVT_INTEGER:
+        return init->kind.data.integer.value==0;
+    case KOOPA_RVT_ZERO_INIT:
+    case KOOPA_RVT_UNDEF:
+        return true;
+    case KOOPA_RVT_AGGREGATE:
+    {
+        const koopa_raw_slice_t &elems=init->kind.data.aggregate.elems;
+        for(size_t i=0;i<elems.len;++i)
+            if(!IsZeroData(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i])))
+                return false;
+        return true;
     }
-    return info;
+    default:
+        return false;
+    }
+}
+// 通过 ptr 及由它算出的地址是否可能写入内存, 地址被传给函数或存入内存时也视为写入
+static bool MayWriteThrough(const koopa_raw_value_t &ptr)
+{
+    for(uint32_t i=0;i<ptr->used_by.len;++i)
+    {
+        koopa_raw_value_t user=reinterpret_cast<koopa_raw_value_t>(ptr->used_by.buffer[i]);
+        switch (user->kind.tag)
+        {
+        case KOOPA_RVT_LOAD:
+            break;
+        case KOOPA_RVT_GET_ELEM_PTR:
+        case KOOPA_RVT_GET_PTR:
+            if(PtrArithIndex(user)==ptr || MayWriteThrough(user))
+                return true;
+            break;
+        default:
+            return true;
+        }
+    }
+    return false;
+}
+static const char *SelectSection(const koopa_raw_value_t &global)
+{
+    const koopa_raw_value_t &init=global->kind.data.global_alloc.init;
+    if(IsZeroData(init))
+        return ".bss";
+    if(!MayWriteThrough(global))
+        return ".section .rodata";
+    return ".data";
 }
 
-var_info_t Visit(const koopa_raw_global_alloc_t &global_alloc)
+// 输出全局数据: 连续的非零字合并为一行 .word, 连续的零合并为一条 .zero
+class DataEmitter
+{
+public:
+    void Word(int val)
+    {
+        if(val==0)
+        {
+            Zero(4);
+            return;
+        }
+        FlushZero();
+        words.push_back(val);
+        if(words.size()==WORDS_PER_LINE)
+            FlushWords();
+    }
+    void Zero(int bytes)
+    {
+        FlushWords();
+        zero_bytes+=bytes;
+    }
+    void Flush()
+    {
+        FlushWords();
+        FlushZero();
+    }
+
+private:
+    static const size_t WORDS_PER_LINE=8;
+    std::vector<int> words;
+    long long zero_bytes=0;
+
+    void FlushWords()
+    {
+        if(words.empty())
+            return;
+        std::cout<<"  .word ";
+        for(size_t i=0;i<words.size();++i)
+            std::cout<<(i?", ":"")<<words[i];
+        std::cout<<std::endl;
+        words.clear();
+    }
+    void FlushZero()
+    {
+        if(zero_bytes!=0)
+            std::cout<<"  .zero "<<zero_bytes<<std::endl;
+        zero_bytes=0;
+    }
+};
+
+var_info_t Visit(const koopa_raw_global_alloc_t &global_alloc,const koopa_raw_value_t &value)
 {
     dbg_rscv_printf("Visit global alloc\n");
     std::string gname="g_"+std::to_string(global_cnt);
@@ -585,26 +2058,14 @@ var_info_t Visit(const koopa_raw_global_alloc_t &global_alloc)
     std::cout << std::endl
               << "  # global alloc" << std::endl;
 
-    std::cout << "  .data" << std::endl;
+    std::cout << "  " << SelectSection(value) << std::endl;
     std::cout << "  .globl " <<gname<<std::endl;
     std::cout<<gname<<":"<<std::endl;
 
-    const auto &kind = global_alloc.init->kind.tag;
-    switch (kind)
-    {
-        case KOOPA_RVT_ZERO_INIT:
-            std::cout<<"  .zero "<<get_var_size(global_alloc.init->ty)<<std::endl;
-            break;
-        case KOOPA_RVT_INTEGER:
-            std::cout<<"  .word "<<global_alloc.init->kind.data.integer.value<<std::endl;
-            break;
-        case KOOPA_RVT_AGGREGATE:
-            get_aggregate(global_alloc.init);
-            generate_aggregate();
-            break;
-        default:
-            assert(false);
-    }
+    DataEmitter emitter;
+    generate_aggregate(global_alloc.init,emitter);
+    emitter.Flush();
+
     var_info_t vinfo;
     vinfo.type=VAR_TYPE::ON_GLOBAL;
     vinfo.global_name=gname;
@@ -612,74 +2073,41 @@ var_info_t Visit(const koopa_raw_global_alloc_t &global_alloc)
     return vinfo;
 }
 
+// 生成不折叠的 getelemptr/getptr, 结果地址存入栈上
+static var_info_t GenPtrArith(const koopa_raw_value_t &src,const koopa_raw_value_t &index,int scale)
+{
+    AddrExpr expr;
+    CollectAddr(src,expr);
+    AddAddrTerm(expr,index,scale);
+    std::string offset;
+    std::string addr_reg=GenAddr(expr,offset);
+    int addr_reg_id=std::find(regs_name,regs_name+REG_NUM,addr_reg)-regs_name;
+    // 加上偏移, 或者把 sp/gp/全局变量基址寄存器复制到结果寄存器
+    if(offset!="0" || addr_reg_id==REG_NUM)
+    {
+        addr_reg_id=ResultReg();
+        std::cout<<"  addi "<<gen_reg(addr_reg_id)<<", "<<addr_reg<<", "<<offset<<std::endl;
+    }
+    return SaveResult(addr_reg_id);
+}
+
 var_info_t Visit(const koopa_raw_get_elem_ptr_t &get_elem_ptr)
 {
     dbg_rscv_printf("Visit get elem ptr\n");
     std::cout<<std::endl<<"  # get elem ptr"<<std::endl;
 
-    var_info_t src_var;
-    if(get_elem_ptr.src->kind.tag==KOOPA_RVT_GLOBAL_ALLOC)
-    {
-        src_var=is_visited[get_elem_ptr.src];
-        int new_reg_id=reg_manager.alloc_reg();
-        std::cout<<"  la "<<gen_reg(new_reg_id)<<", "<<src_var.global_name<<std::endl;
-        src_var.reg_id=new_reg_id;
-    }
-    else if(get_elem_ptr.src->kind.tag==KOOPA_RVT_ALLOC)
-    {
-        src_var=is_visited[get_elem_ptr.src];
-        int new_reg_id = reg_manager.alloc_reg();
-        GenAddInst("sp",gen_reg(new_reg_id),src_var.stack_location);
-        src_var.reg_id=new_reg_id;
-    }
-    else
-        src_var=Visit(get_elem_ptr.src);
-    
-    var_info_t index_var=Visit(get_elem_ptr.index);
-    var_info_t res_var;
-
     koopa_raw_type_t array=get_elem_ptr.src->ty->data.pointer.base;
-    int total_size=get_var_size(array);
-    int elem_size=total_size/(array->data.array.len);
-
-    int new_reg_id=reg_manager.alloc_reg();
-    std::string new_reg_name=gen_reg(new_reg_id);
-    std::cout<<"  li "<<new_reg_name<<", "<<elem_size<<std::endl;
-    std::cout<<"  mul "<<new_reg_name<<", "<<new_reg_name<<", "<<gen_reg(index_var.reg_id)<<std::endl;
-
-    std::cout<<"  add "<<gen_reg(src_var.reg_id)<<", "<<gen_reg(src_var.reg_id)<<", "<<new_reg_name<<std::endl;
-
-
-    
-    res_var.type=VAR_TYPE::ON_STACK;
-    res_var.stack_location=stack_frame.push();
-    GenLoadStoreInst("sw", gen_reg(src_var.reg_id), res_var.stack_location, "sp");
-    return res_var;
+    int elem_size=get_var_size(array->data.array.base);
+    return GenPtrArith(get_elem_ptr.src,get_elem_ptr.index,elem_size);
 }
 var_info_t Visit(const koopa_raw_get_ptr_t &get_ptr)
 {
     dbg_rscv_printf("Visit get ptr\n");
     std::cout << std::endl<< "  # get ptr" << std::endl;
 
-    var_info_t src_var = Visit(get_ptr.src);
-    
-    var_info_t index_var = Visit(get_ptr.index);
-    var_info_t res_var;
-
     koopa_raw_type_t array = get_ptr.src->ty->data.pointer.base;
     int elem_size = get_var_size(array);
-
-    int new_reg_id = reg_manager.alloc_reg();
-    std::string new_reg_name = gen_reg(new_reg_id);
-    std::cout << "  li " << new_reg_name << ", " << elem_size << std::endl;
-    std::cout << "  mul " << new_reg_name << ", " << new_reg_name << ", " << gen_reg(index_var.reg_id) << std::endl;
-
-    std::cout << "  add " << gen_reg(src_var.reg_id) << ", " << gen_reg(src_var.reg_id) << ", " <<new_reg_name << std::endl;
-
-    res_var.type = VAR_TYPE::ON_STACK;
-    res_var.stack_location = stack_frame.push();
-    GenLoadStoreInst("sw", gen_reg(src_var.reg_id), res_var.stack_location, "sp");
-    return res_var;
+    return GenPtrArith(get_ptr.src,get_ptr.index,elem_size);
 }
 
 int get_var_size(const koopa_raw_type_t &ty)
@@ -690,36 +2118,26 @@ int get_var_size(const koopa_raw_type_t &ty)
         return 4;
 }
 
-void get_aggregate(const koopa_raw_value_t &aggr)
+// 按顺序输出初始化数据, 子数组整体为 zeroinit 时不展开
+void generate_aggregate(const koopa_raw_value_t &init,DataEmitter &emitter)
 {
-    koopa_raw_slice_t elems=aggr->kind.data.aggregate.elems;
-    for(size_t i=0;i<elems.len;++i)
+    switch (init->kind.tag)
     {
-        auto elem = reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]);
-        if(elem->kind.tag==KOOPA_RVT_INTEGER)
-            aggregate_vals.push_back(elem->kind.data.integer.value);
-        else if(elem->kind.tag==KOOPA_RVT_AGGREGATE)
-            get_aggregate(elem);
-        else
-            assert(false);
-    }
-}
-void generate_aggregate()
-{
-    int zero_cnt=0;
-    for(auto& val: aggregate_vals)
+    case KOOPA_RVT_INTEGER:
+        emitter.Word(init->kind.data.integer.value);
+        break;
+    case KOOPA_RVT_ZERO_INIT:
+    case KOOPA_RVT_UNDEF:
+        emitter.Zero(get_var_size(init->ty));
+        break;
+    case KOOPA_RVT_AGGREGATE:
     {
-        if(val!=0)
-        {
-            if(zero_cnt!=0)
-                std::cout<<"  .zero "<<zero_cnt*4<<std::endl;
-            std::cout<<"  .word "<<val<<std::endl;
-            zero_cnt=0;
-        }
-        else
-            zero_cnt++;
+        const koopa_raw_slice_t &elems=init->kind.data.aggregate.elems;
+        for(size_t i=0;i<elems.len;++i)
+            generate_aggregate(reinterpret_cast<koopa_raw_value_t>(elems.buffer[i]),emitter);
+        break;
     }
-    if (zero_cnt != 0)
-        std::cout << "  .zero " << zero_cnt * 4 << std::endl;
-    aggregate_vals.clear();
-}
\ No newline at end of file
+    default:
+        assert(false);
+    }
+}
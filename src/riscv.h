@@ -9,6 +9,8 @@
 #define MAX_IMMEDIATE_VAL 2048
 #define ZERO_REG_ID 15
 #define PARAM_REG_NUM 8
+// 提升到 s8-s11 中的全局变量基址个数
+#define GLOBAL_BASE_REG_NUM 4
 
 //#define RISCV_DEBUG
 #ifdef RISCV_DEBUG
@@ -63,18 +65,42 @@ class RegManager
 {
 private:
     std::unordered_map<int,bool> regs_occupied;
+    std::unordered_map<int,bool> regs_reserved;
 public:
     RegManager()
     {
         for (int i = 0; i < REG_NUM; ++i)
+        {
             regs_occupied[i] = false;
+            regs_reserved[i] = false;
+        }
     }
     void free_regs()
     {
         for(int i=0;i<REG_NUM;++i)
-            regs_occupied[i]=false;
+            regs_occupied[i]=regs_reserved[i];
         dbg_regs_printf("all free\n");
     }
+    // 保留的寄存器 (参数, 值的归宿寄存器) 不会被分配为临时寄存器
+    void reserve(int i)
+    {
+        regs_reserved[i]=true;
+        regs_occupied[i]=true;
+    }
+    void unreserve(int i)
+    {
+        regs_reserved[i]=false;
+        regs_occupied[i]=false;
+    }
+    bool is_reserved(int i)
+    {
+        return regs_reserved[i];
+    }
+    void unreserve_all()
+    {
+        for(int i=0;i<REG_NUM;++i)
+            unreserve(i);
+    }
     int alloc_reg()
     {
         int ret=-1;
@@ -113,6 +139,8 @@ public:
 
     void free(int i)
     {
+        if(regs_reserved[i])
+            return;
         regs_occupied[i]=false;
         dbg_regs_printf("free %d\n", i);
     }
@@ -150,10 +178,10 @@ var_info_t Visit(const koopa_raw_integer_t &interger);
 var_info_t Visit(const koopa_raw_binary_t &binary);
 var_info_t Visit(const koopa_raw_load_t &load);
 var_info_t Visit(const koopa_raw_call_t &call,bool is_ret);
-var_info_t Visit(const koopa_raw_global_alloc_t &global_alloc);
+var_info_t Visit(const koopa_raw_global_alloc_t &global_alloc,const koopa_raw_value_t &value);
 var_info_t Visit(const koopa_raw_get_elem_ptr_t &get_elem_ptr);
 var_info_t Visit(const koopa_raw_get_ptr_t &get_ptr);
 
 int get_var_size(const koopa_raw_type_t &ty);
-void get_aggregate(const koopa_raw_value_t &aggr);
-void generate_aggregate();
+class DataEmitter;
+void generate_aggregate(const koopa_raw_value_t &init,DataEmitter &emitter);
@@ -9,6 +9,7 @@
 
 SymbolTableStack symbol_table_stack;
 std::unordered_map<std::string, std::string> func_map;
+std::unordered_set<std::string> source_idents;
 
 std::string SymbolTable::Insert(std::string symbol,int val)
 {
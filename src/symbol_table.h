@@ -1,6 +1,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 
 enum SYMBOL_TYPE
@@ -98,4 +99,6 @@ void initSysyRuntimeLib();
 
 extern std::unordered_map<std::string,std::string> func_map;
 extern SymbolTableStack symbol_table_stack;
+// 源程序中出现过的所有标识符, 由词法分析记录, 生成全局名字时用来避免与用户的名字冲突
+extern std::unordered_set<std::string> source_idents;
 
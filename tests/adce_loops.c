@@ -0,0 +1,50 @@
+int g;
+
+int spin(int x) {
+  int y = 0;
+  while (x > 0) {
+    y = y + 1;
+    if (y > 5) y = 0;
+  }
+  return 5;
+}
+
+int settle(int x) {
+  int y = 0;
+  while (x > 0) {
+    y = y + 1;
+    if (y > 5) {
+      y = 0;
+      x = x - 1;
+    }
+  }
+  return 7;
+}
+
+int counted(int n) {
+  int i = 0;
+  int s = 0;
+  while (i < n) { s = s + i; i = i + 1; }
+  i = 10;
+  while (i >= 0) { s = s + i; i = i - 1; }
+  i = 0;
+  while (i <= 100) { s = s * 3; i = i + 3; }
+  i = n;
+  while (i != 0) { s = s + 2; i = i - 1; }
+  return n;
+}
+
+int main() {
+  int x = getint();
+  putint(spin(x));
+  putch(32);
+  putint(settle(getint()));
+  putch(32);
+  putint(counted(getint()));
+  putch(10);
+  int i = 0;
+  while (i < 5) { g = g + i; i = i + 1; }
+  putint(g);
+  putch(10);
+  return 0;
+}
@@ -0,0 +1,74 @@
+int g[10];
+int m[4][5];
+
+// 两个参数可能指向同一个数组
+int shift(int a[], int b[], int n) {
+  int i = 0, s = 0;
+  while (i < n) {
+    int x = a[i];
+    b[i + 1] = x + 1;
+    s = s + a[i] + a[i + 1];
+    i = i + 1;
+  }
+  return s;
+}
+
+// 同一基址上变量下标相同而常数偏移不同时不重叠, 下标变量不同时可能重叠
+int offsets(int a[], int i, int j) {
+  int x = a[i];
+  a[i + 1] = 7;
+  int y = a[i];
+  a[j] = 9;
+  int z = a[i];
+  return x * 100 + y * 10 + z;
+}
+
+// 二维数组的不同行列下标可能访问同一个元素, 子数组作为实参时与整个数组重叠
+int rows(int p[], int i) {
+  int x = m[i][0];
+  m[0][i] = x + 5;
+  p[0] = p[0] + m[i][0];
+  return m[1][0] + x;
+}
+
+// 尾递归消除后指针参数成为基本块参数, 在两个数组之间交替
+int alt(int a[], int b[], int k, int acc) {
+  if (k == 0) return acc;
+  a[0] = a[0] + k;
+  acc = acc + b[0];
+  return alt(b, a, k - 1, acc);
+}
+
+void set(int a[], int v) {
+  a[0] = v;
+}
+
+int main() {
+  int n = getint();
+  int i = 0;
+  while (i < 10) { g[i] = getint(); i = i + 1; }
+  int loc[10];
+  i = 0;
+  while (i < 10) { loc[i] = g[i] * 2; i = i + 1; }
+  putint(shift(g, g, n)); putch(32);
+  putint(shift(loc, g, n)); putch(32);
+  putint(g[1] + g[n]); putch(10);
+  putint(offsets(loc, 2, 2)); putch(32);
+  putint(offsets(loc, n - 3, 4)); putch(32);
+  putint(offsets(loc, n - 4, n - 3)); putch(10);
+  m[1][0] = n;
+  putint(rows(m[1], n - 5)); putch(32);
+  putint(rows(m[2], n - 4)); putch(32);
+  putint(m[1][0] + m[0][1] + m[2][0]); putch(10);
+  int x[1];
+  int y[1];
+  x[0] = 1;
+  y[0] = 10;
+  putint(alt(x, y, n, 0)); putch(32);
+  putint(alt(x, x, n, 0)); putch(10);
+  // 局部数组的地址传给函数后, 调用会写它
+  int t = loc[0];
+  set(loc, t + 1);
+  putint(loc[0] - t); putch(10);
+  return (g[3] + loc[5]) % 256;
+}
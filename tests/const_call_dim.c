@@ -0,0 +1,12 @@
+int sq(int x) {
+  return x * x;
+}
+
+int main() {
+  const int N = sq(3);
+  int a[N];
+  a[0] = N;
+  putint(a[0]);
+  putch(10);
+  return 0;
+}
@@ -0,0 +1,12 @@
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+const int N = fib(10);
+
+int main() {
+  putint(N);
+  putch(10);
+  return 0;
+}
@@ -0,0 +1,21 @@
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+int sq(int x) {
+  return x * x;
+}
+
+int main() {
+  const int N = fib(12);
+  const int M = sq(N % 7), K = 3;
+  int a[3] = {N, M, K};
+  int x = getint();
+  const int P = sq(x);
+  putint(a[0] + a[1] + a[2]);
+  putch(32);
+  putint(P + N);
+  putch(10);
+  return M;
+}
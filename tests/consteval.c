@@ -0,0 +1,57 @@
+const int N = 10;
+
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+void fill(int a[], int n) {
+  int i = 0;
+  while (i < n) { a[i] = i * i; i = i + 1; }
+}
+
+// 有自己的数组并把地址传给其他函数, 仍是纯函数
+int sumsq(int n) {
+  int a[20];
+  fill(a, n);
+  int i = 0, s = 0;
+  while (i < n) { s = s + a[i]; i = i + 1; }
+  return s;
+}
+
+int safe_div(int x) {
+  if (x == 0) return -1;
+  return 100 / x;
+}
+
+// 超出求值的步数上限, 留到运行时计算
+int slow(int n) {
+  int i = 0, s = 0;
+  while (i < n) { s = (s + i * 3) % 10007; i = i + 1; }
+  return s;
+}
+
+// 超出调用深度上限
+int deep(int n) {
+  if (n == 0) return 1;
+  return deep(n - 1) * 3 % 1009 + n % 5;
+}
+
+// 做输出的函数不能在编译时求值
+int noisy(int x) {
+  putint(x);
+  putch(32);
+  return x + 1;
+}
+
+int main() {
+  int a = fib(20);
+  int b = sumsq(N);
+  int c = safe_div(0) + safe_div(7);
+  putint(a); putch(32); putint(b); putch(32); putint(c); putch(10);
+  putint(slow(400000)); putch(10);
+  putint(deep(1500)); putch(10);
+  int d = noisy(1) + noisy(1);
+  putint(d); putch(10);
+  return (a + b + c) % 256;
+}
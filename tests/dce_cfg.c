@@ -0,0 +1,81 @@
+int g;
+
+int side(int x) {
+  g = g + x;
+  return x;
+}
+
+// 结果没有用到的纯函数调用可以删除
+int sq(int x) {
+  return x * x;
+}
+
+// 含循环的函数不一定返回, 结果没有用到时调用也要保留
+int loopy(int x) {
+  int i = 0;
+  while (i < x) { i = i + 2; }
+  return i;
+}
+
+int deadloop(int n) {
+  int i = 0, s = 0, t = 0;
+  while (i < n) {
+    s = s + i * 3;
+    t = t + side(i);
+    int u = sq(i) + loopy(i);
+    i = i + 1;
+  }
+  return t;
+}
+
+int empties(int a) {
+  if (a > 3) { } else { }
+  if (a > 5) { int z = a * a; z = z + 1; }
+  int k = 0;
+  while (k < 10) {
+    k = k + 1;
+    if (k == 5) continue;
+    if (k == 8) break;
+    k = k + 0;
+  }
+  return k + a;
+}
+
+int nested(int n) {
+  int r = 0, i = 0;
+  while (i < n) {
+    int j = 0;
+    while (j < n) {
+      if (i == j) { j = j + 1; continue; }
+      r = r + 1;
+      j = j + 1;
+    }
+    i = i + 1;
+    if (r > 1000) break;
+    int w = r * 7;
+  }
+  return r;
+}
+
+int cond_dead(int a, int b) {
+  int x = 0;
+  if (a < b) x = a * 2; else x = b * 3;
+  if (a == b) x = 7;
+  int y = x;
+  return a - b;
+}
+
+int main() {
+  int n = getint();
+  int i = 0, acc = 0;
+  while (i < n) {
+    acc = acc + deadloop(i) + empties(i) + nested(i) + cond_dead(i, 10 - i);
+    i = i + 1;
+  }
+  putint(acc); putch(10);
+  putint(g); putch(10);
+  int a[10];
+  a[3] = 5;
+  int unused = a[3] + 1;
+  return acc % 256;
+}
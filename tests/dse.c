@@ -0,0 +1,51 @@
+int g[4];
+
+int peek(int a[], int i) {
+  return a[i];
+}
+
+// 写全局变量的 store 在返回后仍会被读到
+void setg(int v) {
+  g[0] = v;
+  g[1] = v + 1;
+  g[0] = v + 2;
+}
+
+int main() {
+  int n = getint();
+  int a[6] = {};
+  // 被覆盖的 store
+  a[0] = 1;
+  a[0] = n;
+  // 调用可能读 a, 之前的 store 要保留
+  a[1] = n * 2;
+  int r = peek(a, n % 2);
+  a[1] = 3;
+  r = r + a[0] + a[1];
+  // 全零初始化之后用循环写满每个元素, 初始化可以删除
+  int b[8] = {1, 2, 3};
+  int i = 0;
+  while (i < 8) { b[i] = i * n; i = i + 1; }
+  // 只写了一部分的循环, 初始化要保留
+  int c[8] = {5, 5, 5, 5, 5, 5, 5, 5};
+  i = 0;
+  while (i < n) { c[i] = i; i = i + 1; }
+  // 提前退出的循环不一定写满
+  int d[8] = {};
+  i = 0;
+  while (i < 8) {
+    if (i == n - 2) break;
+    d[i] = 9;
+    i = i + 1;
+  }
+  // 只在一条路径上被覆盖
+  a[2] = 4;
+  if (n > 5) a[2] = 6;
+  i = 0;
+  while (i < 8) { r = r + b[i] + c[i] * 10 + d[i] * 100; i = i + 1; }
+  r = r + a[2];
+  setg(n);
+  putint(r); putch(32);
+  putint(g[0] * 10 + g[1]); putch(10);
+  return r % 256;
+}
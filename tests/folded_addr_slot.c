@@ -0,0 +1,34 @@
+int a[20];
+
+int h(int n) {
+  if (n <= 1) return n;
+  return h(n - 1) + h(n - 2);
+}
+
+int main() {
+  int x = getint();
+  int i = 0;
+  while (i < 20) { a[i] = i * 100 + 11; i = i + 1; }
+  int k = x * 3 + 1;
+  int s = 0;
+  i = 0;
+  while (i < 6) {
+    int u = h(i + 5);
+    a[i * 2] = u;
+    s = s + u + a[k];
+    i = i + 1;
+  }
+  putint(s);
+  putch(10);
+  int j = x + 4;
+  i = 0;
+  while (i < 4) {
+    int v = h(i + 3);
+    a[j] = a[j] + v;
+    a[i] = v;
+    i = i + 1;
+  }
+  putint(a[j]);
+  putch(10);
+  return s % 256;
+}
@@ -0,0 +1,57 @@
+int g[8];
+int h;
+
+void bump(int p[]) {
+  p[1] = p[1] + 1;
+  h = h + 1;
+}
+
+// p 和 q 可能指向同一个数组, store 之后重新读 p[0]
+int alias(int p[], int q[]) {
+  int x = p[0];
+  q[0] = x + 5;
+  return p[0] + x;
+}
+
+int local_vs_call(int v) {
+  int loc[4] = {v, v + 1, v + 2, v + 3};
+  int s = loc[1];
+  // loc 的地址没有逃逸, 调用不会修改它; g 会被修改
+  bump(g);
+  s = s + loc[1] + g[1];
+  bump(loc);
+  s = s + loc[1];
+  return s;
+}
+
+// 汇合点有多个前驱, 分支中的 store 之后不能沿用分支前读到的值
+int merge(int c) {
+  int x = g[2];
+  if (c > 3) g[2] = x + c;
+  return g[2] + x;
+}
+
+int redundant(int n, int m) {
+  int i = 0, s = 0;
+  while (i < n) {
+    int a = (i * m) % 7, b = (m * i) % 7;
+    if (i < m) s = s + a - b + (i + m) * 2;
+    else s = s + (m + i) * 2 + (m > i) + (i < m);
+    g[i % 8] = g[i % 8] + s;
+    h = h + g[i % 8] - g[(i + 1) % 8];
+    i = i + 1;
+  }
+  return s + h;
+}
+
+int main() {
+  int n = getint();
+  int arr[3] = {1, 2, n};
+  putint(alias(arr, arr)); putch(32);
+  putint(alias(arr, g)); putch(10);
+  putint(local_vs_call(n)); putch(10);
+  putint(merge(n)); putch(32); putint(merge(1)); putch(10);
+  putint(redundant(50, n)); putch(10);
+  putint(h); putch(10);
+  return 0;
+}
@@ -0,0 +1,24 @@
+int _init_tmpl0 = 3;
+int _init_idx0 = 5;
+
+int _init_tmpl1(int x) {
+  int b[20] = {};
+  b[x] = _init_idx0;
+  return b[x] + b[19];
+}
+
+int main() {
+  int n = getint();
+  int a[24] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, n, 19, 20};
+  int s = 0;
+  int i = 0;
+  while (i < 24) {
+    s = s + a[i] * _init_tmpl0;
+    i = i + 1;
+  }
+  putint(s + _init_tmpl1(n));
+  putch(10);
+  return 0;
+}
+
+int _init_tmpl2 = 7;
@@ -0,0 +1,61 @@
+int g;
+
+int add3(int a, int b, int c) {
+  return a + b + c;
+}
+
+// 多个 return 的函数内联后汇合到同一个基本块
+int clamp(int x, int lo, int hi) {
+  if (x < lo) return lo;
+  if (x > hi) return hi;
+  return x;
+}
+
+void bump(int k) {
+  if (k < 0) return;
+  g = g + k;
+}
+
+// 局部数组移到调用者的入口, 每次调用重新初始化
+int window(int x) {
+  int b[4] = {x, x + 1};
+  b[3] = b[0] + b[1];
+  return b[3] + b[2];
+}
+
+// 递归函数不内联
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+// 含循环的函数生成 RISCV 时不内联
+int sum(int a[], int n) {
+  int i = 0, s = 0;
+  while (i < n) { s = s + a[i]; i = i + 1; }
+  return s;
+}
+
+int layer2(int x) {
+  return clamp(add3(x, x, x), -50, 50) + window(x);
+}
+
+int layer1(int x) {
+  bump(x);
+  return layer2(x) * 2 + layer2(x + 1);
+}
+
+int main() {
+  int n = getint();
+  int arr[10];
+  int i = 0, acc = 0;
+  while (i < 10) {
+    arr[i] = layer1(i - n);
+    bump(-i);
+    acc = acc + clamp(arr[i], 0, 100);
+    i = i + 1;
+  }
+  putint(acc); putch(32); putint(g); putch(10);
+  putint(sum(arr, n + 6)); putch(32); putint(fib(n + 5)); putch(10);
+  return 0;
+}
@@ -0,0 +1,23 @@
+int f(int a, int b) {
+  int r = 0;
+  if (a > b) r = a - b; else r = b - a;
+  if (r % 3 == 0) r = r * 7 + a;
+  else if (r % 3 == 1) r = r * 5 - b;
+  else r = r + a * b;
+  if (r > 1000) r = r % 1000;
+  return r;
+}
+
+int main() {
+  int n = getint();
+  int s = f(n, n + 7);
+  int i = 0;
+  while (i < 10) {
+    s = s + f(i, 4);
+    i = i + 1;
+  }
+  s = s + f(s, n);
+  putint(s);
+  putch(10);
+  return 0;
+}
@@ -0,0 +1,66 @@
+int ga[20];
+int gb[20];
+int total;
+
+// 所有调用处都传入 step = 2, 直接代入
+int stride(int a[], int n, int step) {
+  int i = 0, s = 0;
+  while (i < n) { s = s + a[i]; i = i + step; }
+  return s;
+}
+
+// 按常量实参分组复制, 超出组数的调用仍调用原函数
+int scale(int x, int k) {
+  int i = 0, s = 0;
+  while (i < 4) { s = s + x * k + ga[i]; i = i + 1; }
+  return s / k;
+}
+
+// 全局数组的地址作为实参
+void add_to(int a[], int n, int v) {
+  int i = 0;
+  while (i < n) { a[i] = a[i] + v; i = i + 1; }
+}
+
+// 递归调用把 k 原样传下去, 复制的函数也调用自己
+int power_sum(int x, int k) {
+  if (x <= 0) return 0;
+  return x * k + power_sum(x - 1, k) + ga[x % 20];
+}
+
+// 返回值在所有调用处都未使用, 形参 unused 在函数中未使用
+int record(int v, int unused) {
+  total = total + v;
+  return total;
+}
+
+// 与大常数比较时不代入, 结果仍要正确
+int below(int x, int lim) {
+  int c = 0;
+  while (x < lim) { x = x + 1000; c = c + 1; }
+  return c;
+}
+
+int main() {
+  int n = getint();
+  int i = 0;
+  while (i < 20) { ga[i] = getint(); gb[i] = i * 3; i = i + 1; }
+  putint(stride(ga, n, 2)); putch(32);
+  putint(stride(gb, n, 2)); putch(10);
+  putint(scale(n, 2)); putch(32);
+  putint(scale(n, 3)); putch(32);
+  putint(scale(n, 2)); putch(32);
+  putint(scale(n, 5)); putch(32);
+  putint(scale(n, 7)); putch(32);
+  putint(scale(n, -1)); putch(10);
+  add_to(ga, n, 1);
+  add_to(gb, n, -1);
+  add_to(ga, 20, n);
+  putint(ga[0] + ga[19] + gb[1] + gb[19]); putch(10);
+  putint(power_sum(n, 3) + power_sum(n, 4) + power_sum(n - 1, n)); putch(10);
+  record(n, 5);
+  record(ga[3], n);
+  putint(total); putch(10);
+  putint(below(n, 100000) + below(-n, 7)); putch(10);
+  return total % 256;
+}
@@ -0,0 +1,82 @@
+int m[30][3];
+int p[12][5][3];
+int v[100];
+
+// 元素大小为 12 字节, 地址计算削弱为每次加 12
+void fill(int a[][3], int n) {
+  int i = 0;
+  while (i < n) {
+    a[i][0] = i * 3;
+    a[i][1] = i * 7 + 1;
+    a[i][2] = i - 5;
+    i = i + 1;
+  }
+}
+
+int strided(int n) {
+  int i = 0, s = 0;
+  while (i < n) {
+    s = s + v[i * 3] + i * 5;
+    i = i + 1;
+  }
+  return s;
+}
+
+// 计数器只用于退出条件, 替换为比较它的常数倍
+int lftr(int n) {
+  int i = 0, s = 0;
+  while (i < 30) {
+    s = s + i * 7;
+    i = i + 1;
+  }
+  int j = 40;
+  while (j > 2) {
+    s = s + j * 11;
+    j = j - 3;
+  }
+  return s + n;
+}
+
+// 乘以常数后超出 i32 范围, 不能替换退出条件
+int overflow(int n) {
+  int i = n, s = 0;
+  while (i < 1000000000) {
+    s = s + i * 5;
+    i = i + 100000000;
+  }
+  return s;
+}
+
+int cube(int n) {
+  int i = 0, s = 0;
+  while (i < n) {
+    int j = 0;
+    while (j < 5) {
+      int k = 0;
+      while (k < 3) {
+        p[i][j][k] = i * 100 + j * 10 + k;
+        s = s + p[i][j][k] * (k + 1);
+        k = k + 1;
+      }
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+  return s;
+}
+
+int main() {
+  int n = getint();
+  int i = 0;
+  while (i < 100) { v[i] = i * i % 17; i = i + 1; }
+  fill(m, n);
+  int s = 0;
+  i = 0;
+  while (i < 30) { s = s + m[i][0] + m[i][1] * 2 + m[i][2]; i = i + 1; }
+  putint(s); putch(10);
+  putint(strided(n + 3)); putch(10);
+  putint(lftr(n)); putch(10);
+  putint(overflow(n)); putch(10);
+  putint(cube(n - 18)); putch(10);
+  return s % 256;
+}
@@ -0,0 +1,82 @@
+int g[20][20];
+int total;
+int cnt;
+
+void tick() {
+  cnt = cnt + 1;
+}
+
+int rowsum(int a[][20], int n) {
+  int i = 0, s = 0;
+  while (i < n) {
+    int j = 0;
+    while (j < n) {
+      // total 在内层循环中提升为寄存器, g[i][0] 的读外提
+      total = total + a[i][j];
+      s = s + a[i][j] * g[i][0];
+      j = j + 1;
+    }
+    i = i + 1;
+  }
+  return s;
+}
+
+// 从循环中间 return 的出口也要写回提升的变量
+int early(int n, int k) {
+  int i = 0;
+  while (i < n) {
+    total = total + i;
+    if (total > k) return i;
+    i = i + 1;
+  }
+  return -1;
+}
+
+// 调用会修改 cnt, 不能提升
+int with_call(int n) {
+  int i = 0;
+  while (i < n) {
+    cnt = cnt + 2;
+    tick();
+    i = i + 1;
+  }
+  return cnt;
+}
+
+// p 和 q 可能指向同一个数组, 不能提升
+int aliasing(int p[], int q[], int n) {
+  int i = 0;
+  while (i < n) {
+    p[0] = p[0] + q[1];
+    q[0] = q[0] + 1;
+    i = i + 1;
+  }
+  return p[0] * 100 + q[0];
+}
+
+// 除数可能为 0, 循环不执行时不能提前计算
+int divide(int n, int x, int y) {
+  int i = 0, s = 0;
+  while (i < n) {
+    s = s + x / y + x % y;
+    i = i + 1;
+  }
+  return s;
+}
+
+int main() {
+  int n = getint();
+  int i = 0;
+  while (i < 20) {
+    int j = 0;
+    while (j < 20) { g[i][j] = i * 3 + j; j = j + 1; }
+    i = i + 1;
+  }
+  putint(rowsum(g, n)); putch(32); putint(total); putch(10);
+  putint(early(100, total + 50)); putch(32); putint(early(0, 0)); putch(32); putint(total); putch(10);
+  putint(with_call(n)); putch(10);
+  int a[3] = {1, 2, n};
+  putint(aliasing(a, a, 5)); putch(32); putint(aliasing(a, g[1], 5)); putch(10);
+  putint(divide(n, 100, 7)); putch(32); putint(divide(0, n, 0)); putch(10);
+  return 0;
+}
@@ -0,0 +1,47 @@
+int a[10];
+int g;
+
+int sum(int n, int k) {
+  int i = 0;
+  int s = 0;
+  while (i < n) {
+    s = s + a[k];
+    i = i + 1;
+  }
+  return s;
+}
+
+void bump(int n, int k) {
+  int i = 0;
+  while (i < n) {
+    a[k] = a[k] + i;
+    i = i + 1;
+  }
+}
+
+int main() {
+  int n = getint();
+  int k = getint();
+  int i = 0;
+  while (i < 10) { a[i] = i + 1; i = i + 1; }
+  putint(sum(n, k));
+  putch(32);
+  bump(n, k);
+  putint(a[0]);
+  putch(10);
+  n = getint();
+  k = getint();
+  putint(sum(n, k));
+  putch(32);
+  bump(n, k);
+  putint(a[k]);
+  putch(10);
+  i = 0;
+  while (i < n) {
+    g = g + a[3];
+    i = i + 1;
+  }
+  putint(g);
+  putch(10);
+  return 0;
+}
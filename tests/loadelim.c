@@ -0,0 +1,50 @@
+int g[8];
+int flag;
+
+void touch(int a[]) {
+  a[1] = a[1] + 100;
+}
+
+void noop(int x) {
+  flag = flag + x;
+}
+
+int main() {
+  int n = getint();
+  int a[8];
+  int i = 0;
+  while (i < 8) { a[i] = getint(); g[i] = a[i] * 2; i = i + 1; }
+  // 两个分支都写 a[0], 汇合后的读取取两边存入的值
+  if (n > 3) a[0] = n * 2; else a[0] = n + 1;
+  int r = a[0];
+  // 只有一个分支写, 另一个分支取之前读到的值
+  int b = g[2];
+  if (n > 5) g[2] = 11;
+  r = r * 10 + g[2] + b;
+  // 越过不写 g[3] 的循环
+  int c = g[3];
+  i = 0;
+  while (i < n) { g[4] = g[4] + i; noop(i); i = i + 1; }
+  r = r + g[3] + c + g[4];
+  // 循环中的调用可能写 a[1], 不能越过
+  int d = a[1];
+  i = 0;
+  while (i < 2) { touch(a); i = i + 1; }
+  r = r + a[1] - d;
+  // 变量下标在循环中改变, 不能取上一次迭代存入的值
+  i = 0;
+  int s = 0;
+  while (i < 7) {
+    a[i] = i * 3;
+    s = s + a[i + 1];
+    i = i + 1;
+  }
+  r = r + s;
+  // getarray 写入数组
+  int e = g[0];
+  int k = getarray(g);
+  r = r + g[0] - e + k;
+  putint(r); putch(10);
+  putint(flag); putch(10);
+  return r % 256;
+}
@@ -0,0 +1,71 @@
+int g;
+
+int side(int x) {
+  g = g + x;
+  return x;
+}
+
+// 前端为数组参数建立的指针变量也被提升
+int total(int a[], int n) {
+  int s = 0;
+  while (n > 0) {
+    n = n - 1;
+    s = s + a[n];
+  }
+  return s;
+}
+
+int main() {
+  int n = getint();
+  int a = 1, b = 2;
+  int i = 0;
+  // 交换: 回边上的基本块参数互相依赖
+  while (i < n) {
+    int t = a;
+    a = b;
+    b = t + b;
+    i = i + 1;
+  }
+  putint(a); putch(32); putint(b); putch(10);
+
+  // 循环里只在部分分支赋值, break 和 continue 带出不同的值
+  int last = -1, cnt = 0;
+  i = 0;
+  while (1) {
+    i = i + 1;
+    if (i % 3 == 0) continue;
+    if (i > n * 2) break;
+    cnt = cnt + 1;
+    if (i % 5 == 0) last = i;
+  }
+  putint(last); putch(32); putint(cnt); putch(32); putint(i); putch(10);
+
+  // 同名变量在内层作用域中遮蔽外层
+  int x = n;
+  {
+    int x = 5;
+    while (x > 0) { x = x - 1; a = a + x; }
+  }
+  x = x + a;
+  putint(x); putch(10);
+
+  // 短路求值的两条路径汇合处的变量
+  int y = 1;
+  if (side(n) > 3 && side(2) > 1) y = y + 10;
+  if (side(0) || side(y)) y = y * 100;
+  putint(y); putch(32); putint(g); putch(10);
+
+  // 嵌套循环, 内层循环的变量在外层每次迭代重新赋值
+  int arr[10];
+  int j = 0;
+  i = 0;
+  while (i < 10) {
+    j = 0;
+    int acc = i;
+    while (j < i) { acc = acc + j; j = j + 1; }
+    arr[i] = acc;
+    i = i + 1;
+  }
+  putint(total(arr, 10)); putch(32); putint(j); putch(10);
+  return a % 100;
+}
@@ -0,0 +1,51 @@
+// 记忆化只在 -fauto-memoize 下进行, 用 tests/run.sh -riscv -fauto-memoize 运行覆盖它
+int calls;
+
+int fib(int n) {
+  if (n < 2) return n;
+  return fib(n - 1) + fib(n - 2);
+}
+
+// 散列冲突: (n, m) 与 (n + 1, m - 31) 落在同一表项, 必须比较全部参数
+int fibm(int n, int m) {
+  if (n < 2) return n;
+  return (fibm(n - 1, m) + fibm(n - 2, m)) % m;
+}
+
+int f2(int a, int b) {
+  if (a <= 0) return b;
+  if (b <= 0) return a * 7;
+  return (f2(a - 1, b) + f2(a, b - 1) * 3) % 10007;
+}
+
+// 负数参数
+int neg(int n) {
+  if (n >= 0) return 1;
+  return (neg(n + 1) + neg(n + 2) + n) % 1000;
+}
+
+// 写全局变量的函数不是纯函数, 不能记忆化
+int count(int n) {
+  calls = calls + 1;
+  if (n < 2) return n;
+  return count(n - 1) + count(n - 2);
+}
+
+int main() {
+  int n = getint();
+  int a = getint();
+  int b = getint();
+  int m = getint();
+  putint(fib(n)); putch(10);
+  putint(f2(a, b)); putch(32);
+  putint(f2(a + 1, b - 31)); putch(32);
+  putint(f2(b, a)); putch(32);
+  putint(f2(a, b)); putch(10);
+  putint(fibm(n, m)); putch(32);
+  putint(fibm(n + 1, m - 31)); putch(32);
+  putint(fibm(n, m)); putch(10);
+  putint(neg(-n)); putch(10);
+  putint(count(n)); putch(32);
+  putint(calls); putch(10);
+  return fib(n) % 256;
+}
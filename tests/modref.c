@@ -0,0 +1,88 @@
+int g;
+int h[10];
+int cnt;
+
+// 带循环的函数在 -riscv 下不会被内联, 调用保留下来由摘要决定能否合并
+int tri(int x) {
+  int i = 0, s = 0;
+  while (i < x) { s = s + i; i = i + 1; }
+  return s;
+}
+
+int rdg(int k) {
+  int i = 0, s = g;
+  while (i < k) { s = s + h[i]; i = i + 1; }
+  return s;
+}
+
+void bump(int k) {
+  while (k > 0) { cnt = cnt + 1; k = k - 1; }
+}
+
+void fill(int a[], int n, int v) {
+  int i = 0;
+  while (i < n) { a[i] = v + i; i = i + 1; }
+}
+
+int sum(int a[], int n) {
+  int i = 0, s = 0;
+  while (i < n) { s = s + a[i]; i = i + 1; }
+  return s;
+}
+
+// 递归函数的摘要要在不动点上求出
+int parity(int n, int acc) {
+  if (n == 0) return acc;
+  return parity(n - 1, 1 - acc);
+}
+
+// 做输入输出的调用不能删除或合并
+int loud(int x) {
+  putint(x);
+  putch(32);
+  return x;
+}
+
+// 可能不返回的调用不能删除
+int spin(int x) {
+  while (x > 0) { x = x; }
+  return 0;
+}
+
+int main() {
+  int n = getint();
+  int z0 = getint();
+  int arr[10];
+  int loc[10];
+  int i = 0, r = 0;
+  g = 3;
+  h[2] = 5;
+  while (i < n) {
+    // 纯函数的两次调用合并, 不写 h 的调用前后 h[2] 的读取合并
+    r = r + tri(i) + tri(i);
+    int a = h[2];
+    bump(2);
+    r = r + h[2] + a + g;
+    // 读 g 的调用不能越过对 g 的写
+    r = r + rdg(3);
+    g = g + 1;
+    r = r + rdg(3);
+    tri(i + 1);
+    spin(z0);
+    i = i + 1;
+  }
+  putint(r); putch(10);
+  fill(arr, 10, 2);
+  loc[3] = 7;
+  int s1 = sum(arr, 10);
+  // fill 写传入的数组, 前后两次 sum 不能合并
+  fill(arr, 10, 4);
+  int s2 = sum(arr, 10);
+  // getarray 写入传入的数组
+  int m = getarray(loc);
+  putint(s1 + s2 + loc[3] + m); putch(10);
+  putint(parity(n, 1) + parity(n + 1, 0) * 10 + cnt); putch(10);
+  int z = loud(n) + loud(n);
+  putint(z); putch(10);
+  return r % 256;
+}
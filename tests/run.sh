@@ -0,0 +1,51 @@
+#!/usr/bin/env bash
+# 回归测试: 每个 tests/*.c 分别编译为 Koopa IR 和 RISCV 运行, 输出与 .out 比较
+# .out 为程序的标准输出, 最后一行是 main 的返回值; 有同名 .in 时作为标准输入
+# 有同名 .err 时程序应当编译失败, .err 为编译器输出的错误信息
+# 用法 (在仓库根目录): tests/run.sh [-koopa|-riscv] [编译选项...]
+mode=${1:--riscv}
+shift
+tmp=$(mktemp -d)
+fail=0
+for src in tests/*.c; do
+  name=$(basename "$src" .c)
+  input=/dev/null
+  [ -f "tests/$name.in" ] && input="tests/$name.in"
+  if [ -f "tests/$name.err" ]; then
+    if ! ./build/compiler -koopa "$src" -o "$tmp/$name.koopa" "$@" 2> "$tmp/$name.stderr" &&
+       diff -q "$tmp/$name.stderr" "tests/$name.err" > /dev/null; then
+      echo "ok   $name"
+    else
+      echo "FAIL $name (应当编译失败)"
+      fail=1
+    fi
+    continue
+  fi
+  if [ "$mode" = "-koopa" ]; then
+    ./build/compiler -koopa "$src" -o "$tmp/$name.koopa" "$@" &&
+    koopac "$tmp/$name.koopa" | llc --filetype=obj -o "$tmp/$name.o" &&
+    clang "$tmp/$name.o" -L$CDE_LIBRARY_PATH/native -lsysy -o "$tmp/$name"
+    run="$tmp/$name"
+  else
+    ./build/compiler -riscv "$src" -o "$tmp/$name.S" "$@" &&
+    clang "$tmp/$name.S" -c -o "$tmp/$name.o" -target riscv32-unknown-linux-elf -march=rv32im -mabi=ilp32 &&
+    ld.lld "$tmp/$name.o" -L$CDE_LIBRARY_PATH/riscv32 -lsysy -o "$tmp/$name"
+    run="qemu-riscv32-static $tmp/$name"
+  fi
+  if [ $? -ne 0 ]; then
+    echo "FAIL $name (编译)"
+    fail=1
+    continue
+  fi
+  $run < "$input" > "$tmp/$name.stdout"
+  ret=$?
+  { cat "$tmp/$name.stdout"; [ -n "$(tail -c 1 "$tmp/$name.stdout")" ] && echo; echo $ret; } > "$tmp/$name.result"
+  if diff -q "$tmp/$name.result" "tests/$name.out" > /dev/null; then
+    echo "ok   $name"
+  else
+    echo "FAIL $name"
+    fail=1
+  fi
+done
+rm -rf "$tmp"
+exit $fail
@@ -0,0 +1,43 @@
+int g;
+
+int pick(int x) {
+  int k = 4;
+  int d = 0;
+  // 不可执行的分支中的除以 0 不折叠
+  if (k > 5) d = x / d;
+  int m = k * 3;
+  int i = 0, s = 0, c = 7;
+  while (i < x) {
+    // c 在所有可执行的入边上都是 7
+    if (c == 7) s = s + m; else c = c + 1;
+    i = i + 1;
+  }
+  return s + c + d;
+}
+
+int flip(int x) {
+  // v 在两条边上取不同的常数, 不是常数
+  int v = 1;
+  int i = 0;
+  while (i < x) { v = 3 - v; i = i + 1; }
+  return v;
+}
+
+int main() {
+  int n = getint();
+  putint(pick(n)); putch(32); putint(pick(0)); putch(10);
+  putint(flip(n)); putch(32); putint(flip(n + 1)); putch(10);
+  // x * 0 与 x 无关
+  if (n * 0) g = 1;
+  putint(g); putch(10);
+  // 有符号除法和取模向零取整, 加法按 32 位回绕
+  int a = -7, b = 2;
+  putint(a / b); putch(32); putint(a % b); putch(32); putint(7 % -2); putch(10);
+  int big = 2147483647;
+  big = big + 1;
+  putint(big); putch(32); putint(big - 1); putch(10);
+  int p = 6, q = 0;
+  if (p > 5) q = 1; else q = 2;
+  putint(q * 10 + (p == 6) + (p != 6) * 100 + (p >= 7)); putch(10);
+  return 0;
+}
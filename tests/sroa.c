@@ -0,0 +1,39 @@
+int sum3(int a[]) {
+  return a[0] + a[1] + a[2];
+}
+
+int main() {
+  int n = getint();
+  // 只用常数下标访问, 拆成标量
+  int v[4] = {1, 2};
+  v[2] = n;
+  if (n > 3) v[3] = v[0] + v[2]; else v[3] = v[1];
+  int m[2][3] = {{1, 2, 3}, {4, 5, 6}};
+  m[1][2] = m[0][1] * n;
+  int i = 0;
+  while (i < n) {
+    int t = v[0];
+    v[0] = v[1];
+    v[1] = t + v[1];
+    i = i + 1;
+  }
+  int r = v[0] + v[1] * 10 + v[3] * 100 + m[1][2] + m[1][0];
+  // 变量下标访问, 不能拆
+  int w[4] = {3, 1, 4, 1};
+  w[n % 4] = 9;
+  r = r + w[0] + w[1] * 2 + w[2] * 3 + w[3] * 4;
+  // 地址传给函数, 逃逸
+  int e[3] = {7, 8};
+  e[2] = n;
+  r = r + sum3(e);
+  // 子数组地址传给函数
+  int f[2][3] = {{1, 1, 1}, {2, n, 2}};
+  r = r + sum3(f[1]);
+  // 超过元素数上限的数组不拆
+  int big[40] = {};
+  big[0] = n;
+  big[39] = n * 2;
+  r = r + big[0] + big[39] + big[20];
+  putint(r); putch(10);
+  return r % 256;
+}
@@ -0,0 +1,103 @@
+int g[8];
+
+int sum(int n) {
+  if (n == 0) return 0;
+  return sum(n - 1) + n;
+}
+
+int fact(int n) {
+  if (n <= 1) return 1;
+  return n * fact(n - 1);
+}
+
+int gcd(int a, int b) {
+  if (b == 0) return a;
+  return gcd(b, a % b);
+}
+
+void fill(int a[], int i, int n) {
+  if (i >= n) return;
+  a[i] = i * i;
+  fill(a, i + 1, n);
+}
+
+// 不满足交换律的运算不能用累加器
+int alt(int n) {
+  if (n == 0) return 0;
+  return n - alt(n - 1);
+}
+
+// 两处递归的运算不同, 只消除其中一处
+int mixed(int n) {
+  if (n <= 0) return 1;
+  if (n % 2 == 0) return mixed(n - 1) + n;
+  return mixed(n - 1) * 2;
+}
+
+// 实参指向本函数的栈帧, 下一次调用时不能被覆盖
+int frame(int a[], int n) {
+  int b[2];
+  if (n == 0) return a[0] + a[1];
+  b[0] = a[1];
+  b[1] = a[0] + n;
+  return frame(b, n - 1);
+}
+
+int many(int a, int b, int c, int d, int e, int f, int h, int i, int j) {
+  int s = 0;
+  int t = 0;
+  while (t < a % 3 + 1) {
+    s = s + a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + h * 7 + i * 8 + j * 9;
+    t = t + 1;
+  }
+  return s;
+}
+
+// 参数超过 8 个的调用不能作为尾调用
+int call_many(int x) {
+  int i = 0;
+  while (i < x) { x = x - 1; i = i + 1; }
+  return many(x, x + 1, x + 2, x + 3, x + 4, x + 5, x + 6, x + 7, x + 8);
+}
+
+int sum_arr(int a[], int n) {
+  int s = 0;
+  int i = 0;
+  while (i < n) { s = s + a[i]; i = i + 1; }
+  return s;
+}
+
+// 局部数组的地址不能交给尾调用
+int call_local(int x) {
+  int t = 0;
+  int i = 0;
+  while (i < x) { t = t + i; i = i + 1; }
+  int a[3] = {x, t, x * 3};
+  return sum_arr(a, 2 + x % 2);
+}
+
+// 全局数组可以交给尾调用
+int call_global(int x) {
+  int i = 0;
+  while (i < x) { g[i % 8] = g[i % 8] + i; i = i + 1; }
+  return sum_arr(g, 3 + x % 5);
+}
+
+int main() {
+  int n = getint();
+  int k = getint();
+  putint(sum(n)); putch(10);
+  putint(fact(k)); putch(10);
+  putint(gcd(n * 7, k * 21)); putch(10);
+  fill(g, 0, k);
+  putint(g[k - 1] + g[2]); putch(10);
+  putint(alt(k)); putch(10);
+  putint(mixed(k)); putch(10);
+  int a[2] = {k, n};
+  putint(frame(a, k)); putch(10);
+  putint(call_many(k)); putch(10);
+  putint(call_local(k)); putch(10);
+  putint(call_many(n) + call_local(n)); putch(10);
+  putint(call_global(k)); putch(10);
+  return 0;
+}
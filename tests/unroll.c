@@ -0,0 +1,79 @@
+int a[100];
+int g;
+
+int up(int lo, int hi) {
+  int i = lo, s = 0;
+  while (i < hi) { s = s + i; i = i + 3; }
+  return s;
+}
+
+int upe(int lo, int hi) {
+  int i = lo, s = 0;
+  while (i <= hi) { if (i % 2) s = s + i; else s = s - 1; i = i + 1; }
+  return s;
+}
+
+int down(int n) {
+  int i = n, s = 0;
+  while (i > 0) { s = s * 2 + i; s = s % 10007; i = i - 2; }
+  return s;
+}
+
+int downe(int n, int lo) {
+  int i = n, c = 0;
+  while (lo <= i) { c = c + 1; i = i - 5; }
+  return c + i;
+}
+
+int fill(int n) {
+  int i = 0;
+  while (i < n) { a[i] = i * i; i = i + 1; }
+  int s = 0;
+  i = 0;
+  while (i < 100) { s = s + a[i]; i = i + 1; }
+  return s;
+}
+
+// 常数次数: 完全展开和 != 条件
+int small() {
+  int i = 7, s = 1;
+  while (i > 0) { s = s * i; i = i - 1; }
+  int j = 0, t = 0;
+  while (j != 12) { t = t + j; j = j + 4; }
+  return s + t;
+}
+
+void tick() {
+  g = g + 1;
+}
+
+// 含调用或有其他出口的循环不展开
+int other(int n) {
+  int i = 0;
+  while (i < n) { tick(); i = i + 1; }
+  i = 0;
+  int s = 0;
+  while (i < n) {
+    s = s + a[i];
+    if (s > 1000) break;
+    i = i + 1;
+  }
+  return s + i;
+}
+
+int main() {
+  int n = getint();
+  int k = 0, acc = 0;
+  while (k < n) {
+    acc = acc + up(k, 40 + k) + upe(-k, k * 3) + down(k * 5 + 1) + downe(k * 7, k - 3);
+    acc = acc % 1000003;
+    k = k + 1;
+  }
+  putint(acc); putch(10);
+  putint(up(-2147483647 - 1, -2147483647 + 5)); putch(32);
+  putint(upe(2147483640, 2147483646)); putch(32);
+  putint(downe(-2147483600, -2147483643)); putch(10);
+  putint(fill(n * 6 - 1)); putch(32); putint(fill(n - n)); putch(10);
+  putint(small()); putch(32); putint(other(n)); putch(32); putint(g); putch(10);
+  return 0;
+}